@@ -0,0 +1,78 @@
+#version 450
+
+// Copies the live, on-screen cells of one chunk into a dense instance
+// buffer and counts them into the chunk's indirect draw command. Each
+// workgroup scans its cells in shared memory, then reserves its slice of
+// the output with a single atomic.
+
+layout(local_size_x = 256) in;
+
+layout(constant_id = 0) const uint grid_size = 1000;
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    vec2 pos;
+    float zoom;
+} ubo;
+
+// game::Cell is 12 bytes (x, y, alive), which no std430 struct matches, so
+// cells are addressed as raw words.
+layout(std430, set = 0, binding = 1) readonly buffer Cells {
+    uint cells[];
+};
+
+layout(std430, set = 0, binding = 2) writeonly buffer Compacted {
+    uint compacted[];
+};
+
+layout(std430, set = 0, binding = 3) buffer Indirect {
+    uint vertex_count;
+    uint instance_count;
+    uint first_vertex;
+    uint first_instance;
+} indirect;
+
+layout(push_constant) uniform PushConstants {
+    uint cell_count;
+} pc;
+
+shared uint scan[256];
+shared uint base;
+
+bool visible(vec2 cell) {
+    vec2 reach = vec2(float(grid_size) / ubo.zoom);
+    return all(greaterThanEqual(cell, ubo.pos - reach - 1.)) && all(lessThanEqual(cell, ubo.pos + reach));
+}
+
+void main() {
+    uint local = gl_LocalInvocationID.x;
+    uint index = (gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x) * gl_WorkGroupSize.x + local;
+
+    uint live = 0;
+    vec2 cell = vec2(0.);
+    if (index < pc.cell_count) {
+        cell = vec2(uintBitsToFloat(cells[3 * index]), uintBitsToFloat(cells[3 * index + 1]));
+        live = (cells[3 * index + 2] == 1 && visible(cell)) ? 1 : 0;
+    }
+
+    // Inclusive Hillis-Steele scan.
+    scan[local] = live;
+    barrier();
+    for (uint offset = 1; offset < gl_WorkGroupSize.x; offset <<= 1) {
+        uint add = local >= offset ? scan[local - offset] : 0;
+        barrier();
+        scan[local] += add;
+        barrier();
+    }
+
+    if (local == gl_WorkGroupSize.x - 1) {
+        base = atomicAdd(indirect.instance_count, scan[local]);
+    }
+    barrier();
+
+    if (live == 1) {
+        uint slot = base + scan[local] - 1;
+        compacted[3 * slot] = floatBitsToUint(cell.x);
+        compacted[3 * slot + 1] = floatBitsToUint(cell.y);
+        compacted[3 * slot + 2] = 1;
+    }
+}
@@ -1,5 +1,167 @@
 #version 450
 
+// Advances a bit-packed board by GENERATIONS generations. Words hold 32
+// cells, column j of a row in bit j % 32 of word j / 32, and padding bits
+// past width stay zero. Each invocation owns one word of a tile that is
+// stepped entirely in shared memory: a one word wide and GENERATIONS rows
+// high halo surrounds the part that is written back, since the exact
+// region shrinks by one cell per generation.
+//
+// Built twice: with GAME_SUBGROUPS the horizontal neighbours come from
+// subgroup shuffles instead of shared memory.
+
+#ifdef GAME_SUBGROUPS
+#extension GL_KHR_shader_subgroup_shuffle_relative : require
+#endif
+
+layout(local_size_x_id = 0, local_size_y_id = 1) in;
+
+layout(constant_id = 2) const uint GENERATIONS = 4;
+
+layout(std430, set = 0, binding = 0) readonly buffer Source {
+    uint source[];
+};
+
+layout(std430, set = 0, binding = 1) writeonly buffer Target {
+    uint target[];
+};
+
+// Bit n of birth/survive set means a cell with n live neighbours is
+// born/survives, as in game::Rule.
+layout(push_constant) uniform PushConstants {
+    uint width;
+    uint height;
+    uint words_per_row;
+    uint birth;
+    uint survive;
+} pc;
+
+shared uint tile[gl_WorkGroupSize.x * gl_WorkGroupSize.y];
+
+void fullAdd(uint a, uint b, uint c, out uint sum, out uint carry) {
+    uint t = a ^ b;
+    sum = t ^ c;
+    carry = (a & b) | (t & c);
+}
+
+// Same bit-sliced adder and rule as kernels.hpp.
+uint applyRule(
+    uint alive,
+    uint up_left, uint up, uint up_right,
+    uint left, uint right,
+    uint down_left, uint down, uint down_right
+) {
+    uint s0, c0, s1, c1, b0, ca, t, cb;
+    fullAdd(up_left, up, up_right, s0, c0);
+    fullAdd(left, right, down_left, s1, c1);
+    uint s2 = down ^ down_right;
+    uint c2 = down & down_right;
+    fullAdd(s0, s1, s2, b0, ca);
+    fullAdd(c0, c1, c2, t, cb);
+    uint b1 = t ^ ca;
+    uint cc = t & ca;
+    uint count[4] = uint[4](b0, b1, cb ^ cc, cb & cc);
+
+    uint born = 0;
+    uint survives = 0;
+    for (uint value = 0; value <= 8; value++) {
+        if ((((pc.birth | pc.survive) >> value) & 1) == 0) {
+            continue;
+        }
+        uint eq = ~0u;
+        for (uint b = 0; b < 4; b++) {
+            eq &= ((value >> b) & 1) != 0 ? count[b] : ~count[b];
+        }
+        if (((pc.birth >> value) & 1) != 0) {
+            born |= eq;
+        }
+        if (((pc.survive >> value) & 1) != 0) {
+            survives |= eq;
+        }
+    }
+    return (alive & survives) | (~alive & born);
+}
+
+// Word at (x + dx, y + dy) of the tile, dead outside it. Invocations on the
+// tile border get wrong neighbours this way, which is what the halo is for.
+uint neighbour(uint x, uint y, int dx, int dy) {
+    int nx = int(x) + dx;
+    int ny = int(y) + dy;
+    if (nx < 0 || nx >= int(gl_WorkGroupSize.x) || ny < 0 || ny >= int(gl_WorkGroupSize.y)) {
+        return 0;
+    }
+    return tile[uint(ny) * gl_WorkGroupSize.x + uint(nx)];
+}
+
 void main() {
-    
-}
\ No newline at end of file
+    uint x = gl_LocalInvocationID.x;
+    uint y = gl_LocalInvocationID.y;
+    uint index = y * gl_WorkGroupSize.x + x;
+    int word = int(gl_WorkGroupID.x * (gl_WorkGroupSize.x - 2) + x) - 1;
+    int row = int(gl_WorkGroupID.y * (gl_WorkGroupSize.y - 2 * GENERATIONS) + y) - int(GENERATIONS);
+
+    // Cells outside the board are forced dead after every generation.
+    bool inside = word >= 0 && word < int(pc.words_per_row) && row >= 0 && row < int(pc.height);
+    uint mask = 0;
+    if (inside) {
+        mask = uint(word) + 1 == pc.words_per_row && (pc.width & 31) != 0 ? (1u << (pc.width & 31)) - 1 : ~0u;
+    }
+    uint cur = inside ? source[uint(row) * pc.words_per_row + uint(word)] : 0;
+    tile[index] = cur;
+
+#ifdef GAME_SUBGROUPS
+    // Lanes are consecutive invocations in practice but not by guarantee,
+    // so check where the shuffled word actually comes from. The shuffles
+    // run in uniform control flow, before any of the tests.
+    uint up_index = subgroupShuffleUp(index, 1);
+    uint down_index = subgroupShuffleDown(index, 1);
+    bool left_lane = x > 0 && gl_SubgroupInvocationID > 0 && up_index == index - 1;
+    bool right_lane = x + 1 < gl_WorkGroupSize.x && gl_SubgroupInvocationID + 1 < gl_SubgroupSize
+        && down_index == index + 1;
+#endif
+
+    for (uint g = 0; g < GENERATIONS; g++) {
+        barrier();
+        uint up = neighbour(x, y, 0, -1);
+        uint down = neighbour(x, y, 0, 1);
+#ifdef GAME_SUBGROUPS
+        uint up_left = subgroupShuffleUp(up, 1);
+        uint left = subgroupShuffleUp(cur, 1);
+        uint down_left = subgroupShuffleUp(down, 1);
+        uint up_right = subgroupShuffleDown(up, 1);
+        uint right = subgroupShuffleDown(cur, 1);
+        uint down_right = subgroupShuffleDown(down, 1);
+        if (!left_lane) {
+            up_left = neighbour(x, y, -1, -1);
+            left = neighbour(x, y, -1, 0);
+            down_left = neighbour(x, y, -1, 1);
+        }
+        if (!right_lane) {
+            up_right = neighbour(x, y, 1, -1);
+            right = neighbour(x, y, 1, 0);
+            down_right = neighbour(x, y, 1, 1);
+        }
+#else
+        uint up_left = neighbour(x, y, -1, -1);
+        uint left = neighbour(x, y, -1, 0);
+        uint down_left = neighbour(x, y, -1, 1);
+        uint up_right = neighbour(x, y, 1, -1);
+        uint right = neighbour(x, y, 1, 0);
+        uint down_right = neighbour(x, y, 1, 1);
+#endif
+        uint next = applyRule(
+            cur,
+            (up << 1) | (up_left >> 31), up, (up >> 1) | (up_right << 31),
+            (cur << 1) | (left >> 31), (cur >> 1) | (right << 31),
+            (down << 1) | (down_left >> 31), down, (down >> 1) | (down_right << 31)
+        ) & mask;
+        barrier();
+        tile[index] = next;
+        cur = next;
+    }
+
+    bool exact = x > 0 && x + 1 < gl_WorkGroupSize.x && y >= GENERATIONS && y + GENERATIONS < gl_WorkGroupSize.y;
+    if (inside && exact) {
+        target[uint(row) * pc.words_per_row + uint(word)] = cur;
+    }
+}
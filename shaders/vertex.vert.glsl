@@ -1,6 +1,6 @@
 #version 450
 
-layout(constant_id = 0) const int grid_size = 1000;
+layout(constant_id = 0) const uint grid_size = 1000;
 
 layout(set = 0, binding = 0) uniform UniformBufferObject {
     vec2 pos;
@@ -15,7 +15,7 @@ layout(location = 0) out vec3 fragColor;
 
 void main() {
     gl_Position = vec4(
-        ((inCellPos + inVertex - ubo.pos) / grid_size) * ubo.zoom,
+        ((inCellPos + inVertex - ubo.pos) / float(grid_size)) * ubo.zoom,
         0.,
         1.
     );
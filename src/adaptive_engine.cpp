@@ -0,0 +1,229 @@
+#include "engine.hpp"
+#include "trace.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+namespace game {
+    namespace {
+        // Runs one of several engines and keeps moving the board to
+        // whichever is fastest for its current phase. Every
+        // SAMPLE_GENERATIONS the density and activity (births and deaths
+        // per live cell) of the stepped generation are compared with those
+        // at the last race. When either has more than doubled or halved,
+        // or RACE_SAMPLES samples went by, the candidates race: each steps
+        // the next TRIAL_GENERATIONS of the run in turn, timed, and the
+        // board stays with the fastest. Only the running engine holds a
+        // board between races.
+        class AdaptiveEngine : public Engine {
+        public:
+            static constexpr uint64_t SAMPLE_GENERATIONS = 64;
+            static constexpr uint64_t RACE_SAMPLES = 64;
+            static constexpr uint64_t TRIAL_GENERATIONS = 16;
+            // The running engine is kept unless another is this much faster,
+            // which saves moving the board over measurement noise.
+            static constexpr double SWITCH_MARGIN = 1.1;
+
+            AdaptiveEngine(Rule rule, ThreadPool& pool, std::vector<std::string> candidates, std::ostream* log)
+                : rule(rule), pool(pool), candidates(candidates), log(log), times(candidates.size()) {
+                if (candidates.empty()) {
+                    throw std::runtime_error("adaptive engine needs at least one candidate");
+                }
+                // Fails early on candidates that can't run this rule.
+                for (auto& candidate : candidates) {
+                    std::unique_ptr<Engine> probe;
+                    createEngine(candidate, rule, pool, probe);
+                }
+            }
+
+            const char* name() const override {
+                return "adaptive";
+            }
+
+            void load(const Board& board) override {
+                cells = board.width * board.height;
+                if (!current) {
+                    createEngine(candidates[0], rule, pool, current);
+                    current_index = 0;
+                }
+                current->load(board);
+                step_stats = current->stats();
+                startRace();
+            }
+
+            void store(Board& board) const override {
+                current->store(board);
+            }
+
+            void edit(const std::vector<CellEdit>& edits) override {
+                current->edit(edits);
+                step_stats = current->stats();
+            }
+
+            void step(uint64_t generations) override {
+                while (generations > 0) {
+                    uint64_t chunk = std::min(generations, racing ? trial_left : until_sample);
+                    auto begin = std::chrono::steady_clock::now();
+                    current->step(chunk);
+                    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+                    step_stats = current->stats();
+                    generations -= chunk;
+                    stepped += chunk;
+                    if (racing) {
+                        times[current_index] += seconds;
+                        trial_left -= chunk;
+                        if (trial_left == 0) {
+                            nextTrial();
+                        }
+                    } else {
+                        until_sample -= chunk;
+                        if (until_sample == 0) {
+                            sample();
+                        }
+                    }
+                }
+            }
+
+            uint64_t memoryBytes() const override {
+                return current->memoryBytes();
+            }
+
+        private:
+            void switchTo(size_t index) {
+                if (index == current_index) {
+                    return;
+                }
+                GAME_TRACE_SCOPE("adaptive switch");
+                Board board;
+                current->store(board);
+                StepStats stats = current->stats();
+                // Drop the old state first so only one copy of the board
+                // is held by an engine at a time.
+                current.reset();
+                createEngine(candidates[index], rule, pool, current);
+                current->load(board);
+                current_index = index;
+                // Keep the births and deaths counted by the previous engine.
+                step_stats = stats;
+            }
+
+            void startRace() {
+                if (candidates.size() == 1) {
+                    racing = false;
+                    until_sample = SAMPLE_GENERATIONS;
+                    return;
+                }
+                std::fill(times.begin(), times.end(), 0.);
+                // The running engine goes first, so a race starts without a
+                // conversion.
+                race_order.clear();
+                race_order.push_back(current_index);
+                for (size_t c = 0; c < candidates.size(); c++) {
+                    if (c != current_index) {
+                        race_order.push_back(c);
+                    }
+                }
+                race_position = 0;
+                racing = true;
+                trial_left = TRIAL_GENERATIONS;
+            }
+
+            void nextTrial() {
+                if (++race_position < race_order.size()) {
+                    switchTo(race_order[race_position]);
+                    trial_left = TRIAL_GENERATIONS;
+                    return;
+                }
+                size_t best = race_order[0];
+                for (size_t c = 0; c < candidates.size(); c++) {
+                    if (times[c] < times[best]) {
+                        best = c;
+                    }
+                }
+                // Taken after stepping, as the loaded board has no births
+                // or deaths yet.
+                race_density = density();
+                race_activity = activity();
+                // Near ties go to the engine that ran before the race.
+                size_t chosen = race_order[0];
+                if (times[best] * SWITCH_MARGIN < times[chosen]) {
+                    chosen = best;
+                }
+                if (log) {
+                    std::ostringstream line;
+                    line << "adaptive: after " << stepped << " generations, density "
+                        << std::setprecision(3) << race_density << ", activity " << race_activity << ":";
+                    for (size_t c = 0; c < candidates.size(); c++) {
+                        line << " " << candidates[c] << " " << std::fixed << std::setprecision(1)
+                            << times[c] * 1e6 / TRIAL_GENERATIONS << " us" << std::defaultfloat;
+                    }
+                    line << " per generation, " << (chosen == race_order[0] ? "keeps " : "switches to ") << candidates[chosen];
+                    *log << line.str() << std::endl;
+                }
+                switchTo(chosen);
+                racing = false;
+                samples_since_race = 0;
+                until_sample = SAMPLE_GENERATIONS;
+            }
+
+            void sample() {
+                until_sample = SAMPLE_GENERATIONS;
+                samples_since_race++;
+                if (drifted(density(), race_density, 1e-3)
+                    || drifted(activity(), race_activity, 1e-2)
+                    || samples_since_race >= RACE_SAMPLES) {
+                    startRace();
+                }
+            }
+
+            double density() const {
+                return cells == 0 ? 0. : double(step_stats.population) / cells;
+            }
+
+            double activity() const {
+                return double(step_stats.births + step_stats.deaths) / std::max<uint64_t>(step_stats.population, 1);
+            }
+
+            // Changed by more than a factor of two, ignoring changes that
+            // stay below floor.
+            static bool drifted(double value, double reference, double floor) {
+                return std::max(value, reference) > 2. * std::min(value, reference) + floor;
+            }
+
+            Rule rule;
+            ThreadPool& pool;
+            std::vector<std::string> candidates;
+            std::ostream* log;
+            std::unique_ptr<Engine> current;
+            size_t current_index = 0;
+            uint64_t cells = 0;
+            uint64_t stepped = 0;
+
+            bool racing = false;
+            std::vector<size_t> race_order;
+            size_t race_position = 0;
+            uint64_t trial_left = 0;
+            std::vector<double> times;
+            double race_density = 0.;
+            double race_activity = 0.;
+
+            uint64_t until_sample = SAMPLE_GENERATIONS;
+            uint64_t samples_since_race = 0;
+        };
+    }
+
+    void createAdaptiveEngine(Rule rule, ThreadPool& pool, std::vector<std::string> candidates, std::ostream* log, std::unique_ptr<Engine>& engine) {
+        if (candidates.empty()) {
+            candidates = { "bitpacked" };
+            if (!rule.torus) {
+                candidates.push_back("lut");
+                candidates.push_back("tiled");
+            }
+        }
+        engine = std::make_unique<AdaptiveEngine>(rule, pool, candidates, log);
+    }
+}
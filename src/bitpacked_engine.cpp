@@ -0,0 +1,91 @@
+#include "engine.hpp"
+#include "kernels.hpp"
+#include "trace.hpp"
+
+namespace game {
+    namespace {
+        // 64 cells per word, neighbour counts computed with a bit-sliced
+        // adder so every word of the board is updated with ~40 logic ops.
+        // Rows go through the stepRowKernel instance picked at load.
+        class BitpackedEngine : public Engine {
+        public:
+            BitpackedEngine(Rule rule, ThreadPool& pool) : rule(rule), pool(pool), worker_stats(pool.size()) {}
+
+            const char* name() const override {
+                return "bitpacked";
+            }
+
+            void load(const Board& board) override {
+                copyBoard(board, current, pool);
+                createBoard(board.width, board.height, next);
+                step_stats = boardStats(board);
+                shape = RowShape { board.width, board.words_per_row, board.lastWordMask() };
+                kernel = selectRowKernel(shape, rule, false);
+                stats_kernel = selectRowKernel(shape, rule, true);
+                dead_row.assign(board.words_per_row, 0);
+            }
+
+            void store(Board& board) const override {
+                board = current;
+            }
+
+            void edit(const std::vector<CellEdit>& edits) override {
+                applyEdits(current, edits, &step_stats);
+            }
+
+            void step(uint64_t generations) override {
+                for (uint64_t g = 0; g < generations; g++) {
+                    GAME_TRACE_SCOPE("bitpacked step");
+                    // Only the generation that is left visible is counted.
+                    bool last = g + 1 == generations;
+                    if (last) {
+                        std::fill(worker_stats.begin(), worker_stats.end(), StepStats());
+                    }
+                    pool.parallelFor(current.height, [this, last](uint64_t begin, uint64_t end, uint32_t worker) {
+                        RowKernel step_row = last ? stats_kernel : kernel;
+                        const uint64_t* above = rule.torus ? current.row(current.height - 1) : dead_row.data();
+                        const uint64_t* below = rule.torus ? current.row(0) : dead_row.data();
+                        for (uint64_t i = begin; i < end; i++) {
+                            step_row(
+                                i != 0 ? current.row(i - 1) : above,
+                                current.row(i),
+                                i + 1 != current.height ? current.row(i + 1) : below,
+                                next.row(i),
+                                shape,
+                                rule,
+                                &worker_stats[worker],
+                                i
+                            );
+                        }
+                    });
+                    std::swap(current, next);
+                }
+                if (generations > 0) {
+                    step_stats = StepStats();
+                    for (auto& s : worker_stats) {
+                        step_stats.merge(s);
+                    }
+                }
+            }
+
+            uint64_t memoryBytes() const override {
+                return (current.words.size() + next.words.size()) * sizeof(uint64_t);
+            }
+
+        private:
+            Rule rule;
+            ThreadPool& pool;
+            std::vector<StepStats> worker_stats;
+            Board current;
+            Board next;
+            RowShape shape;
+            RowKernel kernel;
+            RowKernel stats_kernel;
+            std::vector<uint64_t> dead_row;
+        };
+    }
+
+    void createBitpackedEngine(Rule rule, ThreadPool& pool, std::unique_ptr<Engine>& engine) {
+        engine = std::make_unique<BitpackedEngine>(rule, pool);
+    }
+}
@@ -0,0 +1,101 @@
+#include "board.hpp"
+
+#include <stdexcept>
+
+namespace game {
+    void parseRule(std::string text, Rule& rule) {
+        Rule parsed { 0, 0 };
+        size_t split = text.find(':');
+        if (split != std::string::npos) {
+            char topology = split + 1 < text.size() ? text[split + 1] : '\0';
+            if (topology == 'T' || topology == 't') {
+                parsed.torus = true;
+            } else if (topology != 'P' && topology != 'p') {
+                throw std::runtime_error("invalid rule " + text);
+            }
+        }
+        uint16_t* target = nullptr;
+        for (char c : text.substr(0, split)) {
+            if (c == 'B' || c == 'b') {
+                target = &parsed.birth;
+            } else if (c == 'S' || c == 's') {
+                target = &parsed.survive;
+            } else if (c >= '0' && c <= '8' && target != nullptr) {
+                *target |= 1 << (c - '0');
+            } else if (c != '/') {
+                throw std::runtime_error("invalid rule " + text);
+            }
+        }
+        rule = parsed;
+    }
+
+    std::string ruleName(Rule rule) {
+        std::string name = "B";
+        for (int n = 0; n <= 8; n++) {
+            if (rule.birth & (1 << n)) {
+                name += char('0' + n);
+            }
+        }
+        name += "/S";
+        for (int n = 0; n <= 8; n++) {
+            if (rule.survive & (1 << n)) {
+                name += char('0' + n);
+            }
+        }
+        if (rule.torus) {
+            name += ":T";
+        }
+        return name;
+    }
+
+    void createBoard(uint64_t width, uint64_t height, Board& board) {
+        board.width = width;
+        board.height = height;
+        board.words_per_row = (width + 63) / 64;
+        // A fresh allocation rather than assign(): reused storage would not
+        // be zero, and assign() would write every page from this thread.
+        board.words = Board::Words();
+        board.words.resize(board.words_per_row * height);
+    }
+
+    uint64_t population(const Board& board) {
+        uint64_t count = 0;
+        for (uint64_t w : board.words) {
+            count += popcount64(w);
+        }
+        return count;
+    }
+
+    void applyEdits(Board& board, const std::vector<CellEdit>& edits, StepStats* stats) {
+        for (const CellEdit& edit : edits) {
+            if (edit.row >= board.height || edit.column >= board.width) {
+                continue;
+            }
+            bool alive = board.get(edit.row, edit.column);
+            if (alive == edit.alive) {
+                continue;
+            }
+            board.set(edit.row, edit.column, edit.alive);
+            if (stats && edit.alive) {
+                stats->population++;
+                stats->min_row = std::min(stats->min_row, edit.row);
+                stats->max_row = std::max(stats->max_row, edit.row);
+                stats->min_column = std::min(stats->min_column, edit.column);
+                stats->max_column = std::max(stats->max_column, edit.column);
+            } else if (stats) {
+                stats->population--;
+            }
+        }
+    }
+
+    StepStats boardStats(const Board& board) {
+        StepStats stats;
+        for (uint64_t i = 0; i < board.height; i++) {
+            const uint64_t* row = board.row(i);
+            for (uint64_t w = 0; w < board.words_per_row; w++) {
+                stats.addWord(i, w, row[w], row[w]);
+            }
+        }
+        return stats;
+    }
+}
@@ -0,0 +1,170 @@
+#ifndef __BOARD__HPP__
+#define __BOARD__HPP__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "memory.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace game {
+    inline uint64_t popcount64(uint64_t w) {
+#ifdef _MSC_VER
+        return __popcnt64(w);
+#else
+        return __builtin_popcountll(w);
+#endif
+    }
+
+    // w must be non-zero.
+    inline uint32_t countTrailingZeros64(uint64_t w) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, w);
+        return index;
+#else
+        return __builtin_ctzll(w);
+#endif
+    }
+
+    // w must be non-zero.
+    inline uint32_t countLeadingZeros64(uint64_t w) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, w);
+        return 63 - index;
+#else
+        return __builtin_clzll(w);
+#endif
+    }
+
+    // Bit n of birth/survive set means a cell with n live neighbours is
+    // born/survives. On a torus the edges wrap around, otherwise everything
+    // outside the board is dead.
+    struct Rule {
+        uint16_t birth;
+        uint16_t survive;
+        bool torus = false;
+
+        static Rule life() {
+            return Rule { 1 << 3, (1 << 2) | (1 << 3) };
+        }
+
+        // B3/S23 on either topology.
+        bool isLife() const {
+            return birth == life().birth && survive == life().survive;
+        }
+
+        bool operator==(const Rule& other) const {
+            return birth == other.birth && survive == other.survive && torus == other.torus;
+        }
+    };
+
+    // "B3/S23", optionally with Golly's topology suffix: ":T" for a torus,
+    // ":P" for the bounded plane. The size always comes from the board, so
+    // any dimensions after the letter are ignored.
+    void parseRule(std::string text, Rule& rule);
+    std::string ruleName(Rule rule);
+
+    // Row-major, 64 cells per word, column j of a row lives in bit j % 64 of
+    // word j / 64. Padding bits past width are always zero.
+    struct Board {
+        using Words = std::vector<uint64_t, PageAllocator<uint64_t>>;
+
+        uint64_t width;
+        uint64_t height;
+        uint64_t words_per_row;
+        Words words;
+
+        uint64_t* row(uint64_t i) {
+            return words.data() + i * words_per_row;
+        }
+
+        const uint64_t* row(uint64_t i) const {
+            return words.data() + i * words_per_row;
+        }
+
+        bool get(uint64_t i, uint64_t j) const {
+            return (row(i)[j >> 6] >> (j & 63)) & 1;
+        }
+
+        void set(uint64_t i, uint64_t j, bool alive) {
+            uint64_t bit = uint64_t(1) << (j & 63);
+            if (alive) {
+                row(i)[j >> 6] |= bit;
+            } else {
+                row(i)[j >> 6] &= ~bit;
+            }
+        }
+
+        uint64_t lastWordMask() const {
+            return (width & 63) ? (uint64_t(1) << (width & 63)) - 1 : ~uint64_t(0);
+        }
+
+        bool operator==(const Board& other) const {
+            return width == other.width && height == other.height && words == other.words;
+        }
+    };
+
+    // Population, births, deaths and live bounding box of one generation.
+    // Engines accumulate these word by word while computing the generation,
+    // so monitoring never needs another pass over the board.
+    struct StepStats {
+        uint64_t population = 0;
+        uint64_t births = 0;
+        uint64_t deaths = 0;
+        uint64_t min_row = UINT64_MAX;
+        uint64_t max_row = 0;
+        uint64_t min_column = UINT64_MAX;
+        uint64_t max_column = 0;
+
+        void addWord(uint64_t row, uint64_t word, uint64_t before, uint64_t after) {
+            population += popcount64(after);
+            births += popcount64(after & ~before);
+            deaths += popcount64(before & ~after);
+            if (after != 0) {
+                min_row = std::min(min_row, row);
+                max_row = std::max(max_row, row);
+                min_column = std::min<uint64_t>(min_column, word * 64 + countTrailingZeros64(after));
+                max_column = std::max<uint64_t>(max_column, word * 64 + 63 - countLeadingZeros64(after));
+            }
+        }
+
+        void merge(const StepStats& other) {
+            population += other.population;
+            births += other.births;
+            deaths += other.deaths;
+            min_row = std::min(min_row, other.min_row);
+            max_row = std::max(max_row, other.max_row);
+            min_column = std::min(min_column, other.min_column);
+            max_column = std::max(max_column, other.max_column);
+        }
+    };
+
+    struct CellEdit {
+        uint64_t row;
+        uint64_t column;
+        bool alive;
+    };
+
+    // Applies edits in order, dropping those outside the board. With stats
+    // set, its population follows along and its bounds grow to cover new
+    // cells; erasing never shrinks them, so they can be loose until the
+    // next step.
+    void applyEdits(Board& board, const std::vector<CellEdit>& edits, StepStats* stats = nullptr);
+
+    // The new board is all dead but its pages are not touched yet, so they
+    // land on the node of whichever thread writes them first.
+    void createBoard(uint64_t width, uint64_t height, Board& board);
+    uint64_t population(const Board& board);
+    // Full scan, used when a board is loaded rather than stepped. Births and
+    // deaths are zero.
+    StepStats boardStats(const Board& board);
+}
+
+#endif // __BOARD__HPP__
@@ -0,0 +1,539 @@
+#include "census.hpp"
+#include "ensemble.hpp"
+#include "kernels.hpp"
+#include "patterns.hpp"
+#include "trace.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace game {
+    namespace {
+        using Cells = std::vector<std::pair<int64_t, int64_t>>;
+
+        // Forms not seen before get classified; this caps the cache of
+        // forms each worker has classified.
+        constexpr size_t MAX_CACHED_FORMS = 1 << 16;
+
+        // Running soups are searched for escaping ships at least this often,
+        // in a band along the edge as wide as the generations in between.
+        // A c/2 ship moves only half as far, so one headed for the edge is
+        // seen in the band before it gets there.
+        constexpr uint64_t ESCAPE_CHECK_GENERATIONS = 8;
+        // Other cells this close to a ship's way out could still hit it.
+        constexpr int64_t ESCAPE_CLEARANCE = 4;
+        // Only pieces this small are tried as ships while soups run, and
+        // only up to this period: the glider and the standard spaceships
+        // have period 4.
+        constexpr size_t MAX_SHIP_CELLS = 64;
+        constexpr uint32_t MAX_SHIP_PERIOD = 8;
+
+        const std::pair<const char*, const char*> COMMON_OBJECTS[] = {
+            { "block", "2o$2o!" },
+            { "beehive", "b2o$o2bo$b2o!" },
+            { "loaf", "b2o$o2bo$bobo$2bo!" },
+            { "boat", "2o$obo$bo!" },
+            { "ship", "2o$obo$b2o!" },
+            { "tub", "bo$obo$bo!" },
+            { "pond", "b2o$o2bo$o2bo$b2o!" },
+            { "long_boat", "2o$obo$bobo$2bo!" },
+            { "barge", "bo$obo$bobo$2bo!" },
+            { "mango", "b2o$o2bo$bo2bo$2b2o!" },
+            { "eater", "2o$obo$2bo$2b2o!" },
+            { "blinker", "3o!" },
+            { "toad", "b3o$3o!" },
+            { "beacon", "2o$2o$2b2o$2b2o!" },
+            { "pentadecathlon", "2bo4bo$2ob4ob2o$2bo4bo!" },
+            { "mwss", "3bo$bo3bo$o$o4bo$5o!" },
+            { "hwss", "3b2o$bo4bo$o$o5bo$6o!" },
+        };
+
+        struct ObjectClass {
+            // 0 for pieces that did not repeat in isolation.
+            uint64_t key = 0;
+            uint64_t period = 0;
+            uint64_t population = 0;
+            uint64_t displacement[2] = {};
+            // Rows and columns moved per period, with sign.
+            int64_t shift[2] = {};
+        };
+
+        struct CensusTable {
+            std::unordered_map<uint64_t, CensusObject> objects;
+            std::unordered_map<std::string, ObjectClass> classified;
+            // Classified up to MAX_SHIP_PERIOD only.
+            std::unordered_map<std::string, ObjectClass> ship_candidates;
+            uint64_t died = 0;
+            uint64_t unsettled = 0;
+            uint64_t escaped = 0;
+            uint64_t generations = 0;
+            uint64_t objects_found = 0;
+        };
+
+        // Moves the bounding box corner to (0, 0) and sorts the cells.
+        // Returns where the corner was.
+        std::pair<int64_t, int64_t> normalize(Cells& cells) {
+            int64_t row = INT64_MAX, column = INT64_MAX;
+            for (auto& cell : cells) {
+                row = std::min(row, cell.first);
+                column = std::min(column, cell.second);
+            }
+            for (auto& cell : cells) {
+                cell.first -= row;
+                cell.second -= column;
+            }
+            std::sort(cells.begin(), cells.end());
+            return { row, column };
+        }
+
+        std::string encode(const Cells& cells) {
+            std::string text;
+            text.reserve(cells.size() * 4);
+            for (auto& cell : cells) {
+                text += char(cell.first >> 8);
+                text += char(cell.first);
+                text += char(cell.second >> 8);
+                text += char(cell.second);
+            }
+            return text;
+        }
+
+        // The smallest encoding over every phase, rotation and reflection.
+        std::string canonicalForm(const std::vector<Cells>& phases) {
+            std::string best;
+            for (const Cells& phase : phases) {
+                for (int transform = 0; transform < 8; transform++) {
+                    Cells cells = phase;
+                    for (auto& cell : cells) {
+                        int64_t row = transform & 1 ? -cell.first : cell.first;
+                        int64_t column = transform & 2 ? -cell.second : cell.second;
+                        cell = transform & 4 ? std::make_pair(column, row) : std::make_pair(row, column);
+                    }
+                    normalize(cells);
+                    std::string text = encode(cells);
+                    if (best.empty() || text < best) {
+                        best = text;
+                    }
+                }
+            }
+            return best;
+        }
+
+        uint64_t hashText(const std::string& text) {
+            uint64_t hash = 0xCBF29CE484222325ull;
+            for (unsigned char c : text) {
+                hash = (hash ^ c) * 0x100000001B3ull;
+            }
+            return hash != 0 ? hash : 1;
+        }
+
+        void stepBoard(const Board& from, Board& to, Rule rule) {
+            RowShape shape { from.width, from.words_per_row, from.lastWordMask() };
+            RowKernel kernel = selectRowKernel(shape, rule, false);
+            std::vector<uint64_t> dead(from.words_per_row);
+            const uint64_t* above = rule.torus ? from.row(from.height - 1) : dead.data();
+            const uint64_t* below = rule.torus ? from.row(0) : dead.data();
+            for (uint64_t i = 0; i < from.height; i++) {
+                kernel(
+                    i != 0 ? from.row(i - 1) : above,
+                    from.row(i),
+                    i + 1 != from.height ? from.row(i + 1) : below,
+                    to.row(i),
+                    shape,
+                    rule,
+                    nullptr,
+                    i
+                );
+            }
+        }
+
+        // Steps a normalized object alone on a bounded board with enough
+        // room for a c/2 ship to travel max_period generations. Anything
+        // that dies, reaches the edge or does not come back by then stays
+        // unclassified.
+        void classifyObject(const Cells& object, Rule rule, uint32_t max_period, ObjectClass& result) {
+            result = ObjectClass();
+            rule.torus = false;
+            int64_t rows = 0, columns = 0;
+            for (auto& cell : object) {
+                rows = std::max(rows, cell.first + 1);
+                columns = std::max(columns, cell.second + 1);
+            }
+            int64_t margin = max_period / 2 + 2;
+            Board board, next;
+            createBoard(columns + 2 * margin, rows + 2 * margin, board);
+            createBoard(columns + 2 * margin, rows + 2 * margin, next);
+            for (auto& cell : object) {
+                board.set(cell.first + margin, cell.second + margin, true);
+            }
+
+            std::vector<Cells> phases(1, object);
+            for (uint32_t g = 1; g <= max_period; g++) {
+                stepBoard(board, next, rule);
+                std::swap(board, next);
+                Cells cells;
+                for (uint64_t i = 0; i < board.height; i++) {
+                    for (uint64_t w = 0; w < board.words_per_row; w++) {
+                        for (uint64_t bits = board.row(i)[w]; bits; bits &= bits - 1) {
+                            cells.emplace_back(i, w * 64 + countTrailingZeros64(bits));
+                        }
+                    }
+                }
+                if (cells.empty()) {
+                    return;
+                }
+                for (auto& cell : cells) {
+                    if (cell.first == 0 || cell.first + 1 == int64_t(board.height)
+                        || cell.second == 0 || cell.second + 1 == int64_t(board.width)) {
+                        return;
+                    }
+                }
+                std::pair<int64_t, int64_t> corner = normalize(cells);
+                if (cells == object) {
+                    result.shift[0] = corner.first - margin;
+                    result.shift[1] = corner.second - margin;
+                    uint64_t rows_moved = std::abs(result.shift[0]);
+                    uint64_t columns_moved = std::abs(result.shift[1]);
+                    result.key = hashText(canonicalForm(phases));
+                    result.period = g;
+                    result.population = object.size();
+                    for (auto& phase : phases) {
+                        result.population = std::min<uint64_t>(result.population, phase.size());
+                    }
+                    result.displacement[0] = std::max(rows_moved, columns_moved);
+                    result.displacement[1] = std::min(rows_moved, columns_moved);
+                    return;
+                }
+                phases.push_back(std::move(cells));
+            }
+        }
+
+        // Normalizes object and returns its class, which stays valid until
+        // the next call with the same cache.
+        const ObjectClass& classify(
+            Cells& object,
+            Rule rule,
+            uint32_t max_period,
+            std::unordered_map<std::string, ObjectClass>& classified
+        ) {
+            normalize(object);
+            std::string form = encode(object);
+            auto found = classified.find(form);
+            if (found == classified.end()) {
+                if (classified.size() >= MAX_CACHED_FORMS) {
+                    classified.clear();
+                }
+                ObjectClass object_class;
+                classifyObject(object, rule, max_period, object_class);
+                found = classified.emplace(std::move(form), object_class).first;
+            }
+            return found->second;
+        }
+
+        void tallyObject(Cells& object, const CensusOptions& options, CensusTable& table) {
+            const ObjectClass& object_class = classify(object, options.rule, options.object_period, table.classified);
+            CensusObject& entry = table.objects[object_class.key];
+            entry.period = object_class.period;
+            entry.population = object_class.population;
+            entry.displacement[0] = object_class.displacement[0];
+            entry.displacement[1] = object_class.displacement[1];
+            entry.count++;
+            table.objects_found++;
+        }
+
+        // Whether the board is empty around the box [top, bottom] x [left,
+        // right] as it moves by shift until it is off the board.
+        bool wayOutClear(const Board& board, int64_t top, int64_t bottom, int64_t left, int64_t right, const int64_t shift[2]) {
+            int64_t height = board.height, width = board.width;
+            while (bottom >= 0 && top < height && right >= 0 && left < width) {
+                int64_t row_end = std::min(bottom + ESCAPE_CLEARANCE, height - 1);
+                int64_t column_end = std::min(right + ESCAPE_CLEARANCE, width - 1);
+                for (int64_t i = std::max<int64_t>(top - ESCAPE_CLEARANCE, 0); i <= row_end; i++) {
+                    for (int64_t j = std::max<int64_t>(left - ESCAPE_CLEARANCE, 0); j <= column_end; j++) {
+                        if (board.get(i, j)) {
+                            return false;
+                        }
+                    }
+                }
+                top += shift[0];
+                bottom += shift[0];
+                left += shift[1];
+                right += shift[1];
+            }
+            return true;
+        }
+
+        // Tallies the ships within band cells of the edge of a bounded
+        // board that nothing stands in the way of, and moves their cells
+        // from board to escaped. Returns how many there were.
+        uint64_t removeEscapingShips(Board& board, int64_t band, const CensusOptions& options, CensusTable& table, Board& escaped) {
+            int64_t height = board.height, width = board.width;
+            Board seen;
+            createBoard(board.width, board.height, seen);
+            createBoard(board.width, board.height, escaped);
+            uint64_t ships = 0;
+            std::vector<std::pair<int64_t, int64_t>> stack;
+            for (int64_t i = 0; i < height; i++) {
+                bool edge_row = i < band || i >= height - band;
+                for (uint64_t w = 0; w < board.words_per_row; w++) {
+                    for (uint64_t bits = board.row(i)[w] & ~seen.row(i)[w]; bits; bits &= bits - 1) {
+                        int64_t j = w * 64 + countTrailingZeros64(bits);
+                        if ((!edge_row && j >= band && j < width - band) || seen.get(i, j)) {
+                            continue;
+                        }
+                        Cells piece;
+                        seen.set(i, j, true);
+                        stack.emplace_back(i, j);
+                        while (!stack.empty()) {
+                            auto cell = stack.back();
+                            stack.pop_back();
+                            piece.push_back(cell);
+                            for (int64_t ni = cell.first - 1; ni <= cell.first + 1; ni++) {
+                                for (int64_t nj = cell.second - 1; nj <= cell.second + 1; nj++) {
+                                    if (ni >= 0 && nj >= 0 && ni < height && nj < width && board.get(ni, nj) && !seen.get(ni, nj)) {
+                                        seen.set(ni, nj, true);
+                                        stack.emplace_back(ni, nj);
+                                    }
+                                }
+                            }
+                        }
+                        if (piece.size() > MAX_SHIP_CELLS) {
+                            continue;
+                        }
+                        Cells form = piece;
+                        std::pair<int64_t, int64_t> corner = normalize(form);
+                        const ObjectClass& candidate = classify(form, options.rule, MAX_SHIP_PERIOD, table.ship_candidates);
+                        if (candidate.key == 0 || candidate.displacement[0] == 0) {
+                            continue;
+                        }
+                        int64_t bottom = corner.first, right = corner.second;
+                        for (auto& cell : piece) {
+                            board.set(cell.first, cell.second, false);
+                            bottom = std::max(bottom, cell.first);
+                            right = std::max(right, cell.second);
+                        }
+                        bool clear = wayOutClear(board, corner.first, bottom, corner.second, right, candidate.shift);
+                        for (auto& cell : piece) {
+                            board.set(cell.first, cell.second, !clear);
+                            escaped.set(cell.first, cell.second, clear);
+                        }
+                        if (clear) {
+                            tallyObject(form, options, table);
+                            ships++;
+                        }
+                    }
+                }
+            }
+            table.escaped += ships;
+            return ships;
+        }
+
+        // Objects are the 8-connected pieces of the union of all `period`
+        // phases, so an oscillator whose phases touch different cells is
+        // still one object. On a torus, pieces are followed across the
+        // edges.
+        void censusSoup(const Board& board, uint64_t period, const CensusOptions& options, CensusTable& table) {
+            Board remaining = board;
+            Board phase = board, next;
+            createBoard(board.width, board.height, next);
+            for (uint64_t p = 1; p < period; p++) {
+                stepBoard(phase, next, options.rule);
+                std::swap(phase, next);
+                for (size_t w = 0; w < remaining.words.size(); w++) {
+                    remaining.words[w] |= phase.words[w];
+                }
+            }
+
+            struct Visit {
+                uint64_t row, column;
+                int64_t unwrapped_row, unwrapped_column;
+            };
+            std::vector<Visit> stack;
+            int64_t height = board.height, width = board.width;
+            for (uint64_t i = 0; i < board.height; i++) {
+                for (uint64_t w = 0; w < board.words_per_row; w++) {
+                    while (remaining.row(i)[w]) {
+                        uint64_t j = w * 64 + countTrailingZeros64(remaining.row(i)[w]);
+                        remaining.set(i, j, false);
+                        stack.push_back({ i, j, int64_t(i), int64_t(j) });
+                        Cells object;
+                        while (!stack.empty()) {
+                            Visit v = stack.back();
+                            stack.pop_back();
+                            if (board.get(v.row, v.column)) {
+                                object.emplace_back(v.unwrapped_row, v.unwrapped_column);
+                            }
+                            for (int64_t di = -1; di <= 1; di++) {
+                                for (int64_t dj = -1; dj <= 1; dj++) {
+                                    int64_t ni = int64_t(v.row) + di, nj = int64_t(v.column) + dj;
+                                    if (options.rule.torus) {
+                                        ni = (ni + height) % height;
+                                        nj = (nj + width) % width;
+                                    } else if (ni < 0 || nj < 0 || ni >= height || nj >= width) {
+                                        continue;
+                                    }
+                                    if (remaining.get(ni, nj)) {
+                                        remaining.set(ni, nj, false);
+                                        stack.push_back({ uint64_t(ni), uint64_t(nj), v.unwrapped_row + di, v.unwrapped_column + dj });
+                                    }
+                                }
+                            }
+                        }
+                        if (!object.empty()) {
+                            tallyObject(object, options, table);
+                        }
+                    }
+                }
+            }
+        }
+
+        std::unordered_map<uint64_t, std::string> commonNames(const CensusOptions& options) {
+            std::unordered_map<uint64_t, std::string> names;
+            if (!options.rule.isLife()) {
+                return names;
+            }
+            std::vector<std::pair<std::string, Pattern>> patterns;
+            for (auto& common : COMMON_OBJECTS) {
+                patterns.emplace_back(common.first, Pattern());
+                parseRle(common.second, patterns.back().second);
+            }
+            for (const char* builtin : { "glider", "lwss", "pulsar" }) {
+                patterns.emplace_back(builtin, Pattern());
+                builtinPattern(builtin, patterns.back().second);
+            }
+            for (auto& named : patterns) {
+                Cells cells;
+                for (auto& cell : named.second.cells) {
+                    cells.emplace_back(cell.first, cell.second);
+                }
+                normalize(cells);
+                ObjectClass object_class;
+                classifyObject(cells, options.rule, options.object_period, object_class);
+                if (object_class.key != 0) {
+                    names[object_class.key] = named.first;
+                }
+            }
+            return names;
+        }
+
+        std::string objectName(uint64_t key, const CensusObject& object) {
+            if (key == 0) {
+                return "unstable";
+            }
+            std::ostringstream name;
+            if (object.displacement[0] != 0) {
+                name << "ship:p" << object.period;
+            } else if (object.period > 1) {
+                name << "osc:p" << object.period;
+            } else {
+                name << "still:" << object.population;
+            }
+            name << ":" << std::hex << std::setw(8) << std::setfill('0') << (key >> 32);
+            return name.str();
+        }
+    }
+
+    void runCensus(const CensusOptions& options, ThreadPool& pool, CensusReport& report) {
+        GAME_TRACE_SCOPE("census");
+        if (options.batch == 0) {
+            throw std::runtime_error("census batch must hold at least one soup");
+        }
+        auto begin = std::chrono::steady_clock::now();
+        std::unordered_map<uint64_t, std::string> names = commonNames(options);
+        std::vector<CensusTable> tables(pool.size());
+
+        std::unique_ptr<Ensemble> ensemble;
+        for (uint64_t first = 0; first < options.soups; first += options.batch) {
+            uint64_t count = std::min(options.batch, options.soups - first);
+            if (!ensemble || ensemble->size() != count) {
+                ensemble.reset(new Ensemble(options.width, options.height, count, options.rule));
+            }
+            ensemble->seed(options.seed + first, options.density, pool);
+            // Ships can't leave a torus, so those soups run in one go. Runs
+            // are kept long enough to see repeats of every allowed period.
+            uint64_t chunk = options.rule.torus
+                ? options.generations
+                : std::max<uint64_t>(ESCAPE_CHECK_GENERATIONS, 4 * options.max_period);
+            for (uint64_t generation = 0; generation < options.generations; generation += chunk) {
+                ensemble->run(std::min(chunk, options.generations - generation), options.max_period, pool);
+                if (options.rule.torus || generation + chunk >= options.generations) {
+                    break;
+                }
+                // Erasing from a board touches its whole group, so workers
+                // take whole groups of 64.
+                std::atomic<uint64_t> running(0);
+                pool.parallelFor((count + 63) / 64, [&](uint64_t group_begin, uint64_t group_end, uint32_t worker) {
+                    GAME_TRACE_SCOPE("census escapes");
+                    CensusTable& table = tables[worker];
+                    Board board, escaped;
+                    uint64_t still_running = 0;
+                    for (uint64_t k = group_begin * 64; k < std::min(group_end * 64, count); k++) {
+                        if (ensemble->result(k).end != EnsembleEnd::Running) {
+                            continue;
+                        }
+                        still_running++;
+                        ensemble->store(k, board);
+                        if (removeEscapingShips(board, chunk, options, table, escaped) != 0) {
+                            ensemble->erase(k, escaped);
+                        }
+                    }
+                    running.fetch_add(still_running, std::memory_order_relaxed);
+                });
+                if (running.load(std::memory_order_relaxed) == 0) {
+                    break;
+                }
+            }
+            pool.parallelFor(count, [&](uint64_t soup_begin, uint64_t soup_end, uint32_t worker) {
+                GAME_TRACE_SCOPE("census objects");
+                CensusTable& table = tables[worker];
+                Board board;
+                for (uint64_t k = soup_begin; k < soup_end; k++) {
+                    const EnsembleResult& result = ensemble->result(k);
+                    table.generations += result.generation;
+                    if (result.end == EnsembleEnd::Died) {
+                        table.died++;
+                        continue;
+                    }
+                    if (result.end == EnsembleEnd::Running) {
+                        table.unsettled++;
+                        continue;
+                    }
+                    ensemble->store(k, board);
+                    censusSoup(board, std::max<uint64_t>(result.period, 1), options, table);
+                }
+            });
+        }
+
+        report = CensusReport();
+        report.soups = options.soups;
+        std::unordered_map<uint64_t, CensusObject> merged;
+        for (CensusTable& table : tables) {
+            report.died += table.died;
+            report.unsettled += table.unsettled;
+            report.escaped += table.escaped;
+            report.generations += table.generations;
+            report.objects += table.objects_found;
+            for (auto& entry : table.objects) {
+                CensusObject& object = merged[entry.first];
+                uint64_t count = object.count + entry.second.count;
+                object = entry.second;
+                object.count = count;
+            }
+        }
+        for (auto& entry : merged) {
+            auto name = names.find(entry.first);
+            entry.second.name = name != names.end() ? name->second : objectName(entry.first, entry.second);
+            report.census.push_back(entry.second);
+        }
+        std::sort(report.census.begin(), report.census.end(), [](const CensusObject& a, const CensusObject& b) {
+            return a.count != b.count ? a.count > b.count : a.name < b.name;
+        });
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef __CENSUS__HPP__
+#define __CENSUS__HPP__
+
+#include "board.hpp"
+#include "thread_pool.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace game {
+    struct CensusOptions {
+        // Every soup fills a whole board of this size.
+        uint64_t width = 64;
+        uint64_t height = 64;
+        Rule rule = Rule::life();
+        uint64_t soups = 65536;
+        // Soups stepped together in one Ensemble.
+        uint64_t batch = 4096;
+        uint64_t seed = 0;
+        double density = 0.5;
+        // A soup counts as settled once it repeats with a period of at
+        // most max_period, and is given up on after `generations`.
+        uint64_t generations = 20000;
+        uint32_t max_period = 3;
+        // Objects are classified by stepping them on their own for up to
+        // this many generations.
+        uint32_t object_period = 64;
+    };
+
+    struct CensusObject {
+        // A common name under B3/S23, otherwise still:<population>:<hash>,
+        // osc:p<period>:<hash> or ship:p<period>:<hash>. "unstable" counts
+        // pieces of settled soups that did not repeat in isolation, such
+        // as ones held up by the edge of the board.
+        std::string name;
+        uint64_t period = 0;
+        // Smallest population over all phases.
+        uint64_t population = 0;
+        // Cells moved per period, larger axis first; zero unless a ship.
+        uint64_t displacement[2] = {};
+        uint64_t count = 0;
+    };
+
+    struct CensusReport {
+        uint64_t soups = 0;
+        uint64_t died = 0;
+        // Soups still not repeating after the generation limit. Their
+        // cells are left out of the census.
+        uint64_t unsettled = 0;
+        // Ships taken off soups on their way out, also in the census.
+        uint64_t escaped = 0;
+        uint64_t generations = 0;
+        uint64_t objects = 0;
+        // Most common first.
+        std::vector<CensusObject> census;
+        double seconds = 0.;
+    };
+
+    // Runs soups seed, seed + 1, ... to stabilisation in an Ensemble, then
+    // splits each final board into objects (8-connected pieces of the
+    // union of all phases of its cycle) and tallies them under a name
+    // that is the same for every phase, rotation and reflection. On
+    // bounded boards, ships with a clear way out are tallied and taken
+    // off while the soups run, before the edge can wreck them. Each pool
+    // worker tallies into its own table; the tables are merged once at
+    // the end.
+    void runCensus(const CensusOptions& options, ThreadPool& pool, CensusReport& report);
+}
+
+#endif // __CENSUS__HPP__
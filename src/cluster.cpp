@@ -0,0 +1,264 @@
+#include "cluster.hpp"
+#include "kernels.hpp"
+#include "seed.hpp"
+#include "thread_pool.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace game {
+    namespace {
+        enum CommandKind : uint32_t {
+            COMMAND_STEP,
+            COMMAND_SNAPSHOT,
+            COMMAND_QUIT
+        };
+
+        struct Command {
+            uint32_t kind;
+            uint64_t value;
+        };
+
+        // Owns rows [begin, end) of the board plus one halo row above and
+        // below: local row 0 is board row begin - 1.
+        class Worker {
+        public:
+            Worker(
+                const ClusterOptions& options,
+                uint32_t index,
+                uint64_t begin,
+                uint64_t end,
+                std::unique_ptr<Channel> control,
+                std::unique_ptr<Channel> up,
+                std::unique_ptr<Channel> down
+            ) : options(options), index(index), begin(begin), end(end),
+                control(std::move(control)), up(std::move(up)), down(std::move(down)),
+                pool(options.threads_per_worker), worker_stats(pool.size()) {
+                createBoard(options.width, end - begin + 2, current);
+                createBoard(options.width, end - begin + 2, next);
+                shape = RowShape { current.width, current.words_per_row, current.lastWordMask() };
+                kernel = selectRowKernel(shape, options.rule, false);
+                stats_kernel = selectRowKernel(shape, options.rule, true);
+                seedStripe();
+            }
+
+            void run() {
+                while (true) {
+                    Command command;
+                    control->receive(&command, sizeof(command));
+                    if (command.kind == COMMAND_STEP) {
+                        step(command.value);
+                        control->send(&step_stats, sizeof(step_stats));
+                    } else if (command.kind == COMMAND_SNAPSHOT) {
+                        control->send(current.row(1), (end - begin) * current.words_per_row * sizeof(uint64_t));
+                    } else {
+                        return;
+                    }
+                }
+            }
+
+        private:
+            void seedStripe() {
+                uint64_t key = seedKey(options.seed);
+                uint32_t threshold = densityThreshold(options.density);
+                for (uint64_t i = begin; i < end; i++) {
+                    uint64_t* row = current.row(i - begin + 1);
+                    for (uint64_t w = 0; w < current.words_per_row; w++) {
+                        row[w] = randomCells(key, i * current.words_per_row + w, threshold);
+                    }
+                    row[current.words_per_row - 1] &= current.lastWordMask();
+                }
+            }
+
+            // Even workers talk to their lower neighbour first and odd ones
+            // to their upper one, and within a pair the even side sends
+            // first, so no exchange ever waits on a third worker.
+            void exchangeHalos() {
+                uint64_t rows = end - begin;
+                size_t bytes = current.words_per_row * sizeof(uint64_t);
+                auto with_up = [&]() {
+                    if (!up) {
+                        return;
+                    }
+                    if (index % 2 == 0) {
+                        up->send(current.row(1), bytes);
+                        up->receive(current.row(0), bytes);
+                    } else {
+                        up->receive(current.row(0), bytes);
+                        up->send(current.row(1), bytes);
+                    }
+                };
+                auto with_down = [&]() {
+                    if (!down) {
+                        return;
+                    }
+                    if (index % 2 == 0) {
+                        down->send(current.row(rows), bytes);
+                        down->receive(current.row(rows + 1), bytes);
+                    } else {
+                        down->receive(current.row(rows + 1), bytes);
+                        down->send(current.row(rows), bytes);
+                    }
+                };
+                if (index % 2 == 0) {
+                    with_down();
+                    with_up();
+                } else {
+                    with_up();
+                    with_down();
+                }
+            }
+
+            void step(uint64_t generations) {
+                for (uint64_t g = 0; g < generations; g++) {
+                    exchangeHalos();
+                    bool last = g + 1 == generations;
+                    if (last) {
+                        std::fill(worker_stats.begin(), worker_stats.end(), StepStats());
+                    }
+                    pool.parallelFor(end - begin, [this, last](uint64_t first, uint64_t stop, uint32_t worker) {
+                        RowKernel step_row = last ? stats_kernel : kernel;
+                        for (uint64_t r = first + 1; r < stop + 1; r++) {
+                            step_row(
+                                current.row(r - 1),
+                                current.row(r),
+                                current.row(r + 1),
+                                next.row(r),
+                                shape,
+                                options.rule,
+                                &worker_stats[worker],
+                                begin + r - 1
+                            );
+                        }
+                    });
+                    std::swap(current, next);
+                }
+                step_stats = StepStats();
+                for (auto& s : worker_stats) {
+                    step_stats.merge(s);
+                }
+            }
+
+            ClusterOptions options;
+            uint32_t index;
+            uint64_t begin;
+            uint64_t end;
+            std::unique_ptr<Channel> control;
+            std::unique_ptr<Channel> up;
+            std::unique_ptr<Channel> down;
+            ThreadPool pool;
+            std::vector<StepStats> worker_stats;
+            StepStats step_stats;
+            Board current;
+            Board next;
+            RowShape shape;
+            RowKernel kernel;
+            RowKernel stats_kernel;
+        };
+    }
+
+    Cluster::Cluster(const ClusterOptions& options) : options(options) {
+        if (options.workers == 0 || options.workers > options.height) {
+            throw std::runtime_error("cluster needs between 1 and height workers");
+        }
+        if (options.rule.torus) {
+            throw std::runtime_error("cluster only steps bounded boards");
+        }
+        size_t row_bytes = (options.width + 63) / 64 * sizeof(uint64_t);
+        // Worker k talks to the coordinator over control pair k and to
+        // worker k + 1 over halo pair k.
+        std::vector<std::unique_ptr<Channel>> coordinator_ends(options.workers), worker_ends(options.workers);
+        std::vector<std::unique_ptr<Channel>> upper_ends(options.workers - 1), lower_ends(options.workers - 1);
+        for (uint32_t k = 0; k < options.workers; k++) {
+            createChannelPair(options.transport, 4096, coordinator_ends[k], worker_ends[k]);
+        }
+        for (uint32_t k = 0; k + 1 < options.workers; k++) {
+            createChannelPair(options.transport, 2 * row_bytes, upper_ends[k], lower_ends[k]);
+        }
+
+        for (auto& end : coordinator_ends) {
+            end->attach();
+        }
+        for (uint32_t k = 0; k < options.workers; k++) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                throw std::runtime_error("fork failed");
+            }
+            if (pid == 0) {
+                int status = 0;
+                try {
+                    std::unique_ptr<Channel> own_control = std::move(worker_ends[k]);
+                    std::unique_ptr<Channel> up = k > 0 ? std::move(lower_ends[k - 1]) : nullptr;
+                    std::unique_ptr<Channel> down = k + 1 < options.workers ? std::move(upper_ends[k]) : nullptr;
+                    own_control->attach();
+                    if (up) {
+                        up->attach();
+                    }
+                    if (down) {
+                        down->attach();
+                    }
+                    coordinator_ends.clear();
+                    worker_ends.clear();
+                    upper_ends.clear();
+                    lower_ends.clear();
+                    control.clear();
+                    Worker worker(options, k, stripeBegin(k), stripeBegin(k + 1), std::move(own_control), std::move(up), std::move(down));
+                    worker.run();
+                } catch (std::exception& e) {
+                    std::cerr << "worker " << k << ": " << e.what() << std::endl;
+                    status = 1;
+                }
+                _exit(status);
+            }
+            pids.push_back(pid);
+            control.push_back(std::move(coordinator_ends[k]));
+        }
+    }
+
+    Cluster::~Cluster() {
+        try {
+            broadcast(COMMAND_QUIT, 0);
+        } catch (std::exception&) {
+        }
+        control.clear();
+        for (pid_t pid : pids) {
+            waitpid(pid, nullptr, 0);
+        }
+    }
+
+    uint64_t Cluster::stripeBegin(uint32_t worker) const {
+        return options.height * worker / options.workers;
+    }
+
+    void Cluster::broadcast(uint32_t kind, uint64_t value) {
+        Command command { kind, value };
+        for (auto& channel : control) {
+            channel->send(&command, sizeof(command));
+        }
+    }
+
+    void Cluster::step(uint64_t generations) {
+        if (generations == 0) {
+            return;
+        }
+        broadcast(COMMAND_STEP, generations);
+        step_stats = StepStats();
+        for (auto& channel : control) {
+            StepStats stats;
+            channel->receive(&stats, sizeof(stats));
+            step_stats.merge(stats);
+        }
+    }
+
+    void Cluster::snapshot(Board& board) {
+        createBoard(options.width, options.height, board);
+        broadcast(COMMAND_SNAPSHOT, 0);
+        for (uint32_t k = 0; k < options.workers; k++) {
+            uint64_t rows = stripeBegin(k + 1) - stripeBegin(k);
+            control[k]->receive(board.row(stripeBegin(k)), rows * board.words_per_row * sizeof(uint64_t));
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef __CLUSTER__HPP__
+#define __CLUSTER__HPP__
+
+#include "board.hpp"
+#include "transport.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <sys/types.h>
+
+namespace game {
+    struct ClusterOptions {
+        uint64_t width = 1024;
+        uint64_t height = 1024;
+        uint32_t workers = 2;
+        std::string transport = "socket";
+        uint32_t threads_per_worker = 1;
+        Rule rule = Rule::life();
+        uint64_t seed = 0;
+        double density = 0.5;
+    };
+
+    // Splits the board into horizontal stripes, one per forked worker
+    // process. Each generation neighbouring workers swap their edge rows
+    // over the chosen transport. The coordinator (the constructing
+    // process) only sends commands and gathers statistics and snapshots,
+    // it never holds the board unless asked for a snapshot.
+    //
+    // Workers seed their own stripe exactly as seedSoup(board, "full",
+    // seed, density, ...) would seed the whole board.
+    class Cluster {
+    public:
+        explicit Cluster(const ClusterOptions& options);
+        ~Cluster();
+
+        Cluster(const Cluster&) = delete;
+        Cluster& operator=(const Cluster&) = delete;
+
+        void step(uint64_t generations);
+        void snapshot(Board& board);
+
+        // Merged from every worker, for the last generation stepped.
+        const StepStats& stats() const {
+            return step_stats;
+        }
+
+        uint64_t stripeBegin(uint32_t worker) const;
+
+    private:
+        void broadcast(uint32_t kind, uint64_t value);
+
+        ClusterOptions options;
+        std::vector<pid_t> pids;
+        std::vector<std::unique_ptr<Channel>> control;
+        StepStats step_stats;
+    };
+}
+
+#endif // __CLUSTER__HPP__
@@ -0,0 +1,171 @@
+#include "delta.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace game {
+    namespace {
+        void xorWord(Board& board, uint64_t index, uint64_t x, StepStats* stats) {
+            if (index >= board.words.size()) {
+                throw std::runtime_error("delta reaches outside the board");
+            }
+            uint64_t& word = board.words[index];
+            if (stats) {
+                stats->births += popcount64(x & ~word);
+                stats->deaths += popcount64(x & word);
+            }
+            word ^= x;
+        }
+    }
+
+    void writeVarint(std::vector<uint8_t>& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(uint8_t(value) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(uint8_t(value));
+    }
+
+    uint64_t readVarint(const uint8_t*& p, const uint8_t* end) {
+        uint64_t value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7) {
+            if (p == end) {
+                break;
+            }
+            uint8_t byte = *p++;
+            value |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw std::runtime_error("truncated varint");
+    }
+
+    void encodeWordDelta(const Board* before, const Board& after, std::vector<uint8_t>& out) {
+        const uint64_t* a = before ? before->words.data() : nullptr;
+        const uint64_t* b = after.words.data();
+        uint64_t count = after.words.size();
+        uint64_t last_end = 0;
+        uint64_t i = 0;
+        while (i < count) {
+            if ((a ? a[i] : 0) == b[i]) {
+                i++;
+                continue;
+            }
+            uint64_t begin = i;
+            while (i < count && (a ? a[i] : 0) != b[i]) {
+                i++;
+            }
+            writeVarint(out, begin - last_end);
+            writeVarint(out, i - begin);
+            size_t offset = out.size();
+            out.resize(offset + (i - begin) * sizeof(uint64_t));
+            for (uint64_t k = begin; k < i; k++) {
+                uint64_t x = (a ? a[k] : 0) ^ b[k];
+                std::memcpy(out.data() + offset + (k - begin) * sizeof(uint64_t), &x, sizeof(x));
+            }
+            last_end = i;
+        }
+    }
+
+    void wordDeltaToCellRuns(const uint8_t* data, size_t size, uint64_t words_per_row, std::vector<uint8_t>& out) {
+        const uint8_t* p = data;
+        const uint8_t* end = data + size;
+        std::vector<std::pair<uint64_t, uint64_t>> runs;
+        uint64_t run_row = UINT64_MAX;
+        uint64_t next_row = 0;
+        auto flushRow = [&]() {
+            if (runs.empty()) {
+                return;
+            }
+            writeVarint(out, run_row - next_row);
+            writeVarint(out, runs.size());
+            uint64_t column = 0;
+            for (auto& run : runs) {
+                writeVarint(out, run.first - column);
+                writeVarint(out, run.second - run.first);
+                column = run.second;
+            }
+            next_row = run_row + 1;
+            runs.clear();
+        };
+
+        uint64_t position = 0;
+        while (p < end) {
+            position += readVarint(p, end);
+            uint64_t length = readVarint(p, end);
+            for (uint64_t k = 0; k < length; k++, position++) {
+                uint64_t x;
+                std::memcpy(&x, p, sizeof(x));
+                p += sizeof(x);
+                uint64_t row = position / words_per_row;
+                uint64_t base = position % words_per_row * 64;
+                if (row != run_row) {
+                    flushRow();
+                    run_row = row;
+                }
+                while (x) {
+                    uint32_t first = countTrailingZeros64(x);
+                    uint64_t ones = ~(x >> first);
+                    uint32_t count = ones ? countTrailingZeros64(ones) : 64 - first;
+                    uint64_t begin = base + first;
+                    if (!runs.empty() && runs.back().second == begin) {
+                        runs.back().second = begin + count;
+                    } else {
+                        runs.emplace_back(begin, begin + count);
+                    }
+                    x = first + count == 64 ? 0 : x & (~uint64_t(0) << (first + count));
+                }
+            }
+        }
+        flushRow();
+    }
+
+    void applyWordDelta(const uint8_t* data, size_t size, Board& board, StepStats* stats) {
+        const uint8_t* p = data;
+        const uint8_t* end = data + size;
+        uint64_t position = 0;
+        while (p < end) {
+            position += readVarint(p, end);
+            uint64_t length = readVarint(p, end);
+            if (length > uint64_t(end - p) / sizeof(uint64_t)) {
+                throw std::runtime_error("truncated word delta");
+            }
+            for (uint64_t k = 0; k < length; k++) {
+                uint64_t x;
+                std::memcpy(&x, p, sizeof(x));
+                p += sizeof(x);
+                xorWord(board, position++, x, stats);
+            }
+        }
+    }
+
+    void applyCellRuns(const uint8_t* data, size_t size, Board& board, StepStats* stats) {
+        const uint8_t* p = data;
+        const uint8_t* end = data + size;
+        uint64_t row = 0;
+        while (p < end) {
+            row += readVarint(p, end);
+            uint64_t count = readVarint(p, end);
+            uint64_t column = 0;
+            for (uint64_t r = 0; r < count; r++) {
+                column += readVarint(p, end);
+                uint64_t stop = column + readVarint(p, end);
+                if (row >= board.height || stop > board.width) {
+                    throw std::runtime_error("cell run reaches outside the board");
+                }
+                // Split the run into per-word masks.
+                while (column < stop) {
+                    uint64_t w = column / 64;
+                    uint32_t first = column % 64;
+                    uint64_t last = std::min<uint64_t>(stop, (w + 1) * 64);
+                    uint32_t bits = uint32_t(last - column);
+                    uint64_t mask = (bits == 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1) << first;
+                    xorWord(board, row * board.words_per_row + w, mask, stats);
+                    column = last;
+                }
+            }
+            row++;
+        }
+    }
+}
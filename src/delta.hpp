@@ -0,0 +1,29 @@
+#ifndef __DELTA__HPP__
+#define __DELTA__HPP__
+
+#include "board.hpp"
+
+#include <vector>
+#include <cstdint>
+
+namespace game {
+    void writeVarint(std::vector<uint8_t>& out, uint64_t value);
+    // Reads from p up to end and advances p, throwing past end.
+    uint64_t readVarint(const uint8_t*& p, const uint8_t* end);
+
+    // [gap][length][length XOR words] per run of changed words, appended
+    // to out. A null before encodes against an empty board.
+    void encodeWordDelta(const Board* before, const Board& after, std::vector<uint8_t>& out);
+    // Same changes as [row gap][run count] and then [column gap][length]
+    // per run of changed cells, for every row with changes. Converted from
+    // a word delta of a board words_per_row wide, so only changed words
+    // are looked at.
+    void wordDeltaToCellRuns(const uint8_t* data, size_t size, uint64_t words_per_row, std::vector<uint8_t>& out);
+
+    // Both throw on data that reaches outside the board. With stats set,
+    // births and deaths count the cells the delta turned on and off.
+    void applyWordDelta(const uint8_t* data, size_t size, Board& board, StepStats* stats = nullptr);
+    void applyCellRuns(const uint8_t* data, size_t size, Board& board, StepStats* stats = nullptr);
+}
+
+#endif // __DELTA__HPP__
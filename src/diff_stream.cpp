@@ -0,0 +1,308 @@
+#include "diff_stream.hpp"
+#include "delta.hpp"
+#include "trace.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+namespace game {
+    namespace {
+        constexpr char MAGIC[8] = { 'G', 'O', 'L', 'D', 'I', 'F', 'F', '1' };
+        constexpr size_t STREAM_HEADER_BYTES = 32;
+        constexpr size_t RECORD_HEADER_BYTES = 16;
+
+        void putLittleEndian(uint8_t* out, uint64_t value, int bytes) {
+            for (int b = 0; b < bytes; b++) {
+                out[b] = uint8_t(value >> (8 * b));
+            }
+        }
+
+        uint64_t getLittleEndian(const uint8_t* in, int bytes) {
+            uint64_t value = 0;
+            for (int b = 0; b < bytes; b++) {
+                value |= uint64_t(in[b]) << (8 * b);
+            }
+            return value;
+        }
+
+        int openOutput(const std::string& output) {
+            if (output == "-") {
+#ifdef _WIN32
+                _setmode(_fileno(stdout), _O_BINARY);
+#endif
+                return 1;
+            }
+#ifdef _WIN32
+            int fd = _open(output.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+            int fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+            if (fd < 0) {
+                throw std::runtime_error("couldn't open " + output);
+            }
+            return fd;
+        }
+    }
+
+    DiffStreamWriter::DiffStreamWriter(std::string output, Rule rule, uint64_t keyframe_interval)
+        : fd(openOutput(output)), owned(output != "-"), rule(rule), keyframe_interval(keyframe_interval) {
+        thread = std::thread(&DiffStreamWriter::writerLoop, this);
+    }
+
+    DiffStreamWriter::~DiffStreamWriter() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_done.wait(lock, [this]() { return !pending; });
+            if (filling->count != 0 && error.empty()) {
+                handOff(lock);
+                work_done.wait(lock, [this]() { return !pending; });
+            }
+            stopping = true;
+        }
+        work_ready.notify_one();
+        thread.join();
+        if (owned) {
+#ifdef _WIN32
+            _close(fd);
+#else
+            close(fd);
+#endif
+        }
+        if (!error.empty()) {
+            std::cerr << error << std::endl;
+        }
+    }
+
+    std::vector<uint8_t>& DiffStreamWriter::nextRecord() {
+        if (filling->count == filling->records.size()) {
+            filling->records.emplace_back();
+        }
+        std::vector<uint8_t>& record = filling->records[filling->count++];
+        record.clear();
+        return record;
+    }
+
+    void DiffStreamWriter::write(const Board& board, uint64_t generation) {
+        GAME_TRACE_SCOPE("stream encode");
+        if (!started) {
+            std::vector<uint8_t>& header = nextRecord();
+            header.resize(STREAM_HEADER_BYTES);
+            std::memcpy(header.data(), MAGIC, sizeof(MAGIC));
+            putLittleEndian(&header[8], board.width, 8);
+            putLittleEndian(&header[16], board.height, 8);
+            putLittleEndian(&header[24], rule.birth, 2);
+            putLittleEndian(&header[26], rule.survive, 2);
+            header[28] = rule.torus;
+            filling->bytes += header.size();
+        } else if (board.width != previous.width || board.height != previous.height) {
+            throw std::runtime_error("a diff stream keeps the board size it started with");
+        }
+
+        bool keyframe = !started || (keyframe_interval != 0 && ++since_keyframe >= keyframe_interval);
+        if (keyframe) {
+            since_keyframe = 0;
+        }
+        delta.clear();
+        runs.clear();
+        encodeWordDelta(keyframe ? nullptr : &previous, board, delta);
+        wordDeltaToCellRuns(delta.data(), delta.size(), board.words_per_row, runs);
+        const std::vector<uint8_t>& payload = runs.size() < delta.size() ? runs : delta;
+        uint8_t kind = (&payload == &runs ? DIFF_RECORD_CELL_RUNS : DIFF_RECORD_WORDS) | (keyframe ? DIFF_RECORD_KEYFRAME : 0);
+        if (payload.size() > MAX_PAYLOAD_BYTES) {
+            throw std::runtime_error(
+                "generation " + std::to_string(generation) + " needs a " + std::to_string(payload.size() >> 20)
+                + " MiB diff stream record, more than a record can hold"
+            );
+        }
+
+        std::vector<uint8_t>& record = nextRecord();
+        record.resize(RECORD_HEADER_BYTES);
+        putLittleEndian(&record[0], generation, 8);
+        putLittleEndian(&record[8], payload.size(), 4);
+        record[12] = kind;
+        record.insert(record.end(), payload.begin(), payload.end());
+        filling->bytes += record.size();
+
+        previous = board;
+        started = true;
+        if (filling->bytes >= BATCH_BYTES) {
+            submit();
+        }
+    }
+
+    void DiffStreamWriter::submit() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+        if (filling->bytes >= MAX_PENDING_BYTES) {
+            work_done.wait(lock, [this]() { return !pending; });
+        }
+        if (!pending && filling->count != 0) {
+            handOff(lock);
+        }
+    }
+
+    // The batch just written becomes the filling one, so its record
+    // buffers are reused instead of reallocated.
+    void DiffStreamWriter::handOff(std::unique_lock<std::mutex>&) {
+        std::swap(filling, writing);
+        filling->count = 0;
+        filling->bytes = 0;
+        pending = true;
+        work_ready.notify_one();
+    }
+
+    void DiffStreamWriter::writerLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            work_ready.wait(lock, [this]() { return pending || stopping; });
+            if (!pending) {
+                return;
+            }
+            lock.unlock();
+            std::string failure;
+            try {
+                writeBatch(*writing);
+            } catch (std::exception& e) {
+                failure = e.what();
+            }
+            lock.lock();
+            if (!failure.empty()) {
+                error = failure;
+            }
+            pending = false;
+            work_done.notify_all();
+        }
+    }
+
+    void DiffStreamWriter::writeBatch(Batch& batch) {
+        GAME_TRACE_SCOPE("stream write");
+#ifdef _WIN32
+        for (size_t r = 0; r < batch.count; r++) {
+            const std::vector<uint8_t>& record = batch.records[r];
+            if (_write(fd, record.data(), unsigned(record.size())) != int(record.size())) {
+                throw std::runtime_error("diff stream write failed");
+            }
+        }
+#else
+        std::vector<iovec> pieces(batch.count);
+        for (size_t r = 0; r < batch.count; r++) {
+            pieces[r].iov_base = batch.records[r].data();
+            pieces[r].iov_len = batch.records[r].size();
+        }
+        size_t next = 0;
+        while (next < pieces.size()) {
+            int count = int(std::min<size_t>(pieces.size() - next, IOV_MAX));
+            ssize_t written = writev(fd, &pieces[next], count);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("diff stream write failed: ") + std::strerror(errno));
+            }
+            // A short write can end anywhere, even inside a record.
+            while (next < pieces.size() && size_t(written) >= pieces[next].iov_len) {
+                written -= pieces[next].iov_len;
+                next++;
+            }
+            if (written > 0) {
+                pieces[next].iov_base = static_cast<uint8_t*>(pieces[next].iov_base) + written;
+                pieces[next].iov_len -= written;
+            }
+        }
+#endif
+    }
+
+    DiffStreamReader::DiffStreamReader(std::string input) : name(input) {
+        if (input == "-") {
+#ifdef _WIN32
+            _setmode(_fileno(stdin), _O_BINARY);
+#endif
+            file = stdin;
+            owned = false;
+        } else {
+            file = std::fopen(input.c_str(), "rb");
+            owned = true;
+            if (file == nullptr) {
+                throw std::runtime_error("couldn't open " + input);
+            }
+        }
+        uint8_t header[STREAM_HEADER_BYTES];
+        if (std::fread(header, 1, sizeof(header), file) != sizeof(header) || std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0) {
+            if (owned) {
+                std::fclose(file);
+            }
+            throw std::runtime_error(input + " is not a diff stream");
+        }
+        stream_rule.birth = uint16_t(getLittleEndian(&header[24], 2));
+        stream_rule.survive = uint16_t(getLittleEndian(&header[26], 2));
+        stream_rule.torus = header[28] != 0;
+        uint64_t width = getLittleEndian(&header[8], 8);
+        uint64_t height = getLittleEndian(&header[16], 8);
+        // Checked before allocating, so a corrupt header is an error rather
+        // than a huge allocation.
+        if (width == 0 || height == 0 || width > UINT32_MAX || height > UINT32_MAX) {
+            if (owned) {
+                std::fclose(file);
+            }
+            throw std::runtime_error(input + " has an invalid board size " + std::to_string(width) + "x" + std::to_string(height));
+        }
+        createBoard(width, height, current);
+        step_stats.population = 0;
+    }
+
+    DiffStreamReader::~DiffStreamReader() {
+        if (owned) {
+            std::fclose(file);
+        }
+    }
+
+    bool DiffStreamReader::next() {
+        uint8_t header[RECORD_HEADER_BYTES];
+        size_t got = std::fread(header, 1, sizeof(header), file);
+        if (got == 0) {
+            return false;
+        }
+        if (got != sizeof(header)) {
+            throw std::runtime_error(name + " ends inside a record");
+        }
+        payload.resize(getLittleEndian(&header[8], 4));
+        if (std::fread(payload.data(), 1, payload.size(), file) != payload.size()) {
+            throw std::runtime_error(name + " ends inside a record");
+        }
+        generation_count = getLittleEndian(&header[0], 8);
+        uint8_t kind = header[12];
+
+        StepStats stats;
+        stats.population = step_stats.population;
+        if (kind & DIFF_RECORD_KEYFRAME) {
+            std::fill(current.words.begin(), current.words.end(), 0);
+            stats.population = 0;
+        }
+        if ((kind & ~DIFF_RECORD_KEYFRAME) == DIFF_RECORD_WORDS) {
+            applyWordDelta(payload.data(), payload.size(), current, &stats);
+        } else if ((kind & ~DIFF_RECORD_KEYFRAME) == DIFF_RECORD_CELL_RUNS) {
+            applyCellRuns(payload.data(), payload.size(), current, &stats);
+        } else {
+            throw std::runtime_error(name + " has a record of unknown kind " + std::to_string(kind));
+        }
+        stats.population += stats.births;
+        stats.population -= stats.deaths;
+        step_stats = stats;
+        return true;
+    }
+}
@@ -0,0 +1,138 @@
+#ifndef __DIFF__STREAM__HPP__
+#define __DIFF__STREAM__HPP__
+
+#include "board.hpp"
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <condition_variable>
+
+namespace game {
+    // Binary stream of generations, all integers little-endian. Word
+    // payloads are copied as they are in memory, so only little-endian
+    // hosts write valid streams.
+    //
+    // Stream header, 32 bytes:
+    //   "GOLDIFF1", u64 width, u64 height, u16 birth, u16 survive,
+    //   u8 torus, 3 bytes zero
+    // Then one record per written board, a 16 byte header and a payload:
+    //   u64 generation, u32 payload bytes, u8 kind, 3 bytes zero
+    // The payload holds the changes from the previous record's board, or
+    // from an empty board when kind has DIFF_RECORD_KEYFRAME set. The
+    // first record is always a keyframe. Generations normally increase by
+    // one, but repeat after an edit and go back after a rewind.
+    //
+    // Each record uses whichever encoding is smaller: XOR words (see
+    // encodeWordDelta) for boards changing everywhere, or runs of toggled
+    // cells (see wordDeltaToCellRuns) for sparse changes.
+    constexpr uint8_t DIFF_RECORD_WORDS = 0;
+    constexpr uint8_t DIFF_RECORD_CELL_RUNS = 1;
+    constexpr uint8_t DIFF_RECORD_KEYFRAME = 0x80;
+
+    // Encodes on the calling thread into the filling batch of records and
+    // leaves the I/O to a background thread, which sends a whole batch
+    // with writev. The caller only waits when the writer has fallen more
+    // than MAX_PENDING_BYTES behind.
+    class DiffStreamWriter {
+    public:
+        static constexpr size_t BATCH_BYTES = 1 << 20;
+        static constexpr size_t MAX_PENDING_BYTES = size_t(256) << 20;
+        // The record header has 32 bits for the payload size, so write
+        // throws for boards whose changes need more.
+        static constexpr uint64_t MAX_PAYLOAD_BYTES = UINT32_MAX;
+
+        // output is a path or "-" for stdout. With a keyframe interval
+        // every that many records are keyframes, otherwise only the first.
+        DiffStreamWriter(std::string output, Rule rule, uint64_t keyframe_interval);
+        ~DiffStreamWriter();
+
+        DiffStreamWriter(const DiffStreamWriter&) = delete;
+        DiffStreamWriter& operator=(const DiffStreamWriter&) = delete;
+
+        void write(const Board& board, uint64_t generation);
+        // Hands the records written so far to the writer thread, unless it
+        // is still busy with the previous batch.
+        void submit();
+
+    private:
+        struct Batch {
+            std::vector<std::vector<uint8_t>> records;
+            size_t count = 0;
+            size_t bytes = 0;
+        };
+
+        std::vector<uint8_t>& nextRecord();
+        void handOff(std::unique_lock<std::mutex>& lock);
+        void writerLoop();
+        void writeBatch(Batch& batch);
+
+        int fd;
+        bool owned;
+        Rule rule;
+        uint64_t keyframe_interval;
+        uint64_t since_keyframe = 0;
+        bool started = false;
+        Board previous;
+        std::vector<uint8_t> delta;
+        std::vector<uint8_t> runs;
+
+        Batch batches[2];
+        Batch* filling = &batches[0];
+        Batch* writing = &batches[1];
+        std::mutex mutex;
+        std::condition_variable work_ready;
+        std::condition_variable work_done;
+        bool pending = false;
+        bool stopping = false;
+        std::string error;
+        std::thread thread;
+    };
+
+    // Reads a stream written by DiffStreamWriter back into boards.
+    class DiffStreamReader {
+    public:
+        // input is a path or "-" for stdin. Reads the stream header.
+        explicit DiffStreamReader(std::string input);
+        ~DiffStreamReader();
+
+        DiffStreamReader(const DiffStreamReader&) = delete;
+        DiffStreamReader& operator=(const DiffStreamReader&) = delete;
+
+        // Applies the next record; false at the end of the stream.
+        bool next();
+
+        const Board& board() const {
+            return current;
+        }
+
+        uint64_t generation() const {
+            return generation_count;
+        }
+
+        Rule rule() const {
+            return stream_rule;
+        }
+
+        // Population of the current board, and births and deaths since the
+        // previous record; a keyframe counts against an empty board.
+        const StepStats& stats() const {
+            return step_stats;
+        }
+
+    private:
+        std::FILE* file;
+        bool owned;
+        std::string name;
+        Rule stream_rule;
+        Board current;
+        uint64_t generation_count = 0;
+        StepStats step_stats;
+        std::vector<uint8_t> payload;
+    };
+}
+
+#endif // __DIFF__STREAM__HPP__
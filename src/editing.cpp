@@ -0,0 +1,89 @@
+#include "editing.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+namespace game {
+    void EditBatch::set(uint64_t row, uint64_t column, bool alive) {
+        cells[{ row, column }] = alive;
+    }
+
+    bool EditBatch::toggle(const Board& board, uint64_t row, uint64_t column) {
+        if (row >= board.height || column >= board.width) {
+            return false;
+        }
+        auto pending = cells.find({ row, column });
+        bool alive = pending != cells.end() ? pending->second : board.get(row, column);
+        set(row, column, !alive);
+        return !alive;
+    }
+
+    void EditBatch::line(int64_t from_row, int64_t from_column, int64_t to_row, int64_t to_column, bool alive) {
+        // Bresenham.
+        int64_t d_row = std::abs(to_row - from_row);
+        int64_t d_column = -std::abs(to_column - from_column);
+        int64_t step_row = from_row < to_row ? 1 : -1;
+        int64_t step_column = from_column < to_column ? 1 : -1;
+        int64_t error = d_row + d_column;
+        int64_t row = from_row;
+        int64_t column = from_column;
+        while (true) {
+            if (row >= 0 && column >= 0) {
+                set(row, column, alive);
+            }
+            if (row == to_row && column == to_column) {
+                break;
+            }
+            int64_t e2 = 2 * error;
+            if (e2 >= d_column) {
+                error += d_column;
+                row += step_row;
+            }
+            if (e2 <= d_row) {
+                error += d_row;
+                column += step_column;
+            }
+        }
+    }
+
+    void EditBatch::stamp(const Pattern& pattern, int64_t row, int64_t column) {
+        int64_t top = row - int64_t(pattern.height / 2);
+        int64_t left = column - int64_t(pattern.width / 2);
+        for (auto& cell : pattern.cells) {
+            int64_t i = top + int64_t(cell.first);
+            int64_t j = left + int64_t(cell.second);
+            if (i >= 0 && j >= 0) {
+                set(i, j, true);
+            }
+        }
+    }
+
+    void EditBatch::take(std::vector<CellEdit>& edits) {
+        edits.clear();
+        edits.reserve(cells.size());
+        for (auto& cell : cells) {
+            edits.push_back(CellEdit { cell.first.first, cell.first.second, cell.second });
+        }
+        cells.clear();
+    }
+
+    void unprojectCursor(
+        const Camera& camera,
+        uint64_t grid_size,
+        double width,
+        double height,
+        double x,
+        double y,
+        int64_t& row,
+        int64_t& column
+    ) {
+        // The shader draws the cell at row i, column j over
+        // [i, i + 1] x [j, j + 1] in grid space, with
+        // ndc = (grid - pos) / grid_size * zoom.
+        double ndc_x = 2. * x / width - 1.;
+        double ndc_y = 2. * y / height - 1.;
+        row = int64_t(std::floor(ndc_x * grid_size / camera.zoom + camera.x));
+        column = int64_t(std::floor(ndc_y * grid_size / camera.zoom + camera.y));
+    }
+}
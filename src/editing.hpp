@@ -0,0 +1,53 @@
+#ifndef __EDITING__HPP__
+#define __EDITING__HPP__
+
+#include "board.hpp"
+#include "patterns.hpp"
+#include "vulkan_methods.hpp"
+
+#include <map>
+#include <vector>
+#include <cstdint>
+
+namespace game {
+    // Cell edits collected from input during a frame and handed to the
+    // simulation in one batch before the next step. Later edits of a cell
+    // replace earlier ones, and toggles see the edits already pending.
+    class EditBatch {
+    public:
+        void set(uint64_t row, uint64_t column, bool alive);
+        // Returns the new state.
+        bool toggle(const Board& board, uint64_t row, uint64_t column);
+        // Every cell on the line, so fast drags leave no gaps.
+        void line(int64_t from_row, int64_t from_column, int64_t to_row, int64_t to_column, bool alive);
+        // Centred on (row, column).
+        void stamp(const Pattern& pattern, int64_t row, int64_t column);
+
+        bool empty() const {
+            return cells.empty();
+        }
+
+        // Moves the batch out in row-major order, so neighbouring edits
+        // end up next to each other.
+        void take(std::vector<CellEdit>& edits);
+
+    private:
+        std::map<std::pair<uint64_t, uint64_t>, bool> cells;
+    };
+
+    // Inverse of the vertex shader's projection: the cell under window
+    // position (x, y) of a width by height window. Negative or past the
+    // grid when the cursor is off the board.
+    void unprojectCursor(
+        const Camera& camera,
+        uint64_t grid_size,
+        double width,
+        double height,
+        double x,
+        double y,
+        int64_t& row,
+        int64_t& column
+    );
+}
+
+#endif // __EDITING__HPP__
@@ -0,0 +1,51 @@
+#include "engine.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace game {
+    void copyBoard(const Board& from, Board& to, ThreadPool& pool) {
+        createBoard(from.width, from.height, to);
+        pool.parallelFor(from.height, [&](uint64_t begin, uint64_t end, uint32_t) {
+            std::copy(from.row(begin), from.row(end), to.row(begin));
+        });
+    }
+
+    std::vector<std::string> engineNames() {
+        return { "naive", "bitpacked", "lut", "tiled", "adaptive" };
+    }
+
+    void createEngine(std::string name, Rule rule, ThreadPool& pool, std::unique_ptr<Engine>& engine, std::ostream* log) {
+        std::string parameter;
+        size_t split = name.find(':');
+        if (split != std::string::npos) {
+            parameter = name.substr(split + 1);
+            name = name.substr(0, split);
+        }
+        if (name == "adaptive") {
+            std::vector<std::string> candidates;
+            size_t begin = 0;
+            while (begin < parameter.size()) {
+                size_t end = std::min(parameter.find('+', begin), parameter.size());
+                candidates.push_back(parameter.substr(begin, end - begin));
+                begin = end + 1;
+            }
+            createAdaptiveEngine(rule, pool, candidates, log, engine);
+            return;
+        }
+        if (rule.torus && name != "naive" && name != "bitpacked") {
+            throw std::runtime_error(name + " engine only steps bounded boards");
+        }
+        if (name == "naive") {
+            createNaiveEngine(rule, pool, engine);
+        } else if (name == "bitpacked") {
+            createBitpackedEngine(rule, pool, engine);
+        } else if (name == "lut") {
+            createLutEngine(rule, pool, engine);
+        } else if (name == "tiled") {
+            createTiledEngine(rule, pool, parameter.empty() ? 8 : std::stoul(parameter), engine);
+        } else {
+            throw std::runtime_error("unknown engine " + name);
+        }
+    }
+}
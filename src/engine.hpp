@@ -0,0 +1,70 @@
+#ifndef __ENGINE__HPP__
+#define __ENGINE__HPP__
+
+#include "board.hpp"
+#include "thread_pool.hpp"
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace game {
+    // A step engine owns the board in whatever representation suits it.
+    // load/store convert from/to the shared bit-packed Board, step advances
+    // the owned state in place.
+    class Engine {
+    public:
+        virtual ~Engine() = default;
+
+        virtual const char* name() const = 0;
+        virtual void load(const Board& board) = 0;
+        virtual void store(Board& board) const = 0;
+        virtual void step(uint64_t generations) = 0;
+        virtual uint64_t memoryBytes() const = 0;
+
+        // Sets single cells without a full load. The fallback goes through
+        // store and load; engines that keep a Board override it.
+        virtual void edit(const std::vector<CellEdit>& edits) {
+            Board board;
+            store(board);
+            applyEdits(board, edits);
+            StepStats stats = step_stats;
+            load(board);
+            // Keep births and deaths of the last step, as the overrides do.
+            step_stats.births = stats.births;
+            step_stats.deaths = stats.deaths;
+        }
+
+        // Describes the last generation stepped, or the loaded board when
+        // nothing has been stepped since load.
+        const StepStats& stats() const {
+            return step_stats;
+        }
+
+    protected:
+        StepStats step_stats;
+    };
+
+    void createNaiveEngine(Rule rule, ThreadPool& pool, std::unique_ptr<Engine>& engine);
+    void createBitpackedEngine(Rule rule, ThreadPool& pool, std::unique_ptr<Engine>& engine);
+    void createLutEngine(Rule rule, ThreadPool& pool, std::unique_ptr<Engine>& engine);
+    void createTiledEngine(Rule rule, ThreadPool& pool, uint32_t depth, std::unique_ptr<Engine>& engine);
+    // Moves the board between the candidate engines, see adaptive_engine.cpp.
+    // Without candidates it picks from bitpacked, lut and tiled. Each
+    // decision is written to log when one is given.
+    void createAdaptiveEngine(Rule rule, ThreadPool& pool, std::vector<std::string> candidates, std::ostream* log, std::unique_ptr<Engine>& engine);
+
+    // Copies in the same row bands the engines step in, so every page is
+    // first touched (and placed) by the worker that will keep using it.
+    void copyBoard(const Board& from, Board& to, ThreadPool& pool);
+
+    std::vector<std::string> engineNames();
+    // Engines with a tuning parameter accept it after a colon, e.g.
+    // "tiled:16" advances 16 generations per tile pass, and
+    // "adaptive:bitpacked+tiled:16" picks between the engines listed.
+    void createEngine(std::string name, Rule rule, ThreadPool& pool, std::unique_ptr<Engine>& engine, std::ostream* log = nullptr);
+}
+
+#endif // __ENGINE__HPP__
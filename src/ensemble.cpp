@@ -0,0 +1,265 @@
+#include "ensemble.hpp"
+#include "kernels.hpp"
+#include "seed.hpp"
+#include "trace.hpp"
+
+#include <atomic>
+#include <stdexcept>
+
+namespace game {
+    namespace {
+        void wrapBorder(uint64_t* cells, uint64_t width, uint64_t height, uint64_t stride) {
+            for (uint64_t i = 1; i <= height; i++) {
+                uint64_t* row = cells + i * stride;
+                row[0] = row[width];
+                row[width + 1] = row[1];
+            }
+            std::copy(cells + height * stride, cells + (height + 1) * stride, cells);
+            std::copy(cells + stride, cells + 2 * stride, cells + (height + 1) * stride);
+        }
+
+        // Boards outside `running` keep their cells.
+        template <bool LIFE>
+        uint64_t stepCells(
+            const uint64_t* cur,
+            uint64_t* next,
+            uint64_t width,
+            uint64_t height,
+            uint64_t stride,
+            Rule rule,
+            uint64_t running
+        ) {
+            uint64_t alive = 0;
+            for (uint64_t i = 1; i <= height; i++) {
+                const uint64_t* up = cur + (i - 1) * stride;
+                const uint64_t* row = cur + i * stride;
+                const uint64_t* down = cur + (i + 1) * stride;
+                uint64_t* out = next + i * stride;
+                for (uint64_t j = 1; j <= width; j++) {
+                    NeighbourCount n = countNeighbours(
+                        up[j - 1], up[j], up[j + 1],
+                        row[j - 1], row[j + 1],
+                        down[j - 1], down[j], down[j + 1]
+                    );
+                    uint64_t result = LIFE ? applyLife(row[j], n) : applyRuleTable(row[j], n, rule);
+                    result = (result & running) | (row[j] & ~running);
+                    out[j] = result;
+                    alive |= result;
+                }
+            }
+            return alive;
+        }
+
+        // Boards whose cells differ anywhere between a and b.
+        uint64_t changedBoards(const uint64_t* a, const uint64_t* b, uint64_t width, uint64_t height, uint64_t stride) {
+            uint64_t changed = 0;
+            for (uint64_t i = 1; i <= height; i++) {
+                for (uint64_t j = 1; j <= width; j++) {
+                    changed |= a[i * stride + j] ^ b[i * stride + j];
+                }
+            }
+            return changed;
+        }
+    }
+
+    Ensemble::Ensemble(uint64_t width, uint64_t height, uint64_t count, Rule rule)
+        : width(width), height(height), count(count), rule(rule),
+        stride(width + 2), group_words((width + 2) * (height + 2)),
+        running((count + 63) / 64), results(count) {
+        if (width == 0 || height == 0) {
+            throw std::runtime_error("ensemble boards need a non-zero size");
+        }
+        words.resize(running.size() * group_words);
+        for (uint64_t group = 0; group < running.size(); group++) {
+            uint64_t lanes = std::min<uint64_t>(64, count - group * 64);
+            running[group] = lanes == 64 ? ~uint64_t(0) : (uint64_t(1) << lanes) - 1;
+        }
+    }
+
+    void Ensemble::seed(uint64_t seed, double density, ThreadPool& pool) {
+        GAME_TRACE_SCOPE("seed ensemble");
+        uint32_t threshold = densityThreshold(density);
+        uint64_t words_per_row = (width + 63) / 64;
+        pool.parallelFor(running.size(), [&](uint64_t begin, uint64_t end, uint32_t) {
+            for (uint64_t group = begin; group < end; group++) {
+                uint64_t* cells = groupCells(group);
+                std::fill(cells, cells + group_words, 0);
+                for (uint64_t lane = 0; lane < 64 && group * 64 + lane < count; lane++) {
+                    uint64_t key = seedKey(seed + group * 64 + lane);
+                    for (uint64_t i = 0; i < height; i++) {
+                        for (uint64_t w = 0; w < words_per_row; w++) {
+                            uint64_t random = randomCells(key, i * words_per_row + w, threshold);
+                            if (w + 1 == words_per_row && width % 64 != 0) {
+                                random &= (uint64_t(1) << (width % 64)) - 1;
+                            }
+                            while (random) {
+                                uint64_t j = w * 64 + countTrailingZeros64(random);
+                                cells[(i + 1) * stride + j + 1] |= uint64_t(1) << lane;
+                                random &= random - 1;
+                            }
+                        }
+                    }
+                    results[group * 64 + lane] = EnsembleResult();
+                    running[group] |= uint64_t(1) << lane;
+                }
+                finishGroup(group);
+            }
+        });
+    }
+
+    void Ensemble::load(uint64_t index, const Board& board) {
+        if (index >= count || board.width != width || board.height != height) {
+            throw std::runtime_error("board does not fit the ensemble");
+        }
+        uint64_t group = index / 64;
+        uint64_t bit = uint64_t(1) << (index % 64);
+        uint64_t* cells = groupCells(group);
+        for (uint64_t i = 0; i < height; i++) {
+            for (uint64_t j = 0; j < width; j++) {
+                uint64_t& word = cells[(i + 1) * stride + j + 1];
+                word = board.get(i, j) ? word | bit : word & ~bit;
+            }
+        }
+        results[index] = EnsembleResult();
+        running[group] |= bit;
+        finishGroup(group);
+    }
+
+    void Ensemble::store(uint64_t index, Board& board) const {
+        if (index >= count) {
+            throw std::runtime_error("no board " + std::to_string(index) + " in the ensemble");
+        }
+        createBoard(width, height, board);
+        const uint64_t* cells = groupCells(index / 64);
+        for (uint64_t i = 0; i < height; i++) {
+            for (uint64_t j = 0; j < width; j++) {
+                if ((cells[(i + 1) * stride + j + 1] >> (index % 64)) & 1) {
+                    board.set(i, j, true);
+                }
+            }
+        }
+    }
+
+    void Ensemble::erase(uint64_t index, const Board& cells) {
+        if (index >= count || cells.width != width || cells.height != height) {
+            throw std::runtime_error("cells do not fit the ensemble");
+        }
+        uint64_t* group_cells = groupCells(index / 64);
+        uint64_t bit = uint64_t(1) << (index % 64);
+        uint64_t erased = 0;
+        for (uint64_t i = 0; i < height; i++) {
+            for (uint64_t w = 0; w < cells.words_per_row; w++) {
+                for (uint64_t bits = cells.row(i)[w]; bits; bits &= bits - 1) {
+                    uint64_t& word = group_cells[(i + 1) * stride + w * 64 + countTrailingZeros64(bits) + 1];
+                    erased += (word & bit) != 0;
+                    word &= ~bit;
+                }
+            }
+        }
+        results[index].population -= erased;
+    }
+
+    void Ensemble::run(uint64_t generations, uint32_t max_period, ThreadPool& pool) {
+        GAME_TRACE_SCOPE("run ensemble");
+        if (max_period == 0) {
+            throw std::runtime_error("max period must be at least 1");
+        }
+        // Groups end at very different times, so workers take them one at
+        // a time instead of in fixed bands.
+        std::atomic<uint64_t> next_group(0);
+        pool.parallelFor(pool.size(), [&](uint64_t, uint64_t, uint32_t) {
+            std::vector<uint64_t> ring((max_period + 1) * group_words);
+            uint64_t group;
+            while ((group = next_group.fetch_add(1, std::memory_order_relaxed)) < running.size()) {
+                runGroup(group, generations, max_period, ring);
+            }
+        });
+    }
+
+    // The ring holds the last max_period + 1 generations so each new one
+    // can be compared against all of them.
+    void Ensemble::runGroup(uint64_t group, uint64_t generations, uint32_t max_period, std::vector<uint64_t>& ring) {
+        uint64_t live = running[group];
+        if (!live) {
+            return;
+        }
+        uint64_t slots = max_period + 1;
+        std::copy(groupCells(group), groupCells(group) + group_words, ring.begin());
+        uint64_t g = 0;
+        uint64_t ended_at[64];
+        uint64_t periods[64] = {};
+        // Without B0 an empty board stays empty, so it counts as dead.
+        bool empty_is_dead = !(rule.birth & 1);
+        if (empty_is_dead) {
+            for (uint64_t lanes = live; lanes; lanes &= lanes - 1) {
+                uint32_t lane = countTrailingZeros64(lanes);
+                if (results[group * 64 + lane].population == 0) {
+                    ended_at[lane] = 0;
+                    live &= ~(uint64_t(1) << lane);
+                }
+            }
+        }
+        while (live && g < generations) {
+            uint64_t* cur = ring.data() + (g % slots) * group_words;
+            uint64_t* next = ring.data() + ((g + 1) % slots) * group_words;
+            g++;
+            if (rule.torus) {
+                wrapBorder(cur, width, height, stride);
+            }
+            uint64_t alive = rule.isLife()
+                ? stepCells<true>(cur, next, width, height, stride, rule, live)
+                : stepCells<false>(cur, next, width, height, stride, rule, live);
+            uint64_t ended = empty_is_dead ? live & ~alive : 0;
+            for (uint64_t lanes = ended; lanes; lanes &= lanes - 1) {
+                ended_at[countTrailingZeros64(lanes)] = g;
+            }
+            for (uint64_t p = 1; p <= max_period && p <= g; p++) {
+                const uint64_t* earlier = ring.data() + ((g - p) % slots) * group_words;
+                uint64_t repeated = live & ~ended & ~changedBoards(next, earlier, width, height, stride);
+                for (uint64_t lanes = repeated; lanes; lanes &= lanes - 1) {
+                    uint32_t lane = countTrailingZeros64(lanes);
+                    ended_at[lane] = g - p;
+                    periods[lane] = p;
+                }
+                ended |= repeated;
+            }
+            live &= ~ended;
+        }
+        std::copy(ring.begin() + (g % slots) * group_words, ring.begin() + (g % slots + 1) * group_words, groupCells(group));
+
+        for (uint64_t lanes = running[group]; lanes; lanes &= lanes - 1) {
+            uint32_t lane = countTrailingZeros64(lanes);
+            EnsembleResult& result = results[group * 64 + lane];
+            if ((live >> lane) & 1) {
+                result.generation += g;
+            } else {
+                result.end = periods[lane] ? EnsembleEnd::Periodic : EnsembleEnd::Died;
+                result.generation += ended_at[lane];
+                result.period = periods[lane];
+            }
+        }
+        running[group] = live;
+        finishGroup(group);
+    }
+
+    void Ensemble::finishGroup(uint64_t group) {
+        uint64_t populations[64] = {};
+        const uint64_t* cells = groupCells(group);
+        for (uint64_t i = 1; i <= height; i++) {
+            for (uint64_t j = 1; j <= width; j++) {
+                for (uint64_t lanes = cells[i * stride + j]; lanes; lanes &= lanes - 1) {
+                    populations[countTrailingZeros64(lanes)]++;
+                }
+            }
+        }
+        for (uint64_t lane = 0; lane < 64 && group * 64 + lane < count; lane++) {
+            results[group * 64 + lane].population = populations[lane];
+        }
+    }
+
+    uint64_t Ensemble::memoryBytes() const {
+        return words.size() * sizeof(uint64_t)
+            + running.size() * sizeof(uint64_t)
+            + results.size() * sizeof(EnsembleResult);
+    }
+}
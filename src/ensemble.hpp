@@ -0,0 +1,89 @@
+#ifndef __ENSEMBLE__HPP__
+#define __ENSEMBLE__HPP__
+
+#include "board.hpp"
+#include "thread_pool.hpp"
+
+#include <vector>
+#include <cstdint>
+
+namespace game {
+    enum class EnsembleEnd {
+        Running,
+        Died,
+        Periodic,
+    };
+
+    struct EnsembleResult {
+        EnsembleEnd end = EnsembleEnd::Running;
+        // Generations stepped while running; for a board that ended, the
+        // generation it died at or first repeated from.
+        uint64_t generation = 0;
+        uint64_t period = 0;
+        uint64_t population = 0;
+    };
+
+    // Many small boards of one size stepped together. Boards are grouped 64
+    // at a time and a group keeps one word per cell: bit k of word (i, j)
+    // is cell (i, j) of board 64 * group + k. The bit-sliced adder then
+    // advances a cell on 64 boards at once and a row of words needs no
+    // shifts, so the inner loop is plain vertical SIMD work.
+    //
+    // A board stops once it dies or repeats with a period of at most
+    // max_period, and a group stops once all of its boards have.
+    class Ensemble {
+    public:
+        Ensemble(uint64_t width, uint64_t height, uint64_t count, Rule rule);
+
+        uint64_t size() const {
+            return count;
+        }
+
+        // Board k gets the cells seedSoup(board, "full", seed + k, density,
+        // ...) gives a board of the same size.
+        void seed(uint64_t seed, double density, ThreadPool& pool);
+        void load(uint64_t index, const Board& board);
+        void store(uint64_t index, Board& board) const;
+        // Clears the cells set in `cells` from board index, which keeps
+        // its result so far. Boards of different groups can be erased
+        // from concurrently.
+        void erase(uint64_t index, const Board& cells);
+
+        // Steps every running board by up to `generations`. Repeats are
+        // only looked for within one call.
+        void run(uint64_t generations, uint32_t max_period, ThreadPool& pool);
+
+        const EnsembleResult& result(uint64_t index) const {
+            return results[index];
+        }
+
+        uint64_t memoryBytes() const;
+
+    private:
+        void runGroup(uint64_t group, uint64_t generations, uint32_t max_period, std::vector<uint64_t>& ring);
+        void finishGroup(uint64_t group);
+
+        uint64_t* groupCells(uint64_t group) {
+            return words.data() + group * group_words;
+        }
+
+        const uint64_t* groupCells(uint64_t group) const {
+            return words.data() + group * group_words;
+        }
+
+        uint64_t width;
+        uint64_t height;
+        uint64_t count;
+        Rule rule;
+        // Groups are stored with a one cell border: dead for bounded
+        // boards, refreshed from the opposite edge each generation on a
+        // torus.
+        uint64_t stride;
+        uint64_t group_words;
+        Board::Words words;
+        std::vector<uint64_t> running;
+        std::vector<EnsembleResult> results;
+    };
+}
+
+#endif // __ENSEMBLE__HPP__
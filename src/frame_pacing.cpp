@@ -0,0 +1,83 @@
+#include "frame_pacing.hpp"
+#include "trace.hpp"
+
+#include <thread>
+#include <algorithm>
+
+namespace game {
+    FrameLimiter::FrameLimiter(double max_fps)
+        : period(max_fps > 0. ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1. / max_fps)) : Clock::duration::zero()),
+          next_frame(Clock::now()),
+          enabled(max_fps > 0.) {}
+
+    void FrameLimiter::wait() {
+        if (!enabled) {
+            return;
+        }
+        Clock::time_point now = Clock::now();
+        if (next_frame > now) {
+            GAME_TRACE_SCOPE("frame limiter");
+            std::this_thread::sleep_until(next_frame);
+            next_frame += period;
+        } else if (now - next_frame > period) {
+            next_frame = now + period;
+        } else {
+            next_frame += period;
+        }
+    }
+
+    void FrameLimiter::reset() {
+        next_frame = Clock::now();
+    }
+
+    GenerationPacer::GenerationPacer(uint64_t per_frame, double rate)
+        : per_frame(std::max<uint64_t>(per_frame, 1)), target_rate(rate), last_frame(Clock::now()) {}
+
+    uint64_t GenerationPacer::generationsForFrame() {
+        Clock::time_point now = Clock::now();
+        double elapsed = std::chrono::duration<double>(now - last_frame).count();
+        last_frame = now;
+        if (is_paused) {
+            uint64_t steps = pending_steps;
+            pending_steps = 0;
+            return steps;
+        }
+        if (target_rate <= 0.) {
+            return per_frame;
+        }
+        // A long stall (a drag, a breakpoint) is forgiven rather than paid
+        // back in one enormous batch.
+        owed += std::min(elapsed, .25) * target_rate;
+        uint64_t steps = static_cast<uint64_t>(owed);
+        owed -= double(steps);
+        return steps;
+    }
+
+    void GenerationPacer::togglePause() {
+        is_paused = !is_paused;
+        pending_steps = 0;
+        owed = 0.;
+        last_frame = Clock::now();
+    }
+
+    void GenerationPacer::singleStep() {
+        is_paused = true;
+        pending_steps++;
+    }
+
+    void GenerationPacer::faster() {
+        if (target_rate > 0.) {
+            target_rate *= 2.;
+        } else {
+            per_frame = std::min<uint64_t>(per_frame * 2, uint64_t(1) << 20);
+        }
+    }
+
+    void GenerationPacer::slower() {
+        if (target_rate > 0.) {
+            target_rate = std::max(target_rate / 2., .5);
+        } else {
+            per_frame = std::max<uint64_t>(per_frame / 2, 1);
+        }
+    }
+}
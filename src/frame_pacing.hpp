@@ -0,0 +1,74 @@
+#ifndef __FRAME__PACING__HPP__
+#define __FRAME__PACING__HPP__
+
+#include <chrono>
+#include <cstdint>
+
+namespace game {
+    // Caps the frame rate by sleeping until the next frame slot. Slots are
+    // kept on a fixed grid so short sleeps don't accumulate drift, and the
+    // grid restarts after a stall instead of rushing to catch up.
+    class FrameLimiter {
+    public:
+        explicit FrameLimiter(double max_fps);
+
+        // Call once per frame, before sampling input, so the wait happens
+        // before the frame rather than between input and present.
+        void wait();
+        void reset();
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        Clock::duration period;
+        Clock::time_point next_frame;
+        bool enabled;
+    };
+
+    // Decides how many generations each frame advances: a fixed batch per
+    // frame, or, with a target rate, however many generations the elapsed
+    // time is worth. The whole batch is stepped before the renderer sees the
+    // board, so large batches cost no intermediate uploads.
+    class GenerationPacer {
+    public:
+        GenerationPacer(uint64_t per_frame, double rate);
+
+        uint64_t generationsForFrame();
+
+        bool paused() const {
+            return is_paused;
+        }
+
+        // Paused with no single steps pending: the board won't change.
+        bool idle() const {
+            return is_paused && pending_steps == 0;
+        }
+
+        void togglePause();
+        // Advances one generation on the next frame, pausing if needed.
+        void singleStep();
+        // Doubles or halves whichever of rate and batch size is in use.
+        void faster();
+        void slower();
+
+        uint64_t perFrame() const {
+            return per_frame;
+        }
+
+        double rate() const {
+            return target_rate;
+        }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        uint64_t per_frame;
+        double target_rate;
+        double owed = 0.;
+        Clock::time_point last_frame;
+        bool is_paused = false;
+        uint64_t pending_steps = 0;
+    };
+}
+
+#endif // __FRAME__PACING__HPP__
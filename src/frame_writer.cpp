@@ -0,0 +1,268 @@
+#include "frame_writer.hpp"
+
+#include <array>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include <stdexcept>
+
+#ifdef GAME_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+namespace game {
+    namespace {
+        uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+            static const std::array<uint32_t, 256> table = [] {
+                std::array<uint32_t, 256> t;
+                for (uint32_t n = 0; n < 256; n++) {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; k++) {
+                        c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    }
+                    t[n] = c;
+                }
+                return t;
+            }();
+            crc = ~crc;
+            for (size_t i = 0; i < size; i++) {
+                crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+
+        void appendBigEndian(std::string& out, uint32_t value) {
+            out.push_back(char(value >> 24));
+            out.push_back(char(value >> 16));
+            out.push_back(char(value >> 8));
+            out.push_back(char(value));
+        }
+
+        void appendChunk(std::string& png, const char* type, const std::string& data) {
+            appendBigEndian(png, data.size());
+            std::string body = std::string(type, 4) + data;
+            png += body;
+            appendBigEndian(png, crc32(reinterpret_cast<const uint8_t*>(body.data()), body.size()));
+        }
+
+        void deflate(const std::vector<uint8_t>& raw, std::string& out) {
+#ifdef GAME_HAVE_ZLIB
+            uLongf size = compressBound(raw.size());
+            out.resize(size);
+            if (compress2(reinterpret_cast<Bytef*>(&out[0]), &size, raw.data(), raw.size(), 1) != Z_OK) {
+                throw std::runtime_error("zlib compression failed");
+            }
+            out.resize(size);
+#else
+            // Stored (uncompressed) deflate blocks wrapped in a zlib stream.
+            out = std::string("\x78\x01", 2);
+            size_t offset = 0;
+            do {
+                size_t block = std::min<size_t>(raw.size() - offset, 65535);
+                bool last = offset + block == raw.size();
+                out.push_back(char(last ? 1 : 0));
+                out.push_back(char(block & 0xFF));
+                out.push_back(char(block >> 8));
+                out.push_back(char(~block & 0xFF));
+                out.push_back(char((~block >> 8) & 0xFF));
+                out.append(reinterpret_cast<const char*>(raw.data()) + offset, block);
+                offset += block;
+            } while (offset < raw.size());
+            uint32_t a = 1, b = 0;
+            for (uint8_t byte : raw) {
+                a = (a + byte) % 65521;
+                b = (b + a) % 65521;
+            }
+            appendBigEndian(out, (b << 16) | a);
+#endif
+        }
+
+        void writeAll(std::FILE* file, const void* data, size_t size, const std::string& path) {
+            if (std::fwrite(data, 1, size, file) != size) {
+                throw std::runtime_error("couldn't write " + path);
+            }
+        }
+
+        // The pattern holds one %d, optionally with a width such as %06d,
+        // and %% for a literal %. The index is formatted here rather than
+        // by printf, so nothing else in the pattern is interpreted.
+        class PngSequenceWriter : public FrameWriter {
+        public:
+            explicit PngSequenceWriter(std::string pattern) {
+                bool found = false;
+                std::string* part = &prefix;
+                for (size_t i = 0; i < pattern.size(); i++) {
+                    if (pattern[i] != '%') {
+                        *part += pattern[i];
+                        continue;
+                    }
+                    if (i + 1 < pattern.size() && pattern[i + 1] == '%') {
+                        *part += '%';
+                        i++;
+                        continue;
+                    }
+                    size_t end = pattern.find_first_not_of("0123456789", i + 1);
+                    if (found || end == std::string::npos || pattern[end] != 'd' || end - i > 3) {
+                        throw std::runtime_error("PNG pattern " + pattern + " needs exactly one %d directive, such as %06d");
+                    }
+                    std::string digits = pattern.substr(i + 1, end - i - 1);
+                    zero_pad = !digits.empty() && digits[0] == '0';
+                    width = digits.empty() ? 0 : std::stoul(digits);
+                    found = true;
+                    part = &suffix;
+                    i = end;
+                }
+                if (!found) {
+                    throw std::runtime_error("PNG pattern " + pattern + " needs a %d directive, such as %06d");
+                }
+            }
+
+            void write(const uint8_t* rgba, uint32_t width, uint32_t height) override {
+                std::string path = prefix + formatIndex(index++) + suffix;
+
+                std::string png;
+                encodePng(rgba, width, height, png);
+                std::FILE* file = std::fopen(path.c_str(), "wb");
+                if (file == nullptr) {
+                    throw std::runtime_error("couldn't open " + path);
+                }
+                try {
+                    writeAll(file, png.data(), png.size(), path);
+                } catch (...) {
+                    std::fclose(file);
+                    throw;
+                }
+                if (std::fclose(file) != 0) {
+                    throw std::runtime_error("couldn't write " + path);
+                }
+            }
+
+        private:
+            std::string formatIndex(uint64_t value) const {
+                std::string digits = std::to_string(value);
+                if (digits.size() < width) {
+                    digits.insert(0, width - digits.size(), zero_pad ? '0' : ' ');
+                }
+                return digits;
+            }
+
+            std::string prefix;
+            std::string suffix;
+            size_t width = 0;
+            bool zero_pad = false;
+            uint64_t index = 0;
+        };
+
+        class Y4mWriter : public FrameWriter {
+        public:
+            Y4mWriter(std::FILE* file, bool owned, std::string path, uint32_t width, uint32_t height, uint32_t fps)
+                : file(file), owned(owned), path(path), planes(size_t(width) * height * 3) {
+                if (std::fprintf(file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444\n", width, height, fps) < 0) {
+                    close();
+                    throw std::runtime_error("couldn't write " + path);
+                }
+            }
+
+            ~Y4mWriter() override {
+                close();
+            }
+
+            void finish() override {
+                if (!close()) {
+                    throw std::runtime_error("couldn't write " + path);
+                }
+            }
+
+            void write(const uint8_t* rgba, uint32_t width, uint32_t height) override {
+                size_t pixels = size_t(width) * height;
+                uint8_t* y = planes.data();
+                uint8_t* u = y + pixels;
+                uint8_t* v = u + pixels;
+                for (size_t i = 0; i < pixels; i++) {
+                    int r = rgba[i * 4], g = rgba[i * 4 + 1], b = rgba[i * 4 + 2];
+                    y[i] = uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+                    u[i] = uint8_t(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                    v[i] = uint8_t(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+                }
+                writeAll(file, "FRAME\n", 6, path);
+                writeAll(file, planes.data(), planes.size(), path);
+            }
+
+        private:
+            // Whether everything written reached the file.
+            bool close() {
+                if (file == nullptr) {
+                    return true;
+                }
+                bool ok = std::fflush(file) == 0 && !std::ferror(file);
+                if (owned) {
+                    ok = std::fclose(file) == 0 && ok;
+                }
+                file = nullptr;
+                return ok;
+            }
+
+            std::FILE* file;
+            bool owned;
+            std::string path;
+            std::vector<uint8_t> planes;
+        };
+    }
+
+    void encodePng(const uint8_t* rgba, uint32_t width, uint32_t height, std::string& png) {
+        std::vector<uint8_t> raw;
+        raw.reserve(size_t(height) * (size_t(width) * 3 + 1));
+        for (uint32_t i = 0; i < height; i++) {
+            raw.push_back(0);
+            const uint8_t* row = rgba + size_t(i) * width * 4;
+            for (uint32_t j = 0; j < width; j++) {
+                raw.push_back(row[j * 4]);
+                raw.push_back(row[j * 4 + 1]);
+                raw.push_back(row[j * 4 + 2]);
+            }
+        }
+
+        std::string header;
+        appendBigEndian(header, width);
+        appendBigEndian(header, height);
+        header += std::string("\x08\x02\x00\x00\x00", 5);
+
+        std::string data;
+        deflate(raw, data);
+
+        png = std::string("\x89PNG\r\n\x1a\n", 8);
+        appendChunk(png, "IHDR", header);
+        appendChunk(png, "IDAT", data);
+        appendChunk(png, "IEND", "");
+    }
+
+    void createFrameWriter(
+        std::string output,
+        uint32_t width,
+        uint32_t height,
+        uint32_t fps,
+        std::unique_ptr<FrameWriter>& writer
+    ) {
+        if (output == "-") {
+#ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            writer = std::make_unique<Y4mWriter>(stdout, false, "stdout", width, height, fps);
+        } else if (output.size() > 4 && output.compare(output.size() - 4, 4, ".y4m") == 0) {
+            std::FILE* file = std::fopen(output.c_str(), "wb");
+            if (file == nullptr) {
+                throw std::runtime_error("couldn't open " + output);
+            }
+            writer = std::make_unique<Y4mWriter>(file, true, output, width, height, fps);
+        } else if (output.find('%') != std::string::npos) {
+            writer = std::make_unique<PngSequenceWriter>(output);
+        } else {
+            throw std::runtime_error("output must be -, a .y4m file or a PNG pattern like frame_%06d.png");
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef __FRAME__WRITER__HPP__
+#define __FRAME__WRITER__HPP__
+
+#include <string>
+#include <memory>
+#include <cstdint>
+
+namespace game {
+    // Receives tightly packed RGBA8 frames in presentation order.
+    class FrameWriter {
+    public:
+        virtual ~FrameWriter() = default;
+        virtual void write(const uint8_t* rgba, uint32_t width, uint32_t height) = 0;
+        // Flushes and closes the output, throwing if any of it failed to
+        // reach the file. Destroying a writer without finish loses that.
+        virtual void finish() {}
+    };
+
+    // output is "-" for a Y4M stream on stdout, a path ending in .y4m, or a
+    // pattern with one %d such as "frames/%06d.png" for a PNG sequence.
+    // Writes throw when the output can't take them, such as on a full disk.
+    void createFrameWriter(
+        std::string output,
+        uint32_t width,
+        uint32_t height,
+        uint32_t fps,
+        std::unique_ptr<FrameWriter>& writer
+    );
+
+    void encodePng(const uint8_t* rgba, uint32_t width, uint32_t height, std::string& png);
+}
+
+#endif // __FRAME__WRITER__HPP__
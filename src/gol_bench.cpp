@@ -0,0 +1,238 @@
+#include "board.hpp"
+#include "engine.hpp"
+#include "memory.hpp"
+#include "patterns.hpp"
+#include "seed.hpp"
+#include "thread_pool.hpp"
+
+#include <map>
+#include <chrono>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+struct BenchOptions {
+    std::vector<uint64_t> sizes = { 256, 1024, 4096, 16384 };
+    std::vector<std::string> densities = { "sparse", "soup", "guns" };
+    std::vector<std::string> engines = game::engineNames();
+    std::vector<std::string> rules = { "B3/S23" };
+    std::vector<uint32_t> threads;
+    double min_time = 0.5;
+    bool pin_threads = false;
+    std::string output;
+    std::string label;
+};
+
+struct BenchResult {
+    std::string engine;
+    std::string rule;
+    uint64_t size;
+    std::string density;
+    uint32_t threads;
+    uint64_t generations;
+    double seconds;
+    double cells_per_sec;
+    double bytes_per_cell;
+    // Over the first thread count measured, which need not be 1.
+    double speedup;
+    uint32_t baseline_threads;
+};
+
+std::vector<std::string> splitList(std::string text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+void parseBenchOptions(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--pin-threads") {
+            options.pin_threads = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            throw std::runtime_error(arg + " expects a value");
+        }
+        std::string value = argv[++i];
+        if (arg == "--sizes") {
+            options.sizes.clear();
+            for (auto& s : splitList(value)) {
+                options.sizes.push_back(std::stoull(s));
+            }
+        } else if (arg == "--densities") {
+            options.densities = splitList(value);
+        } else if (arg == "--engines") {
+            options.engines = splitList(value);
+        } else if (arg == "--rules") {
+            options.rules = splitList(value);
+        } else if (arg == "--threads") {
+            options.threads.clear();
+            for (auto& s : splitList(value)) {
+                options.threads.push_back(std::stoul(s));
+            }
+        } else if (arg == "--min-time") {
+            options.min_time = std::stod(value);
+        } else if (arg == "--huge-pages") {
+            game::setHugePages(game::parseHugePages(value));
+        } else if (arg == "--output") {
+            options.output = value;
+        } else if (arg == "--label") {
+            options.label = value;
+        } else {
+            throw std::runtime_error("unknown option " + arg);
+        }
+    }
+    if (options.threads.empty()) {
+        for (uint32_t t = 1; t < game::defaultThreadCount(); t *= 2) {
+            options.threads.push_back(t);
+        }
+        options.threads.push_back(game::defaultThreadCount());
+    }
+}
+
+void seedBoard(std::string density, uint64_t size, game::Board& board) {
+    game::createBoard(size, size, board);
+    if (density == "guns") {
+        game::Pattern gun, pulsar;
+        game::builtinPattern("gosper_gun", gun);
+        game::builtinPattern("pulsar", pulsar);
+        for (uint64_t i = 0; i + 64 <= size; i += 64) {
+            for (uint64_t j = 0; j + 64 <= size; j += 64) {
+                game::stampPattern(board, ((i + j) / 64) % 2 ? gun : pulsar, i + 8, j + 8);
+            }
+        }
+        return;
+    }
+    double p = density == "sparse" ? 0.05 : density == "soup" ? 0.5 : std::stod(density);
+    game::ThreadPool pool(0);
+    game::seedSoup(board, "full", size, p, pool);
+}
+
+void runBench(const BenchOptions& options, std::vector<BenchResult>& results) {
+    for (auto& rule_name : options.rules) {
+        game::Rule rule;
+        game::parseRule(rule_name, rule);
+        for (uint64_t size : options.sizes) {
+            for (auto& density : options.densities) {
+                game::Board board;
+                seedBoard(density, size, board);
+                for (auto& engine_name : options.engines) {
+                    double baseline_rate = 0.;
+                    for (uint32_t threads : options.threads) {
+                        game::ThreadPool pool(threads, options.pin_threads);
+                        std::unique_ptr<game::Engine> engine;
+                        try {
+                            game::createEngine(engine_name, rule, pool, engine);
+                        } catch (std::runtime_error& e) {
+                            // Not every engine runs every rule, such as a
+                            // torus; the rest of the matrix still runs.
+                            std::cerr << "skipping " << engine_name << " for " << game::ruleName(rule) << ": " << e.what() << std::endl;
+                            break;
+                        }
+                        engine->load(board);
+                        engine->step(1);
+
+                        uint64_t generations = 0;
+                        uint64_t batch = 1;
+                        double seconds = 0.;
+                        while (seconds < options.min_time) {
+                            auto begin = std::chrono::steady_clock::now();
+                            engine->step(batch);
+                            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+                            generations += batch;
+                            batch *= 2;
+                        }
+
+                        BenchResult r;
+                        r.engine = engine_name;
+                        r.rule = game::ruleName(rule);
+                        r.size = size;
+                        r.density = density;
+                        r.threads = threads;
+                        r.generations = generations;
+                        r.seconds = seconds;
+                        r.cells_per_sec = double(size) * double(size) * generations / seconds;
+                        r.bytes_per_cell = double(engine->memoryBytes()) / (double(size) * double(size));
+                        if (baseline_rate == 0.) {
+                            baseline_rate = r.cells_per_sec;
+                        }
+                        r.speedup = r.cells_per_sec / baseline_rate;
+                        r.baseline_threads = options.threads[0];
+                        results.push_back(r);
+
+                        std::cerr
+                            << std::setw(10) << r.engine
+                            << std::setw(9) << r.rule
+                            << std::setw(7) << r.size
+                            << std::setw(8) << r.density
+                            << std::setw(4) << r.threads
+                            << std::setw(12) << std::scientific << std::setprecision(3) << r.cells_per_sec << " cells/s"
+                            << std::fixed << std::setprecision(2)
+                            << std::setw(7) << r.bytes_per_cell << " B/cell"
+                            << std::setw(7) << r.speedup << "x vs " << r.baseline_threads << "t"
+                            << std::endl;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void writeJson(std::ostream& os, const BenchOptions& options, const std::vector<BenchResult>& results) {
+    os << "{\n  \"label\": \"" << options.label << "\",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        os << std::setprecision(6)
+            << "    {\"engine\": \"" << r.engine
+            << "\", \"rule\": \"" << r.rule
+            << "\", \"size\": " << r.size
+            << ", \"density\": \"" << r.density
+            << "\", \"threads\": " << r.threads
+            << ", \"generations\": " << r.generations
+            << ", \"seconds\": " << std::fixed << r.seconds
+            << ", \"cells_per_sec\": " << std::scientific << r.cells_per_sec
+            << ", \"bytes_per_cell\": " << std::fixed << r.bytes_per_cell
+            << ", \"speedup\": " << r.speedup
+            << ", \"baseline_threads\": " << r.baseline_threads
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+}
+
+int run(int argc, char** argv) {
+    BenchOptions options;
+    parseBenchOptions(argc, argv, options);
+
+    std::vector<BenchResult> results;
+    runBench(options, results);
+
+    if (options.output.empty()) {
+        writeJson(std::cout, options, results);
+    } else {
+        std::ofstream out(options.output);
+        if (!out.is_open()) {
+            throw std::runtime_error("couldn't open " + options.output);
+        }
+        writeJson(out, options, results);
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return run(argc, argv);
+    } catch (std::exception& e) {
+        std::cerr << "gol_bench: " << e.what() << std::endl;
+        return 1;
+    }
+}
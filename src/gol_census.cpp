@@ -0,0 +1,112 @@
+#include "board.hpp"
+#include "census.hpp"
+#include "thread_pool.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+struct CensusRunOptions {
+    game::CensusOptions census;
+    uint32_t threads = 0;
+    uint64_t top = 40;
+    std::string output;
+};
+
+void parseCensusOptions(int argc, char** argv, CensusRunOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw std::runtime_error(arg + " expects a value");
+        }
+        std::string value = argv[++i];
+        if (arg == "--size") {
+            size_t split = value.find('x');
+            options.census.width = std::stoull(value.substr(0, split));
+            options.census.height = split == std::string::npos ? options.census.width : std::stoull(value.substr(split + 1));
+        } else if (arg == "--soups") {
+            options.census.soups = std::stoull(value);
+        } else if (arg == "--batch") {
+            options.census.batch = std::stoull(value);
+        } else if (arg == "--rule") {
+            game::parseRule(value, options.census.rule);
+        } else if (arg == "--seed") {
+            options.census.seed = std::stoull(value);
+        } else if (arg == "--density") {
+            options.census.density = std::stod(value);
+        } else if (arg == "--generations") {
+            options.census.generations = std::stoull(value);
+        } else if (arg == "--max-period") {
+            options.census.max_period = std::stoul(value);
+        } else if (arg == "--object-period") {
+            options.census.object_period = std::stoul(value);
+        } else if (arg == "--threads") {
+            options.threads = std::stoul(value);
+        } else if (arg == "--top") {
+            options.top = std::stoull(value);
+        } else if (arg == "--output") {
+            options.output = value;
+        } else {
+            throw std::runtime_error("unknown option " + arg);
+        }
+    }
+}
+
+void writeCsv(std::ostream& os, const game::CensusReport& report) {
+    os << "name,count,period,population,displacement\n";
+    for (auto& object : report.census) {
+        os << object.name << "," << object.count << "," << object.period << "," << object.population << ","
+            << object.displacement[0] << ":" << object.displacement[1] << "\n";
+    }
+}
+
+int run(int argc, char** argv) {
+    CensusRunOptions options;
+    parseCensusOptions(argc, argv, options);
+
+    game::ThreadPool pool(options.threads);
+    game::CensusReport report;
+    game::runCensus(options.census, pool, report);
+
+    std::cout << "# " << report.soups << " soups of " << options.census.width << "x" << options.census.height
+        << " " << game::ruleName(options.census.rule) << " from seed " << options.census.seed
+        << ": " << report.died << " died, " << report.unsettled << " unsettled, "
+        << report.objects << " objects, " << report.escaped << " of them escaping ships\n";
+    for (uint64_t k = 0; k < report.census.size() && k < options.top; k++) {
+        const game::CensusObject& object = report.census[k];
+        std::cout
+            << std::setw(12) << object.count
+            << std::fixed << std::setprecision(4)
+            << std::setw(10) << 100. * double(object.count) / double(report.objects) << "%"
+            << std::setw(6) << object.period
+            << std::setw(6) << object.population
+            << "  " << object.name << "\n";
+    }
+
+    if (!options.output.empty()) {
+        std::ofstream out(options.output);
+        if (!out.is_open()) {
+            throw std::runtime_error("couldn't open " + options.output);
+        }
+        writeCsv(out, report);
+    }
+
+    std::cerr
+        << std::fixed << std::setprecision(1)
+        << double(report.soups) / report.seconds << " soups/s, "
+        << double(report.soups) / report.seconds / pool.size() << " soups/s per thread, "
+        << double(report.generations) / double(report.soups) << " generations per soup"
+        << std::endl;
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return run(argc, argv);
+    } catch (std::exception& e) {
+        std::cerr << "gol_census: " << e.what() << std::endl;
+        return 1;
+    }
+}
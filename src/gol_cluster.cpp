@@ -0,0 +1,124 @@
+#include "board.hpp"
+#include "cluster.hpp"
+#include "engine.hpp"
+#include "seed.hpp"
+#include "thread_pool.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+struct ClusterRunOptions {
+    game::ClusterOptions cluster;
+    uint64_t generations = 1000;
+    uint64_t report_every = 100;
+    bool verify = false;
+};
+
+void parseClusterOptions(int argc, char** argv, ClusterRunOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--verify") {
+            options.verify = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            throw std::runtime_error(arg + " expects a value");
+        }
+        std::string value = argv[++i];
+        if (arg == "--size") {
+            options.cluster.width = std::stoull(value);
+            options.cluster.height = options.cluster.width;
+        } else if (arg == "--workers") {
+            options.cluster.workers = std::stoul(value);
+        } else if (arg == "--transport") {
+            options.cluster.transport = value;
+        } else if (arg == "--threads") {
+            options.cluster.threads_per_worker = std::stoul(value);
+        } else if (arg == "--rule") {
+            game::parseRule(value, options.cluster.rule);
+        } else if (arg == "--seed") {
+            options.cluster.seed = std::stoull(value);
+        } else if (arg == "--density") {
+            options.cluster.density = std::stod(value);
+        } else if (arg == "--generations") {
+            options.generations = std::stoull(value);
+        } else if (arg == "--report") {
+            options.report_every = std::stoull(value);
+        } else {
+            throw std::runtime_error("unknown option " + arg);
+        }
+    }
+    if (options.report_every == 0) {
+        options.report_every = options.generations;
+    }
+}
+
+void printStats(uint64_t generation, const game::StepStats& stats) {
+    std::cerr
+        << "generation " << std::setw(8) << generation
+        << "  population " << std::setw(10) << stats.population
+        << "  births " << std::setw(8) << stats.births
+        << "  deaths " << std::setw(8) << stats.deaths
+        << std::endl;
+}
+
+// Steps the same board on a single bitpacked engine and compares.
+bool verify(const ClusterRunOptions& options, const game::Board& result, const game::StepStats& stats) {
+    game::ThreadPool pool(0);
+    game::Board board;
+    game::createBoard(options.cluster.width, options.cluster.height, board);
+    game::seedSoup(board, "full", options.cluster.seed, options.cluster.density, pool);
+    std::unique_ptr<game::Engine> engine;
+    game::createBitpackedEngine(options.cluster.rule, pool, engine);
+    engine->load(board);
+    engine->step(options.generations);
+    engine->store(board);
+    const game::StepStats& expected = engine->stats();
+    return board == result
+        && expected.population == stats.population
+        && expected.births == stats.births
+        && expected.deaths == stats.deaths;
+}
+
+int run(int argc, char** argv) {
+    ClusterRunOptions options;
+    parseClusterOptions(argc, argv, options);
+
+    game::Cluster cluster(options.cluster);
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t generation = 0;
+    while (generation < options.generations) {
+        uint64_t batch = std::min(options.report_every, options.generations - generation);
+        cluster.step(batch);
+        generation += batch;
+        printStats(generation, cluster.stats());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    double cells = double(options.cluster.width) * double(options.cluster.height) * double(options.generations);
+    std::cerr
+        << options.cluster.workers << " workers over " << options.cluster.transport << ": "
+        << std::scientific << std::setprecision(3) << cells / seconds << " cells/s" << std::endl;
+
+    if (options.verify) {
+        game::Board result;
+        cluster.snapshot(result);
+        if (!verify(options, result, cluster.stats())) {
+            std::cerr << "verification failed" << std::endl;
+            return 1;
+        }
+        std::cerr << "verified against a single process" << std::endl;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return run(argc, argv);
+    } catch (std::exception& e) {
+        std::cerr << "gol_cluster: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,127 @@
+#include "board.hpp"
+#include "ensemble.hpp"
+#include "thread_pool.hpp"
+
+#include <map>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+struct EnsembleOptions {
+    uint64_t width = 64;
+    uint64_t height = 64;
+    uint64_t boards = 4096;
+    game::Rule rule = game::Rule::life();
+    uint64_t seed = 0;
+    double density = 0.5;
+    uint64_t generations = 10000;
+    uint32_t max_period = 3;
+    uint32_t threads = 0;
+    bool list = false;
+};
+
+void parseEnsembleOptions(int argc, char** argv, EnsembleOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--list") {
+            options.list = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            throw std::runtime_error(arg + " expects a value");
+        }
+        std::string value = argv[++i];
+        if (arg == "--size") {
+            size_t split = value.find('x');
+            options.width = std::stoull(value.substr(0, split));
+            options.height = split == std::string::npos ? options.width : std::stoull(value.substr(split + 1));
+        } else if (arg == "--boards") {
+            options.boards = std::stoull(value);
+        } else if (arg == "--rule") {
+            game::parseRule(value, options.rule);
+        } else if (arg == "--seed") {
+            options.seed = std::stoull(value);
+        } else if (arg == "--density") {
+            options.density = std::stod(value);
+        } else if (arg == "--generations") {
+            options.generations = std::stoull(value);
+        } else if (arg == "--max-period") {
+            options.max_period = std::stoul(value);
+        } else if (arg == "--threads") {
+            options.threads = std::stoul(value);
+        } else {
+            throw std::runtime_error("unknown option " + arg);
+        }
+    }
+}
+
+const char* endName(game::EnsembleEnd end) {
+    switch (end) {
+    case game::EnsembleEnd::Died:
+        return "died";
+    case game::EnsembleEnd::Periodic:
+        return "periodic";
+    default:
+        return "running";
+    }
+}
+
+int run(int argc, char** argv) {
+    EnsembleOptions options;
+    parseEnsembleOptions(argc, argv, options);
+
+    game::ThreadPool pool(options.threads);
+    game::Ensemble ensemble(options.width, options.height, options.boards, options.rule);
+    ensemble.seed(options.seed, options.density, pool);
+
+    auto begin = std::chrono::steady_clock::now();
+    ensemble.run(options.generations, options.max_period, pool);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    // Board k can be replayed on its own with --seed <seed + k>.
+    if (options.list) {
+        std::cout << "board,seed,end,generation,period,population\n";
+    }
+    uint64_t died = 0, running = 0, stepped = 0;
+    std::map<uint64_t, uint64_t> periods;
+    for (uint64_t k = 0; k < ensemble.size(); k++) {
+        const game::EnsembleResult& r = ensemble.result(k);
+        if (options.list) {
+            std::cout << k << "," << options.seed + k << "," << endName(r.end) << ","
+                << r.generation << "," << r.period << "," << r.population << "\n";
+        }
+        died += r.end == game::EnsembleEnd::Died;
+        running += r.end == game::EnsembleEnd::Running;
+        if (r.end == game::EnsembleEnd::Periodic) {
+            periods[r.period]++;
+        }
+        stepped += r.generation;
+    }
+
+    std::cerr << options.boards << " boards of " << options.width << "x" << options.height
+        << " " << game::ruleName(options.rule) << ": " << died << " died, " << running << " still running";
+    for (auto& p : periods) {
+        std::cerr << ", " << p.second << " with period " << p.first;
+    }
+    std::cerr << std::endl;
+    double cells = double(stepped) * double(options.width) * double(options.height);
+    std::cerr
+        << std::scientific << std::setprecision(3)
+        << double(options.boards) / seconds << " boards/s, "
+        << cells / seconds << " cells/s over " << pool.size() << " threads, "
+        << std::fixed << std::setprecision(1)
+        << double(stepped) / double(options.boards) << " generations per board on average"
+        << std::endl;
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return run(argc, argv);
+    } catch (std::exception& e) {
+        std::cerr << "gol_ensemble: " << e.what() << std::endl;
+        return 1;
+    }
+}
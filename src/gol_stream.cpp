@@ -0,0 +1,49 @@
+#include "board.hpp"
+#include "diff_stream.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+// Reads a diff stream written by `game --stream` and prints one CSV line
+// per record (or per `--every` records), rebuilding every board on the way.
+int run(int argc, char** argv) {
+    std::string input = "-";
+    uint64_t every = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--every") {
+            if (i + 1 >= argc) {
+                throw std::runtime_error(arg + " expects a value");
+            }
+            every = std::max<uint64_t>(std::stoull(argv[++i]), 1);
+        } else {
+            input = arg;
+        }
+    }
+
+    game::DiffStreamReader reader(input);
+    std::cerr << reader.board().width << "x" << reader.board().height << " " << game::ruleName(reader.rule()) << std::endl;
+    std::cout << "generation,population,births,deaths\n";
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t records = 0;
+    while (reader.next()) {
+        if (records++ % every == 0) {
+            const game::StepStats& stats = reader.stats();
+            std::cout << reader.generation() << "," << stats.population << "," << stats.births << "," << stats.deaths << "\n";
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cerr << records << " records, " << std::fixed << std::setprecision(1) << records / seconds << " records/s" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return run(argc, argv);
+    } catch (std::exception& e) {
+        std::cerr << "gol_stream: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,87 @@
+#include "board.hpp"
+#include "shared_board.hpp"
+
+#include <bitset>
+#include <chrono>
+#include <thread>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+// Attaches to a board published by `game --publish` and prints one CSV
+// line per poll. The population is recounted from the frame in place,
+// without copying it, and the line is marked torn when the writer
+// overwrote the frame during the count.
+int run(int argc, char** argv) {
+    std::string name;
+    double interval = 1.0;
+    uint64_t polls = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--interval" || arg == "--polls") {
+            if (i + 1 >= argc) {
+                throw std::runtime_error(arg + " expects a value");
+            }
+            if (arg == "--interval") {
+                interval = std::stod(argv[++i]);
+            } else {
+                polls = std::stoull(argv[++i]);
+            }
+        } else {
+            name = arg;
+        }
+    }
+    if (name.empty()) {
+        throw std::runtime_error("usage: gol_watch NAME [--interval SECONDS] [--polls COUNT]");
+    }
+
+    game::SharedBoardReader reader(name);
+    const game::SharedBoardHeader& info = reader.info();
+    game::Rule rule;
+    rule.birth = info.birth;
+    rule.survive = info.survive;
+    rule.torus = info.torus != 0;
+    std::cerr << info.width << "x" << info.height << " " << game::ruleName(rule) << ", " << info.slots << " slots" << std::endl;
+    std::cout << "generation,population,counted,generations_per_second\n";
+
+    uint64_t words = info.words_per_row * info.height;
+    uint64_t last_generation = 0;
+    auto last_time = std::chrono::steady_clock::now();
+    bool first = true;
+    for (uint64_t poll = 0; polls == 0 || poll < polls; poll++) {
+        game::SharedBoardView view;
+        if (reader.latest(view)) {
+            uint64_t counted = 0;
+            for (uint64_t w = 0; w < words; w++) {
+                counted += std::bitset<64>(view.words[w]).count();
+            }
+            bool torn = !reader.valid(view);
+
+            auto now = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration<double>(now - last_time).count();
+            double rate = first ? 0.0 : (view.generation - last_generation) / seconds;
+            last_generation = view.generation;
+            last_time = now;
+            first = false;
+
+            std::cout << view.generation << "," << view.population << ",";
+            if (torn) {
+                std::cout << "torn";
+            } else {
+                std::cout << counted;
+            }
+            std::cout << "," << std::fixed << std::setprecision(1) << rate << std::endl;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        return run(argc, argv);
+    } catch (std::exception& e) {
+        std::cerr << "gol_watch: " << e.what() << std::endl;
+        return 1;
+    }
+}
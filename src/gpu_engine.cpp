@@ -0,0 +1,500 @@
+#include "gpu_engine.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+namespace game {
+    namespace {
+        // Dispatches recorded per submit, so long runs do not build one
+        // huge command buffer.
+        const uint32_t MAX_DISPATCHES_PER_SUBMIT = 256;
+        // The most vkCmdUpdateBuffer takes at once.
+        const size_t MAX_UPDATE_BYTES = 65536;
+
+        struct BoardConstants {
+            uint32_t width;
+            uint32_t height;
+            uint32_t words_per_row;
+            uint32_t birth;
+            uint32_t survive;
+        };
+
+        vk::Pipeline pipelineFor(GpuStepper& stepper, uint32_t generations) {
+            if (stepper.pipelines[generations]) {
+                return stepper.pipelines[generations];
+            }
+            uint32_t constants[3] = { stepper.group_width, stepper.group_height, generations };
+            std::vector<vk::SpecializationMapEntry> entries;
+            for (uint32_t i = 0; i < 3; i++) {
+                entries.push_back(vk::SpecializationMapEntry()
+                    .setConstantID(i)
+                    .setOffset(i * sizeof(uint32_t))
+                    .setSize(sizeof(uint32_t)));
+            }
+            vk::SpecializationInfo specialization = vk::SpecializationInfo()
+                .setMapEntryCount(entries.size())
+                .setPMapEntries(entries.data())
+                .setDataSize(sizeof(constants))
+                .setPData(constants);
+
+            vk::ComputePipelineCreateInfo pipeline_info = vk::ComputePipelineCreateInfo()
+                .setStage(
+                    vk::PipelineShaderStageCreateInfo()
+                        .setStage(vk::ShaderStageFlagBits::eCompute)
+                        .setModule(stepper.shader)
+                        .setPName("main")
+                        .setPSpecializationInfo(&specialization)
+                )
+                .setLayout(stepper.pipeline_layout);
+            stepper.pipelines[generations] = stepper.device.createComputePipeline(vk::PipelineCache(), pipeline_info).value;
+            return stepper.pipelines[generations];
+        }
+
+        void destroyGpuBoards(vk::Device device, GpuStepper& stepper) {
+            if (stepper.words_per_row == 0) {
+                return;
+            }
+            device.unmapMemory(stepper.staging_memory);
+            device.destroyBuffer(stepper.staging.buffer);
+            device.freeMemory(stepper.staging_memory);
+            device.destroyBuffer(stepper.boards[0].buffer);
+            device.destroyBuffer(stepper.boards[1].buffer);
+            device.freeMemory(stepper.board_memory);
+            stepper.width = 0;
+            stepper.height = 0;
+            stepper.words_per_row = 0;
+            stepper.staging_words = nullptr;
+        }
+
+        void createGpuBoards(GpuStepper& stepper, uint64_t width, uint64_t height) {
+            vk::Device device = stepper.device;
+            destroyGpuBoards(device, stepper);
+
+            vk::PhysicalDeviceLimits limits = stepper.physical_device.getProperties().limits;
+            uint64_t words_per_row = (width + 31) / 32;
+            vk::DeviceSize bytes = words_per_row * height * sizeof(uint32_t);
+            uint64_t groups_x = (words_per_row + stepper.group_width - 3) / (stepper.group_width - 2);
+            uint64_t rows_per_group = stepper.group_height - 2 * stepper.generations;
+            uint64_t groups_y = (height + rows_per_group - 1) / rows_per_group;
+            if (width > UINT32_MAX || bytes > limits.maxStorageBufferRange) {
+                throw std::runtime_error("board too large for a storage buffer");
+            }
+            if (groups_x > limits.maxComputeWorkGroupCount[0] || groups_y > limits.maxComputeWorkGroupCount[1]) {
+                throw std::runtime_error("board needs more workgroups than the device allows");
+            }
+
+            for (Buffer& board : stepper.boards) {
+                createBuffer(
+                    device,
+                    bytes,
+                    { stepper.queue.index.value() },
+                    vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+                    board.buffer
+                );
+                board.mem_reqs = device.getBufferMemoryRequirements(board.buffer);
+            }
+            vk::DeviceSize alignment = stepper.boards[1].mem_reqs.alignment;
+            stepper.boards[0].offset = 0;
+            stepper.boards[1].offset = (stepper.boards[0].mem_reqs.size + alignment - 1) / alignment * alignment;
+            vk::MemoryAllocateInfo board_memory_info = vk::MemoryAllocateInfo()
+                .setAllocationSize(stepper.boards[1].offset + stepper.boards[1].mem_reqs.size)
+                .setMemoryTypeIndex(findMemoryType(
+                    stepper.physical_device,
+                    stepper.boards[0].mem_reqs.memoryTypeBits & stepper.boards[1].mem_reqs.memoryTypeBits,
+                    vk::MemoryPropertyFlags(),
+                    vk::MemoryPropertyFlagBits::eDeviceLocal
+                ));
+            stepper.board_memory = device.allocateMemory(board_memory_info);
+            for (Buffer& board : stepper.boards) {
+                device.bindBufferMemory(board.buffer, stepper.board_memory, board.offset);
+            }
+
+            // Read back every step, so cached host memory where there is one.
+            createBuffer(
+                device,
+                bytes,
+                { stepper.queue.index.value() },
+                vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
+                stepper.staging.buffer
+            );
+            stepper.staging.mem_reqs = device.getBufferMemoryRequirements(stepper.staging.buffer);
+            stepper.staging.offset = 0;
+            vk::MemoryAllocateInfo staging_memory_info = vk::MemoryAllocateInfo()
+                .setAllocationSize(stepper.staging.mem_reqs.size)
+                .setMemoryTypeIndex(findMemoryType(
+                    stepper.physical_device,
+                    stepper.staging.mem_reqs.memoryTypeBits,
+                    vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                    vk::MemoryPropertyFlagBits::eHostCached
+                ));
+            stepper.staging_memory = device.allocateMemory(staging_memory_info);
+            device.bindBufferMemory(stepper.staging.buffer, stepper.staging_memory, 0);
+            stepper.staging_words = static_cast<uint32_t*>(device.mapMemory(stepper.staging_memory, 0, bytes));
+
+            for (uint32_t i = 0; i < 2; i++) {
+                vk::DescriptorBufferInfo source_info { stepper.boards[i].buffer, 0, VK_WHOLE_SIZE };
+                vk::DescriptorBufferInfo target_info { stepper.boards[1 - i].buffer, 0, VK_WHOLE_SIZE };
+                std::vector<vk::WriteDescriptorSet> writes = {
+                    vk::WriteDescriptorSet(stepper.sets[i], 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &source_info, nullptr),
+                    vk::WriteDescriptorSet(stepper.sets[i], 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &target_info, nullptr)
+                };
+                device.updateDescriptorSets(writes, {});
+            }
+
+            stepper.width = width;
+            stepper.height = height;
+            stepper.words_per_row = words_per_row;
+        }
+
+        void submitAndWait(GpuStepper& stepper) {
+            stepper.command_buffer.end();
+            vk::SubmitInfo submit_info = vk::SubmitInfo()
+                .setCommandBufferCount(1)
+                .setPCommandBuffers(&stepper.command_buffer);
+            uint64_t begin_ns = trace::now();
+            stepper.queue.queue.submit({ submit_info }, stepper.fence);
+            if (stepper.device.waitForFences({ stepper.fence }, VK_TRUE, UINT64_MAX) != vk::Result::eSuccess) {
+                throw std::runtime_error("waiting for the gpu step failed");
+            }
+            metrics::add(metrics::g_counters.gpu_ns, trace::now() - begin_ns);
+            metrics::add(metrics::g_counters.gpu_submits, 1);
+            stepper.device.resetFences({ stepper.fence });
+        }
+
+        void beginCommands(GpuStepper& stepper) {
+            stepper.command_buffer.reset({});
+            stepper.command_buffer.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        }
+
+        // 64 bit board words are two 32 bit words each on little endian
+        // hosts, so a row converts with a single copy of its first
+        // words_per_row halves.
+        class GpuEngine : public Engine {
+        public:
+            GpuEngine(GpuStepper& stepper, Rule rule) : stepper(stepper), rule(rule) {}
+
+            const char* name() const override {
+                return "gpu";
+            }
+
+            void load(const Board& board) override {
+                GAME_TRACE_SCOPE("gpu load");
+                if (board.width != stepper.width || board.height != stepper.height) {
+                    createGpuBoards(stepper, board.width, board.height);
+                }
+                for (uint64_t i = 0; i < board.height; i++) {
+                    std::memcpy(stepper.staging_words + i * stepper.words_per_row, board.row(i), stepper.words_per_row * sizeof(uint32_t));
+                }
+                beginCommands(stepper);
+                stepper.command_buffer.copyBuffer(
+                    stepper.staging.buffer,
+                    stepper.boards[0].buffer,
+                    { vk::BufferCopy(0, 0, stepper.words_per_row * stepper.height * sizeof(uint32_t)) }
+                );
+                submitAndWait(stepper);
+                current = 0;
+                result = board;
+                step_stats = boardStats(board);
+            }
+
+            void store(Board& board) const override {
+                board = result;
+            }
+
+            // Rewrites only the touched words, in runs of neighbouring ones.
+            void edit(const std::vector<CellEdit>& edits) override {
+                GAME_TRACE_SCOPE("gpu edit");
+                applyEdits(result, edits, &step_stats);
+                std::vector<uint64_t> words;
+                for (const CellEdit& edit : edits) {
+                    if (edit.row < result.height && edit.column < result.width) {
+                        words.push_back(edit.row * stepper.words_per_row + edit.column / 32);
+                    }
+                }
+                if (words.empty()) {
+                    return;
+                }
+                std::sort(words.begin(), words.end());
+                words.erase(std::unique(words.begin(), words.end()), words.end());
+
+                beginCommands(stepper);
+                std::vector<uint32_t> run;
+                for (size_t k = 0; k < words.size(); k++) {
+                    uint64_t row = words[k] / stepper.words_per_row;
+                    uint64_t word = words[k] % stepper.words_per_row;
+                    run.push_back(reinterpret_cast<const uint32_t*>(result.row(row))[word]);
+                    bool last = k + 1 == words.size() || words[k + 1] != words[k] + 1
+                        || run.size() * sizeof(uint32_t) == MAX_UPDATE_BYTES;
+                    if (last) {
+                        stepper.command_buffer.updateBuffer(
+                            stepper.boards[current].buffer,
+                            (words[k] + 1 - run.size()) * sizeof(uint32_t),
+                            run.size() * sizeof(uint32_t),
+                            run.data()
+                        );
+                        run.clear();
+                    }
+                }
+                submitAndWait(stepper);
+            }
+
+            // Births and deaths are not counted on the GPU, so stats()
+            // reports them as zero like after a load.
+            void step(uint64_t generations) override {
+                GAME_TRACE_SCOPE("gpu step");
+                if (generations == 0) {
+                    return;
+                }
+                BoardConstants constants {
+                    static_cast<uint32_t>(stepper.width),
+                    static_cast<uint32_t>(stepper.height),
+                    stepper.words_per_row,
+                    rule.birth,
+                    rule.survive
+                };
+                // Also orders each submit after the previous one and after
+                // the copy in load.
+                vk::MemoryBarrier dispatch_barrier = vk::MemoryBarrier()
+                    .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite)
+                    .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+                while (generations > 0) {
+                    beginCommands(stepper);
+                    for (uint32_t d = 0; d < MAX_DISPATCHES_PER_SUBMIT && generations > 0; d++) {
+                        uint32_t g = static_cast<uint32_t>(std::min<uint64_t>(generations, stepper.generations));
+                        uint32_t rows_per_group = stepper.group_height - 2 * g;
+                        stepper.command_buffer.pipelineBarrier(
+                            vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+                            vk::PipelineStageFlagBits::eComputeShader,
+                            {},
+                            { dispatch_barrier },
+                            {},
+                            {}
+                        );
+                        stepper.command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipelineFor(stepper, g));
+                        stepper.command_buffer.bindDescriptorSets(
+                            vk::PipelineBindPoint::eCompute,
+                            stepper.pipeline_layout,
+                            0,
+                            { stepper.sets[current] },
+                            {}
+                        );
+                        stepper.command_buffer.pushConstants(
+                            stepper.pipeline_layout,
+                            vk::ShaderStageFlagBits::eCompute,
+                            0,
+                            sizeof(constants),
+                            &constants
+                        );
+                        stepper.command_buffer.dispatch(
+                            (stepper.words_per_row + stepper.group_width - 3) / (stepper.group_width - 2),
+                            static_cast<uint32_t>((stepper.height + rows_per_group - 1) / rows_per_group),
+                            1
+                        );
+                        current = 1 - current;
+                        generations -= g;
+                    }
+                    if (generations == 0) {
+                        vk::MemoryBarrier copy_barrier = vk::MemoryBarrier()
+                            .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+                            .setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+                        stepper.command_buffer.pipelineBarrier(
+                            vk::PipelineStageFlagBits::eComputeShader,
+                            vk::PipelineStageFlagBits::eTransfer,
+                            {},
+                            { copy_barrier },
+                            {},
+                            {}
+                        );
+                        stepper.command_buffer.copyBuffer(
+                            stepper.boards[current].buffer,
+                            stepper.staging.buffer,
+                            { vk::BufferCopy(0, 0, stepper.words_per_row * stepper.height * sizeof(uint32_t)) }
+                        );
+                        vk::MemoryBarrier host_barrier = vk::MemoryBarrier()
+                            .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+                            .setDstAccessMask(vk::AccessFlagBits::eHostRead);
+                        stepper.command_buffer.pipelineBarrier(
+                            vk::PipelineStageFlagBits::eTransfer,
+                            vk::PipelineStageFlagBits::eHost,
+                            {},
+                            { host_barrier },
+                            {},
+                            {}
+                        );
+                    }
+                    submitAndWait(stepper);
+                }
+
+                GAME_TRACE_SCOPE("gpu readback");
+                for (uint64_t i = 0; i < result.height; i++) {
+                    std::memcpy(result.row(i), stepper.staging_words + i * stepper.words_per_row, stepper.words_per_row * sizeof(uint32_t));
+                }
+                step_stats = boardStats(result);
+            }
+
+            uint64_t memoryBytes() const override {
+                return 3 * uint64_t(stepper.words_per_row) * stepper.height * sizeof(uint32_t)
+                    + result.words.size() * sizeof(uint64_t);
+            }
+
+        private:
+            GpuStepper& stepper;
+            Rule rule;
+            // Index of the buffer holding the latest generation.
+            uint32_t current = 0;
+            Board result;
+        };
+    }
+
+    bool isGpuEngine(std::string name) {
+        return name.substr(0, name.find(':')) == "gpu";
+    }
+
+    void createGpuStepper(
+        vk::Device device,
+        vk::PhysicalDevice physical_device,
+        Queue compute_queue,
+        std::string name,
+        GpuStepper& stepper
+    ) {
+        stepper.device = device;
+        stepper.physical_device = physical_device;
+        stepper.queue = compute_queue;
+
+        vk::PhysicalDeviceProperties properties = physical_device.getProperties();
+        const vk::PhysicalDeviceLimits& limits = properties.limits;
+        stepper.group_width = std::min<uint32_t>(32, limits.maxComputeWorkGroupSize[0]);
+        stepper.group_height = std::min<uint32_t>(
+            { 16, limits.maxComputeWorkGroupSize[1], limits.maxComputeWorkGroupInvocations / stepper.group_width }
+        );
+        stepper.generations = std::min<uint32_t>(4, (stepper.group_height - 1) / 2);
+
+        std::vector<std::string> parameters;
+        for (size_t begin = name.find(':'); begin != std::string::npos; ) {
+            size_t end = name.find(':', begin + 1);
+            parameters.push_back(name.substr(begin + 1, end == std::string::npos ? std::string::npos : end - begin - 1));
+            begin = end;
+        }
+        if (parameters.size() > 0) {
+            stepper.generations = std::stoul(parameters[0]);
+        }
+        if (parameters.size() > 1) {
+            size_t split = parameters[1].find('x');
+            if (split == std::string::npos) {
+                throw std::runtime_error("gpu workgroup size expects <x>x<y>");
+            }
+            stepper.group_width = std::stoul(parameters[1].substr(0, split));
+            stepper.group_height = std::stoul(parameters[1].substr(split + 1));
+        }
+        bool allow_subgroups = true;
+        if (parameters.size() > 2) {
+            if (parameters[2] != "shared") {
+                throw std::runtime_error("unknown gpu option " + parameters[2] + ", expected shared");
+            }
+            allow_subgroups = false;
+        }
+        // The halo is one word wide, which covers at most 32 generations of
+        // spread, and at least one row must remain after the top and
+        // bottom halo.
+        if (stepper.generations == 0 || stepper.generations > 32) {
+            throw std::runtime_error("gpu generations per dispatch must be 1..32");
+        }
+        if (stepper.group_width < 3 || stepper.group_height <= 2 * stepper.generations) {
+            throw std::runtime_error("gpu workgroup too small for its halo");
+        }
+        if (stepper.group_width > limits.maxComputeWorkGroupSize[0]
+            || stepper.group_height > limits.maxComputeWorkGroupSize[1]
+            || stepper.group_width * stepper.group_height > limits.maxComputeWorkGroupInvocations
+            || stepper.group_width * stepper.group_height * sizeof(uint32_t) > limits.maxComputeSharedMemorySize) {
+            throw std::runtime_error("gpu workgroup larger than the device allows");
+        }
+
+        stepper.subgroups = false;
+        if (allow_subgroups && properties.apiVersion >= VK_API_VERSION_1_1 && vk::enumerateInstanceVersion() >= VK_API_VERSION_1_1) {
+            auto chain = physical_device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>();
+            const vk::PhysicalDeviceSubgroupProperties& subgroup = chain.get<vk::PhysicalDeviceSubgroupProperties>();
+            stepper.subgroups = bool(subgroup.supportedStages & vk::ShaderStageFlagBits::eCompute)
+                && bool(subgroup.supportedOperations & vk::SubgroupFeatureFlagBits::eShuffleRelative);
+        }
+        std::cerr
+            << "gpu engine: " << stepper.generations << " generations per dispatch, workgroup "
+            << stepper.group_width << "x" << stepper.group_height
+            << (stepper.subgroups ? ", subgroup shuffles" : "") << std::endl;
+
+        vk::CommandPoolCreateInfo command_pool_info = vk::CommandPoolCreateInfo()
+            .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+            .setQueueFamilyIndex(compute_queue.index.value());
+        stepper.command_pool = device.createCommandPool(command_pool_info);
+        vk::CommandBufferAllocateInfo command_buffer_info = vk::CommandBufferAllocateInfo()
+            .setCommandPool(stepper.command_pool)
+            .setLevel(vk::CommandBufferLevel::ePrimary)
+            .setCommandBufferCount(1);
+        stepper.command_buffer = device.allocateCommandBuffers(command_buffer_info)[0];
+        stepper.fence = device.createFence(vk::FenceCreateInfo());
+
+        std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+            vk::DescriptorSetLayoutBinding { 0, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+            vk::DescriptorSetLayoutBinding { 1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr }
+        };
+        vk::DescriptorSetLayoutCreateInfo set_layout_info = vk::DescriptorSetLayoutCreateInfo()
+            .setBindingCount(bindings.size())
+            .setPBindings(bindings.data());
+        stepper.set_layout = device.createDescriptorSetLayout(set_layout_info);
+
+        std::vector<vk::DescriptorPoolSize> sizes = {
+            vk::DescriptorPoolSize { vk::DescriptorType::eStorageBuffer, 4 }
+        };
+        vk::DescriptorPoolCreateInfo pool_info = vk::DescriptorPoolCreateInfo()
+            .setMaxSets(2)
+            .setPoolSizeCount(sizes.size())
+            .setPPoolSizes(sizes.data());
+        stepper.descriptor_pool = device.createDescriptorPool(pool_info);
+        std::vector<vk::DescriptorSetLayout> layouts(2, stepper.set_layout);
+        vk::DescriptorSetAllocateInfo set_info = vk::DescriptorSetAllocateInfo()
+            .setDescriptorPool(stepper.descriptor_pool)
+            .setDescriptorSetCount(layouts.size())
+            .setPSetLayouts(layouts.data());
+        stepper.sets = device.allocateDescriptorSets(set_info);
+
+        vk::PushConstantRange push_range = vk::PushConstantRange()
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+            .setOffset(0)
+            .setSize(sizeof(BoardConstants));
+        vk::PipelineLayoutCreateInfo pipeline_layout_info = vk::PipelineLayoutCreateInfo()
+            .setSetLayoutCount(1)
+            .setPSetLayouts(&stepper.set_layout)
+            .setPushConstantRangeCount(1)
+            .setPPushConstantRanges(&push_range);
+        stepper.pipeline_layout = device.createPipelineLayout(pipeline_layout_info);
+
+        stepper.shader = loadShader(device, stepper.subgroups ? "compute_subgroup.spv" : "compute.spv");
+        stepper.pipelines.assign(stepper.generations + 1, vk::Pipeline());
+    }
+
+    void destroyGpuStepper(vk::Device device, GpuStepper& stepper) {
+        destroyGpuBoards(device, stepper);
+        for (vk::Pipeline pipeline : stepper.pipelines) {
+            if (pipeline) {
+                device.destroyPipeline(pipeline);
+            }
+        }
+        stepper.pipelines.clear();
+        device.destroyShaderModule(stepper.shader);
+        device.destroyPipelineLayout(stepper.pipeline_layout);
+        device.destroyDescriptorPool(stepper.descriptor_pool);
+        device.destroyDescriptorSetLayout(stepper.set_layout);
+        device.destroyFence(stepper.fence);
+        device.destroyCommandPool(stepper.command_pool);
+    }
+
+    void createGpuEngine(GpuStepper& stepper, Rule rule, std::unique_ptr<Engine>& engine) {
+        if (rule.torus) {
+            throw std::runtime_error("gpu engine only steps bounded boards");
+        }
+        engine = std::make_unique<GpuEngine>(stepper, rule);
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef __GPU__ENGINE__HPP__
+#define __GPU__ENGINE__HPP__
+
+#include "engine.hpp"
+#include "vulkan_methods.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace game {
+    // Vulkan state behind the "gpu" engine. The board is kept as 32 cells
+    // per uint in two device local storage buffers that compute.comp.glsl
+    // ping-pongs between, with a host visible staging buffer for load and
+    // store. Like the rest of the Vulkan objects it is destroyed
+    // explicitly, and the engine must not be used after that.
+    struct GpuStepper {
+        vk::Device device;
+        vk::PhysicalDevice physical_device;
+        Queue queue;
+        vk::CommandPool command_pool;
+        vk::CommandBuffer command_buffer;
+        vk::Fence fence;
+        vk::DescriptorSetLayout set_layout;
+        vk::DescriptorPool descriptor_pool;
+        // sets[i] reads boards[i] and writes boards[1 - i].
+        std::vector<vk::DescriptorSet> sets;
+        vk::PipelineLayout pipeline_layout;
+        vk::ShaderModule shader;
+        // pipelines[g] advances g generations per dispatch, created on
+        // first use.
+        std::vector<vk::Pipeline> pipelines;
+        uint32_t group_width;
+        uint32_t group_height;
+        uint32_t generations;
+        bool subgroups;
+
+        uint64_t width = 0;
+        uint64_t height = 0;
+        uint32_t words_per_row = 0;
+        Buffer boards[2];
+        vk::DeviceMemory board_memory;
+        Buffer staging;
+        vk::DeviceMemory staging_memory;
+        uint32_t* staging_words = nullptr;
+    };
+
+    bool isGpuEngine(std::string name);
+    // name is "gpu[:<generations>[:<x>x<y>[:shared]]]", the generations
+    // advanced per dispatch and the workgroup size in words by rows. These
+    // become specialization constants, so they can be tuned per device
+    // without rebuilding shaders. The defaults are 4 and 32x16, or as many
+    // rows as the device allows. shared keeps to the shared memory shader
+    // even where subgroup shuffles are supported.
+    void createGpuStepper(
+        vk::Device device,
+        vk::PhysicalDevice physical_device,
+        Queue compute_queue,
+        std::string name,
+        GpuStepper& stepper
+    );
+    void destroyGpuStepper(vk::Device device, GpuStepper& stepper);
+    void createGpuEngine(GpuStepper& stepper, Rule rule, std::unique_ptr<Engine>& engine);
+}
+
+#endif // __GPU__ENGINE__HPP__
@@ -0,0 +1,141 @@
+#include "history.hpp"
+#include "delta.hpp"
+#include "trace.hpp"
+
+#include <stdexcept>
+
+namespace game {
+    History::History(uint64_t keyframe_interval, uint64_t budget_bytes)
+        : keyframe_interval(keyframe_interval == 0 ? 1 : keyframe_interval), budget_bytes(budget_bytes) {}
+
+    void History::clear() {
+        entries.clear();
+        encoded_bytes = 0;
+        since_keyframe = 0;
+        cursor_entry = SIZE_MAX;
+    }
+
+    void History::record(const Board& board, uint64_t generation) {
+        GAME_TRACE_SCOPE("history record");
+        if (!entries.empty() && (board.width != previous.width || board.height != previous.height)) {
+            clear();
+        }
+        if (!entries.empty() && generation <= newest()) {
+            if (generation <= oldest()) {
+                clear();
+            } else {
+                size_t keep = find(generation - 1) + 1;
+                while (entries.size() > keep) {
+                    encoded_bytes -= entries.back().data.size();
+                    entries.pop_back();
+                }
+                since_keyframe = 0;
+                for (size_t e = entries.size(); e-- > 0 && !entries[e].keyframe; ) {
+                    since_keyframe++;
+                }
+                // The cursor may sit on an entry that was just dropped.
+                if (cursor_entry != SIZE_MAX && cursor_entry >= entries.size()) {
+                    cursor_entry = SIZE_MAX;
+                }
+                restore(newest(), previous);
+            }
+        }
+
+        Entry entry { generation, true, {} };
+        if (!entries.empty() && since_keyframe + 1 < keyframe_interval) {
+            encodeWordDelta(&previous, board, entry.data);
+            std::vector<uint8_t> keyframe;
+            // A delta bigger than the board itself means the board changed
+            // almost everywhere; a keyframe is then both smaller and a
+            // shorter restore path.
+            if (entry.data.size() > board.words.size() * sizeof(uint64_t) / 2) {
+                encodeWordDelta(nullptr, board, keyframe);
+                if (keyframe.size() <= entry.data.size()) {
+                    entry.data.swap(keyframe);
+                } else {
+                    entry.keyframe = false;
+                }
+            } else {
+                entry.keyframe = false;
+            }
+        } else {
+            encodeWordDelta(nullptr, board, entry.data);
+        }
+        since_keyframe = entry.keyframe ? 0 : since_keyframe + 1;
+        encoded_bytes += entry.data.size();
+        entries.push_back(std::move(entry));
+        previous = board;
+        evict();
+    }
+
+    void History::evict() {
+        // The newest keyframe segment always stays.
+        while (memoryBytes() > budget_bytes) {
+            size_t next_keyframe = 1;
+            while (next_keyframe < entries.size() && !entries[next_keyframe].keyframe) {
+                next_keyframe++;
+            }
+            if (next_keyframe == entries.size()) {
+                return;
+            }
+            for (size_t e = 0; e < next_keyframe; e++) {
+                encoded_bytes -= entries.front().data.size();
+                entries.pop_front();
+            }
+            if (cursor_entry != SIZE_MAX) {
+                cursor_entry = cursor_entry >= next_keyframe ? cursor_entry - next_keyframe : SIZE_MAX;
+            }
+        }
+    }
+
+    size_t History::find(uint64_t generation) const {
+        size_t low = 0;
+        size_t high = entries.size();
+        while (high - low > 1) {
+            size_t middle = (low + high) / 2;
+            if (entries[middle].generation <= generation) {
+                low = middle;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    }
+
+    uint64_t History::restore(uint64_t generation, Board& board) {
+        GAME_TRACE_SCOPE("history restore");
+        if (entries.empty() || generation < oldest()) {
+            throw std::runtime_error("generation " + std::to_string(generation) + " is not in the history");
+        }
+        size_t target = find(generation);
+        size_t keyframe = target;
+        while (!entries[keyframe].keyframe) {
+            keyframe--;
+        }
+
+        // Walk from the cursor if it is in the same segment and closer
+        // than the keyframe. XOR deltas undo themselves, so walking
+        // backwards applies the same data as walking forwards, but a
+        // keyframe cannot be undone.
+        bool from_cursor = cursor_entry != SIZE_MAX && cursor_entry >= keyframe
+            && (cursor_entry > target ? cursor_entry - target : target - cursor_entry) < target - keyframe;
+        for (size_t e = target + 1; from_cursor && e <= cursor_entry; e++) {
+            from_cursor = !entries[e].keyframe;
+        }
+        if (!from_cursor) {
+            createBoard(previous.width, previous.height, cursor);
+            cursor_entry = keyframe;
+            applyWordDelta(entries[keyframe].data.data(), entries[keyframe].data.size(), cursor);
+        }
+        while (cursor_entry < target) {
+            const std::vector<uint8_t>& data = entries[++cursor_entry].data;
+            applyWordDelta(data.data(), data.size(), cursor);
+        }
+        while (cursor_entry > target) {
+            const std::vector<uint8_t>& data = entries[cursor_entry--].data;
+            applyWordDelta(data.data(), data.size(), cursor);
+        }
+        board = cursor;
+        return entries[target].generation;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef __HISTORY__HPP__
+#define __HISTORY__HPP__
+
+#include "board.hpp"
+
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+namespace game {
+    // Recorded boards for rewinding. Each entry is the XOR against the
+    // entry before it, stored as runs of changed words, with a keyframe
+    // (the XOR against an empty board) every keyframe_interval entries or
+    // whenever a delta would be larger than a keyframe. When the budget is
+    // exceeded the oldest keyframe and its deltas are dropped together.
+    //
+    // Generations only need to increase: with several generations per
+    // frame only the generations that were actually shown are recorded.
+    class History {
+    public:
+        History(uint64_t keyframe_interval, uint64_t budget_bytes);
+
+        // Recording a generation at or before the newest one first discards
+        // everything from it on, so resuming after a rewind branches off.
+        void record(const Board& board, uint64_t generation);
+        // Restores the newest recorded generation <= generation and
+        // returns it. Walking backwards one entry at a time only undoes
+        // one delta per call.
+        uint64_t restore(uint64_t generation, Board& board);
+        void clear();
+
+        bool empty() const {
+            return entries.empty();
+        }
+
+        uint64_t oldest() const {
+            return entries.front().generation;
+        }
+
+        uint64_t newest() const {
+            return entries.back().generation;
+        }
+
+        uint64_t memoryBytes() const {
+            return encoded_bytes + (previous.words.size() + cursor.words.size()) * sizeof(uint64_t);
+        }
+
+    private:
+        struct Entry {
+            uint64_t generation;
+            bool keyframe;
+            std::vector<uint8_t> data;
+        };
+
+        size_t find(uint64_t generation) const;
+        void evict();
+
+        uint64_t keyframe_interval;
+        uint64_t budget_bytes;
+        std::deque<Entry> entries;
+        uint64_t encoded_bytes = 0;
+        uint64_t since_keyframe = 0;
+        // The newest recorded board, which the next delta is taken against.
+        Board previous;
+        // The last restored board, and which entry it is, so neighbouring
+        // restores can walk deltas from there instead of from a keyframe.
+        Board cursor;
+        size_t cursor_entry = SIZE_MAX;
+    };
+}
+
+#endif // __HISTORY__HPP__
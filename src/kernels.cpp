@@ -0,0 +1,43 @@
+#include "kernels.hpp"
+
+namespace game {
+    namespace {
+        template <uint64_t WORDS, bool LIFE, bool TORUS>
+        RowKernel pickStats(bool stats) {
+            return stats ? &stepRowKernel<WORDS, LIFE, TORUS, true> : &stepRowKernel<WORDS, LIFE, TORUS, false>;
+        }
+
+        template <uint64_t WORDS>
+        RowKernel pickRule(bool life, bool torus, bool stats) {
+            if (life) {
+                return torus ? pickStats<WORDS, true, true>(stats) : pickStats<WORDS, true, false>(stats);
+            }
+            return torus ? pickStats<WORDS, false, true>(stats) : pickStats<WORDS, false, false>(stats);
+        }
+    }
+
+    RowKernel selectRowKernel(const RowShape& shape, Rule rule, bool stats, std::string* name) {
+        RowKernel kernel;
+        bool fixed_width = true;
+        switch (shape.words) {
+            case 1: kernel = pickRule<1>(rule.isLife(), rule.torus, stats); break;
+            case 2: kernel = pickRule<2>(rule.isLife(), rule.torus, stats); break;
+            case 4: kernel = pickRule<4>(rule.isLife(), rule.torus, stats); break;
+            case 8: kernel = pickRule<8>(rule.isLife(), rule.torus, stats); break;
+            case 16: kernel = pickRule<16>(rule.isLife(), rule.torus, stats); break;
+            case 32: kernel = pickRule<32>(rule.isLife(), rule.torus, stats); break;
+            case 64: kernel = pickRule<64>(rule.isLife(), rule.torus, stats); break;
+            case 128: kernel = pickRule<128>(rule.isLife(), rule.torus, stats); break;
+            case 256: kernel = pickRule<256>(rule.isLife(), rule.torus, stats); break;
+            default:
+                kernel = pickRule<0>(rule.isLife(), rule.torus, stats);
+                fixed_width = false;
+        }
+        if (name) {
+            *name = (fixed_width ? std::to_string(shape.words) + " words" : std::string("any width"))
+                + (rule.isLife() ? ", B3/S23" : ", rule table")
+                + (rule.torus ? ", torus" : ", bounded");
+        }
+        return kernel;
+    }
+}
@@ -0,0 +1,230 @@
+#ifndef __KERNELS__HPP__
+#define __KERNELS__HPP__
+
+#include "board.hpp"
+
+#include <string>
+#include <cstdint>
+
+namespace game {
+    // Bit-sliced neighbour count of 64 cells at once: bit k of count[b] is
+    // bit b of the number of live neighbours of cell k.
+    struct NeighbourCount {
+        uint64_t count[4];
+    };
+
+    inline void fullAdd(uint64_t a, uint64_t b, uint64_t c, uint64_t& sum, uint64_t& carry) {
+        uint64_t t = a ^ b;
+        sum = t ^ c;
+        carry = (a & b) | (t & c);
+    }
+
+    inline NeighbourCount countNeighbours(
+        uint64_t up_left, uint64_t up, uint64_t up_right,
+        uint64_t left, uint64_t right,
+        uint64_t down_left, uint64_t down, uint64_t down_right
+    ) {
+        uint64_t s0, c0, s1, c1, s2, c2, b0, ca, t, cb, b1, cc;
+        fullAdd(up_left, up, up_right, s0, c0);
+        fullAdd(left, right, down_left, s1, c1);
+        s2 = down ^ down_right;
+        c2 = down & down_right;
+        fullAdd(s0, s1, s2, b0, ca);
+        fullAdd(c0, c1, c2, t, cb);
+        b1 = t ^ ca;
+        cc = t & ca;
+        return NeighbourCount { { b0, b1, cb ^ cc, cb & cc } };
+    }
+
+    inline uint64_t countEquals(const NeighbourCount& n, uint32_t value) {
+        uint64_t m = ~uint64_t(0);
+        for (uint32_t b = 0; b < 4; b++) {
+            m &= (value >> b) & 1 ? n.count[b] : ~n.count[b];
+        }
+        return m;
+    }
+
+    inline uint64_t applyLife(uint64_t alive, const NeighbourCount& n) {
+        // count is 2 or 3 when bits are 0b001x, and 3 when 0b0011.
+        uint64_t two_or_three = ~n.count[3] & ~n.count[2] & n.count[1];
+        return two_or_three & (n.count[0] | alive);
+    }
+
+    inline uint64_t applyRuleTable(uint64_t alive, const NeighbourCount& n, Rule rule) {
+        uint64_t born = 0;
+        uint64_t survives = 0;
+        for (uint32_t value = 0; value <= 8; value++) {
+            if ((rule.birth | rule.survive) & (1 << value)) {
+                uint64_t eq = countEquals(n, value);
+                if (rule.birth & (1 << value)) {
+                    born |= eq;
+                }
+                if (rule.survive & (1 << value)) {
+                    survives |= eq;
+                }
+            }
+        }
+        return (alive & survives) | (~alive & born);
+    }
+
+    inline uint64_t applyRule(uint64_t alive, const NeighbourCount& n, Rule rule) {
+        return rule.isLife() ? applyLife(alive, n) : applyRuleTable(alive, n, rule);
+    }
+
+    // Advances one packed row. up/down may be null for rows outside the
+    // board, which count as dead. With stats set, the new row is counted
+    // into it as board row `row_index`.
+    inline void stepRow(
+        const uint64_t* up,
+        const uint64_t* cur,
+        const uint64_t* down,
+        uint64_t* out,
+        uint64_t words,
+        uint64_t last_word_mask,
+        Rule rule,
+        StepStats* stats = nullptr,
+        uint64_t row_index = 0
+    ) {
+        uint64_t up_prev = 0, cur_prev = 0, down_prev = 0;
+        uint64_t up_word = up ? up[0] : 0;
+        uint64_t cur_word = cur[0];
+        uint64_t down_word = down ? down[0] : 0;
+        for (uint64_t w = 0; w < words; w++) {
+            uint64_t up_next = 0, cur_next = 0, down_next = 0;
+            if (w + 1 < words) {
+                up_next = up ? up[w + 1] : 0;
+                cur_next = cur[w + 1];
+                down_next = down ? down[w + 1] : 0;
+            }
+            NeighbourCount n = countNeighbours(
+                (up_word << 1) | (up_prev >> 63), up_word, (up_word >> 1) | (up_next << 63),
+                (cur_word << 1) | (cur_prev >> 63), (cur_word >> 1) | (cur_next << 63),
+                (down_word << 1) | (down_prev >> 63), down_word, (down_word >> 1) | (down_next << 63)
+            );
+            uint64_t result = applyRule(cur_word, n, rule);
+            if (w + 1 == words) {
+                result &= last_word_mask;
+            }
+            out[w] = result;
+            if (stats) {
+                stats->addWord(row_index, w, cur_word, result);
+            }
+            up_prev = up_word; cur_prev = cur_word; down_prev = down_word;
+            up_word = up_next; cur_word = cur_next; down_word = down_next;
+        }
+    }
+
+    struct RowShape {
+        uint64_t width;
+        uint64_t words;
+        uint64_t last_word_mask;
+    };
+
+    // stepRow with the row length (WORDS, 0 for any), the rule (LIFE or
+    // the rule table) and the topology fixed at compile time. up and down
+    // are never null: bounded boards pass a dead row past the edges, tori
+    // the opposite edge row. The interior loop has no branches or carried
+    // state, so the compiler can unroll and vectorize it; edge words and
+    // stats are handled outside it.
+    template <uint64_t WORDS, bool LIFE, bool TORUS, bool STATS>
+    void stepRowKernel(
+        const uint64_t* up,
+        const uint64_t* cur,
+        const uint64_t* down,
+        uint64_t* out,
+        const RowShape& shape,
+        Rule rule,
+        StepStats* stats,
+        uint64_t row_index
+    ) {
+        const uint64_t words = WORDS != 0 ? WORDS : shape.words;
+        const uint64_t last = words - 1;
+
+        auto cell = [rule](
+            uint64_t up_prev, uint64_t up_word, uint64_t up_next,
+            uint64_t cur_prev, uint64_t cur_word, uint64_t cur_next,
+            uint64_t down_prev, uint64_t down_word, uint64_t down_next
+        ) {
+            NeighbourCount n = countNeighbours(
+                (up_word << 1) | (up_prev >> 63), up_word, (up_word >> 1) | (up_next << 63),
+                (cur_word << 1) | (cur_prev >> 63), (cur_word >> 1) | (cur_next << 63),
+                (down_word << 1) | (down_prev >> 63), down_word, (down_word >> 1) | (down_next << 63)
+            );
+            return LIFE ? applyLife(cur_word, n) : applyRuleTable(cur_word, n, rule);
+        };
+
+        for (uint64_t w = 1; w < last; w++) {
+            out[w] = cell(
+                up[w - 1], up[w], up[w + 1],
+                cur[w - 1], cur[w], cur[w + 1],
+                down[w - 1], down[w], down[w + 1]
+            );
+        }
+
+        // What lies left of word 0 (in bit 63) and right of the last word
+        // (in bit 0). On a torus whose width is not a multiple of 64, the
+        // right neighbour of the last column is planted in the padding bit
+        // just past it instead, and masked off again afterwards.
+        uint64_t up_before = 0, cur_before = 0, down_before = 0;
+        uint64_t up_after = 0, cur_after = 0, down_after = 0;
+        uint64_t up_last = up[last], cur_last = cur[last], down_last = down[last];
+        if (TORUS) {
+            uint32_t edge = (shape.width - 1) & 63;
+            up_before = (up[last] >> edge) << 63;
+            cur_before = (cur[last] >> edge) << 63;
+            down_before = (down[last] >> edge) << 63;
+            if (edge == 63) {
+                up_after = up[0];
+                cur_after = cur[0];
+                down_after = down[0];
+            } else {
+                up_last |= (up[0] & 1) << (edge + 1);
+                cur_last |= (cur[0] & 1) << (edge + 1);
+                down_last |= (down[0] & 1) << (edge + 1);
+            }
+        }
+        if (last == 0) {
+            out[0] = cell(
+                up_before, up_last, up_after,
+                cur_before, cur_last, cur_after,
+                down_before, down_last, down_after
+            ) & shape.last_word_mask;
+        } else {
+            out[0] = cell(
+                up_before, up[0], up[1],
+                cur_before, cur[0], cur[1],
+                down_before, down[0], down[1]
+            );
+            out[last] = cell(
+                up[last - 1], up_last, up_after,
+                cur[last - 1], cur_last, cur_after,
+                down[last - 1], down_last, down_after
+            ) & shape.last_word_mask;
+        }
+
+        if (STATS) {
+            for (uint64_t w = 0; w < words; w++) {
+                stats->addWord(row_index, w, cur[w], out[w]);
+            }
+        }
+    }
+
+    using RowKernel = void (*)(
+        const uint64_t* up,
+        const uint64_t* cur,
+        const uint64_t* down,
+        uint64_t* out,
+        const RowShape& shape,
+        Rule rule,
+        StepStats* stats,
+        uint64_t row_index
+    );
+
+    // The stepRowKernel instance for this shape and rule: rows of a power
+    // of two number of words up to 256 (16384 cells) and B3/S23 get their
+    // own, anything else the generic one. name, when set, describes the
+    // choice.
+    RowKernel selectRowKernel(const RowShape& shape, Rule rule, bool stats, std::string* name = nullptr);
+}
+
+#endif // __KERNELS__HPP__
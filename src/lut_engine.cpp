@@ -0,0 +1,158 @@
+#include "engine.hpp"
+#include "trace.hpp"
+
+#include <array>
+
+namespace game {
+    namespace {
+        // Advances the board in 2x2 blocks. Each block's next state depends
+        // only on the 4x4 neighbourhood around it, so all 2^16
+        // neighbourhoods are solved once up front and the step becomes one
+        // table lookup per block. Neighbourhoods are gathered straight from
+        // the bit-packed rows: 4 bits from each of 4 rows.
+        class LutEngine : public Engine {
+        public:
+            LutEngine(Rule rule, ThreadPool& pool) : rule(rule), pool(pool), worker_stats(pool.size()) {
+                buildTable();
+            }
+
+            const char* name() const override {
+                return "lut";
+            }
+
+            void load(const Board& board) override {
+                copyBoard(board, current, pool);
+                createBoard(board.width, board.height, next);
+                step_stats = boardStats(board);
+            }
+
+            void store(Board& board) const override {
+                board = current;
+            }
+
+            void edit(const std::vector<CellEdit>& edits) override {
+                applyEdits(current, edits, &step_stats);
+            }
+
+            void step(uint64_t generations) override {
+                for (uint64_t g = 0; g < generations; g++) {
+                    GAME_TRACE_SCOPE("lut step");
+                    bool last = g + 1 == generations;
+                    if (last) {
+                        std::fill(worker_stats.begin(), worker_stats.end(), StepStats());
+                    }
+                    pool.parallelFor((current.height + 1) / 2, [this, last](uint64_t begin, uint64_t end, uint32_t worker) {
+                        StepStats* stats = last ? &worker_stats[worker] : nullptr;
+                        for (uint64_t pair = begin; pair < end; pair++) {
+                            stepRowPair(pair * 2, stats);
+                        }
+                    });
+                    std::swap(current, next);
+                }
+                if (generations > 0) {
+                    step_stats = StepStats();
+                    for (auto& s : worker_stats) {
+                        step_stats.merge(s);
+                    }
+                }
+            }
+
+            uint64_t memoryBytes() const override {
+                return (current.words.size() + next.words.size()) * sizeof(uint64_t) + table.size();
+            }
+
+        private:
+            void buildTable() {
+                for (uint32_t index = 0; index < table.size(); index++) {
+                    uint8_t result = 0;
+                    for (uint32_t a = 1; a <= 2; a++) {
+                        for (uint32_t b = 1; b <= 2; b++) {
+                            uint32_t adjacent = 0;
+                            for (uint32_t da = a - 1; da <= a + 1; da++) {
+                                for (uint32_t db = b - 1; db <= b + 1; db++) {
+                                    if ((da != a || db != b) && ((index >> (da * 4 + db)) & 1)) {
+                                        adjacent++;
+                                    }
+                                }
+                            }
+                            bool alive = (index >> (a * 4 + b)) & 1;
+                            uint16_t mask = alive ? rule.survive : rule.birth;
+                            if ((mask >> adjacent) & 1) {
+                                result |= 1 << ((a - 1) * 2 + (b - 1));
+                            }
+                        }
+                    }
+                    table[index] = result;
+                }
+            }
+
+            // Bits 2p .. 2p + 3 of the 66 bit window starting one column
+            // before the word, i.e. columns 2p - 1 .. 2p + 2.
+            static inline uint32_t nibble(uint64_t window_lo, uint64_t window_hi, uint32_t p) {
+                if (p < 31) {
+                    return (window_lo >> (2 * p)) & 0xF;
+                }
+                return ((window_lo >> 62) | (window_hi << 2)) & 0xF;
+            }
+
+            void stepRowPair(uint64_t r, StepStats* stats) {
+                const uint64_t* rows[4];
+                for (uint32_t k = 0; k < 4; k++) {
+                    uint64_t i = r + k - 1;
+                    rows[k] = (r + k >= 1 && i < current.height) ? current.row(i) : nullptr;
+                }
+                uint64_t* out_top = next.row(r);
+                uint64_t* out_bottom = r + 1 < current.height ? next.row(r + 1) : nullptr;
+                uint64_t words = current.words_per_row;
+
+                for (uint64_t w = 0; w < words; w++) {
+                    uint64_t lo[4], hi[4];
+                    for (uint32_t k = 0; k < 4; k++) {
+                        uint64_t prev = rows[k] && w > 0 ? rows[k][w - 1] : 0;
+                        uint64_t cur = rows[k] ? rows[k][w] : 0;
+                        uint64_t nxt = rows[k] && w + 1 < words ? rows[k][w + 1] : 0;
+                        lo[k] = (cur << 1) | (prev >> 63);
+                        hi[k] = (cur >> 63) | (nxt << 1);
+                    }
+                    uint64_t top = 0;
+                    uint64_t bottom = 0;
+                    for (uint32_t p = 0; p < 32; p++) {
+                        uint32_t index =
+                            nibble(lo[0], hi[0], p) |
+                            (nibble(lo[1], hi[1], p) << 4) |
+                            (nibble(lo[2], hi[2], p) << 8) |
+                            (nibble(lo[3], hi[3], p) << 12);
+                        uint64_t block = table[index];
+                        top |= (block & 3) << (2 * p);
+                        bottom |= ((block >> 2) & 3) << (2 * p);
+                    }
+                    if (w + 1 == words) {
+                        top &= current.lastWordMask();
+                        bottom &= current.lastWordMask();
+                    }
+                    out_top[w] = top;
+                    if (out_bottom) {
+                        out_bottom[w] = bottom;
+                    }
+                    if (stats) {
+                        stats->addWord(r, w, rows[1][w], top);
+                        if (out_bottom) {
+                            stats->addWord(r + 1, w, rows[2][w], bottom);
+                        }
+                    }
+                }
+            }
+
+            Rule rule;
+            ThreadPool& pool;
+            std::array<uint8_t, 1 << 16> table;
+            std::vector<StepStats> worker_stats;
+            Board current;
+            Board next;
+        };
+    }
+
+    void createLutEngine(Rule rule, ThreadPool& pool, std::unique_ptr<Engine>& engine) {
+        engine = std::make_unique<LutEngine>(rule, pool);
+    }
+}
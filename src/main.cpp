@@ -1,10 +1,24 @@
 #include "vulkan_methods.hpp"
+#include "options.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+#include "board.hpp"
+#include "engine.hpp"
+#include "thread_pool.hpp"
+#include "simulation.hpp"
+#include "offscreen.hpp"
+#include "frame_pacing.hpp"
+#include "gpu_engine.hpp"
+#include "editing.hpp"
+#include "patterns.hpp"
 
 #include <thread>
-#include <random>
+#include <iostream>
 #include <algorithm>
+#include <stdexcept>
 
 #define MAX_FRAMES_IN_FLIGHT 2
+#define ACQUIRE_TIMEOUT_NS 100000000ull
 
 std::array<game::Vertex, 6> vertices = {
     game::Vertex { 0, 0 },
@@ -17,13 +31,58 @@ std::array<game::Vertex, 6> vertices = {
 
 struct GameData {
     game::Camera* camera;
-    uint32_t grid_size;
+    uint64_t grid_size;
+    game::GenerationPacer* pacer;
+    // Recorded generations to go back before the next frame, UINT32_MAX
+    // rewinds to the oldest one.
+    uint32_t back_steps;
+    // Something visible changed since the last frame was drawn.
+    bool dirty;
+    const game::Board* board;
+    game::EditBatch* edits;
+    game::Pattern* stamp;
+    size_t stamp_index;
+    // Value painted while dragging, -1 when no button is held.
+    int painting;
+    int64_t last_row;
+    int64_t last_column;
 };
 
+void cursorCell(GLFWwindow* window, GameData* data, int64_t& row, int64_t& column) {
+    double x, y;
+    int width, height;
+    glfwGetCursorPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    game::unprojectCursor(*data->camera, data->grid_size, width, height, x, y, row, column);
+}
+
 void keyCallback(GLFWwindow * window, int key, int scancode, int action, int mods) {
     GameData* data = static_cast<GameData*>(glfwGetWindowUserPointer(window));
+    data->dirty = true;
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, GLFW_TRUE);
+    } else if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
+        data->pacer->togglePause();
+    } else if (key == GLFW_KEY_N && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+        data->pacer->singleStep();
+    } else if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        std::vector<std::string> names = game::builtinPatternNames();
+        data->stamp_index = (data->stamp_index + 1) % names.size();
+        game::builtinPattern(names[data->stamp_index], *data->stamp);
+        std::cerr << "stamp " << names[data->stamp_index] << std::endl;
+    } else if (key == GLFW_KEY_B && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+        data->back_steps = (mods & GLFW_MOD_SHIFT) ? UINT32_MAX : data->back_steps + 1;
+    } else if ((key == GLFW_KEY_EQUAL || key == GLFW_KEY_MINUS) && action == GLFW_PRESS) {
+        if (key == GLFW_KEY_EQUAL) {
+            data->pacer->faster();
+        } else {
+            data->pacer->slower();
+        }
+        if (data->pacer->rate() > 0.) {
+            std::cerr << data->pacer->rate() << " generations/s" << std::endl;
+        } else {
+            std::cerr << data->pacer->perFrame() << " generations/frame" << std::endl;
+        }
     } else if (key == GLFW_KEY_LEFT && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
         data->camera->x -= 5.f;
     } else if (key == GLFW_KEY_RIGHT && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
@@ -45,21 +104,71 @@ void keyCallback(GLFWwindow * window, int key, int scancode, int action, int mod
 	data->camera->zoom = std::max(0.25f, data->camera->zoom);
 }
 
+void refreshCallback(GLFWwindow* window) {
+    static_cast<GameData*>(glfwGetWindowUserPointer(window))->dirty = true;
+}
+
+// Left click toggles a cell and dragging paints the toggled value, right
+// drag erases, middle or shift click stamps the current pattern.
+void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+    GameData* data = static_cast<GameData*>(glfwGetWindowUserPointer(window));
+    data->dirty = true;
+    if (action == GLFW_RELEASE) {
+        data->painting = -1;
+        return;
+    }
+    int64_t row, column;
+    cursorCell(window, data, row, column);
+    if (button == GLFW_MOUSE_BUTTON_MIDDLE || (button == GLFW_MOUSE_BUTTON_LEFT && (mods & GLFW_MOD_SHIFT))) {
+        data->edits->stamp(*data->stamp, row, column);
+        return;
+    }
+    if (row < 0 || column < 0 || uint64_t(row) >= data->board->height || uint64_t(column) >= data->board->width) {
+        return;
+    }
+    if (button == GLFW_MOUSE_BUTTON_LEFT) {
+        data->painting = data->edits->toggle(*data->board, row, column) ? 1 : 0;
+    } else if (button == GLFW_MOUSE_BUTTON_RIGHT) {
+        data->painting = 0;
+        data->edits->set(row, column, false);
+    }
+    data->last_row = row;
+    data->last_column = column;
+}
+
+void cursorPosCallback(GLFWwindow* window, double, double) {
+    GameData* data = static_cast<GameData*>(glfwGetWindowUserPointer(window));
+    if (data->painting < 0) {
+        return;
+    }
+    int64_t row, column;
+    cursorCell(window, data, row, column);
+    if (row == data->last_row && column == data->last_column) {
+        return;
+    }
+    data->edits->line(data->last_row, data->last_column, row, column, data->painting == 1);
+    data->last_row = row;
+    data->last_column = column;
+    data->dirty = true;
+}
+
 void rebuildSwapchain(
     vk::PhysicalDevice physical_device,
     vk::Device device,
     vk::SurfaceKHR surface,
     vk::DispatchLoaderDynamic dispatcher,
-    uint32_t grid_size,
+    uint64_t grid_size,
     vk::Extent2D window_extent,
+    vk::PresentModeKHR present_mode,
     game::Queue graphics_queue,
     game::Queue present_queue,
     game::Queue compute_queue,
     vk::DeviceMemory device_memory,
     vk::DescriptorSetLayout descriptor_set_layout,
     vk::CommandPool graphics_command_pool,
-    game::Buffer game_buffer,
+    const std::vector<game::CellChunk>& cell_chunks,
     game::Buffer vertex_buffer,
+    game::CellCompaction& compaction,
 
     vk::SwapchainKHR& swapchain,
     vk::SurfaceFormatKHR surface_format,
@@ -74,6 +183,7 @@ void rebuildSwapchain(
     std::vector<vk::Framebuffer>& framebuffers,
     std::vector<vk::CommandBuffer>& command_buffers
 ) {
+    GAME_TRACE_SCOPE("rebuildSwapchain");
     vkDeviceWaitIdle(device);
 
     device.freeCommandBuffers(graphics_command_pool, command_buffers);
@@ -99,6 +209,7 @@ void rebuildSwapchain(
         window_extent,
         dispatcher,
         { graphics_queue.index.value(), present_queue.index.value() },
+        present_mode,
         surface_format,
         swapchain
     );
@@ -130,9 +241,13 @@ void rebuildSwapchain(
             camera_buffers[i].offset
         );
     }
+    if (!compaction.chunks.empty()) {
+        game::updateCellCompactionSets(device, cell_chunks, camera_buffers, compaction);
+    }
     game::createRenderpass(
         device,
         surface_format.format,
+        vk::ImageLayout::ePresentSrcKHR,
         graphics_render_pass
     );
     std::vector<vk::VertexInputAttributeDescription> vertex_attributes;
@@ -144,7 +259,7 @@ void rebuildSwapchain(
     }
     game::createGraphicsPipeline(
         device,
-        grid_size,
+        static_cast<uint32_t>(grid_size),
         window_extent,
         { descriptor_set_layout },
         { game::Vertex::getBindingDescription(), game::Cell::getBindingDescription() },
@@ -179,25 +294,37 @@ void rebuildSwapchain(
         graphics_pipeline,
         graphics_pipeline_layout,
         vertex_buffer,
-        game_buffer,
+        cell_chunks,
         grid_size,
         uniform_sets,
+        compaction,
         command_buffers
     );
 }
 
-int main(int argc, char** argv) {
+int run(int argc, char** argv) {
+    game::Options options;
+    game::parseOptions(argc, argv, options);
+    game::setHugePages(game::parseHugePages(options.huge_pages));
+    if (!options.trace_path.empty()) {
+        game::trace::enable(options.trace_path);
+    }
+    std::unique_ptr<game::MetricsServer> metrics_server;
+    if (options.metrics_port != 0) {
+        metrics_server = std::make_unique<game::MetricsServer>(options.metrics_port);
+    }
+    if (options.offscreen) {
+        return game::runOffscreen(options);
+    }
+
     glfwInit();
 
-    uint32_t grid_size = 1000;
-    if (argc == 2) {
-        grid_size = std::atoll(argv[1]);
-    }
+    uint64_t grid_size = options.grid_size;
 
     vk::Instance instance;
     vk::DispatchLoaderDynamic dispatcher;
     vk::DebugUtilsMessengerEXT debug_utils;
-    game::createInstance(instance, dispatcher, debug_utils);
+    game::createInstance(instance, dispatcher, debug_utils, false);
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     GLFWwindow* window = glfwCreateWindow(800, 600, "Game of Life", nullptr, nullptr);
@@ -217,6 +344,7 @@ int main(int argc, char** argv) {
         10.
     };
 
+    vk::PresentModeKHR present_mode = game::choosePresentMode(physical_device, surface, dispatcher, options.present_mode);
     vk::SwapchainKHR swapchain;
     vk::SurfaceFormatKHR surface_format;
     game::createSwapchain(
@@ -226,6 +354,7 @@ int main(int argc, char** argv) {
         vk::Extent2D { static_cast<uint32_t>(window_width), static_cast<uint32_t>(window_height) },
         dispatcher,
         { graphics_queue.index.value(), present_queue.index.value() },
+        present_mode,
         surface_format,
         swapchain
     );
@@ -277,16 +406,16 @@ int main(int argc, char** argv) {
         compute_command_pool
     );
 
-    game::Buffer game_buffer;
+    std::vector<game::CellChunk> cell_chunks;
+    game::createCellChunks(
+        device,
+        physical_device,
+        grid_size,
+        { graphics_queue.index.value(), compute_queue.index.value() },
+        cell_chunks
+    );
     game::Buffer vertex_buffer;
     std::vector<game::Buffer> camera_buffers(swapchain_images.size());
-	game::createBuffer(
-		device,
-		grid_size * grid_size * sizeof(game::Cell),
-		{ graphics_queue.index.value(), compute_queue.index.value() },
-		vk::BufferUsageFlagBits::eVertexBuffer,
-		game_buffer.buffer
-	);
     game::createBuffer(
         device,
         vertices.size() * sizeof(game::Vertex),
@@ -305,8 +434,6 @@ int main(int argc, char** argv) {
     }
 
     vk::DeviceSize memory_req = 0;
-    game_buffer.mem_reqs = device.getBufferMemoryRequirements(game_buffer.buffer);
-    memory_req += game_buffer.mem_reqs.size + game_buffer.mem_reqs.alignment;
     vertex_buffer.mem_reqs = device.getBufferMemoryRequirements(vertex_buffer.buffer);
     memory_req += vertex_buffer.mem_reqs.size + vertex_buffer.mem_reqs.alignment;
     for (uint32_t i = 0; i < camera_buffers.size(); i++) {
@@ -317,43 +444,24 @@ int main(int argc, char** argv) {
     vk::DeviceMemory device_memory;
     uint32_t device_memory_type_index;
     game::createDeviceMemory(device, physical_device, memory_req, device_memory_type_index, device_memory);
-    assert(bool(game_buffer.mem_reqs.memoryTypeBits & (1 << device_memory_type_index)));
     assert(bool(vertex_buffer.mem_reqs.memoryTypeBits & (1 << device_memory_type_index)));
     for (auto cbr : camera_buffers) {
         assert(bool(cbr.mem_reqs.memoryTypeBits & (1 << device_memory_type_index)));
     }
 
     vk::DeviceSize memory_offset = 0;
-	if (memory_offset % game_buffer.mem_reqs.alignment) {
-		memory_offset += (game_buffer.mem_reqs.alignment - (memory_offset % game_buffer.mem_reqs.alignment));
-	}
-	device.bindBufferMemory(
-		game_buffer.buffer,
-		device_memory,
-		memory_offset
-	);
-	game_buffer.offset = memory_offset;
-	memory_offset += game_buffer.mem_reqs.size;
-    {
-		game::Cell* mapped_memory = static_cast<game::Cell*>(device.mapMemory(device_memory, 0, game_buffer.mem_reqs.size));
-		for (uint32_t i = 0; i < grid_size; i++) {
-			for (uint32_t j = 0; j < grid_size; j++) {
-				mapped_memory[i * grid_size + j].x = i;
-				mapped_memory[i * grid_size + j].y = j;
-				mapped_memory[i * grid_size + j].alive = 0;
-			}
-		}
-        std::random_device rd;
-        std::mt19937 generator(rd());
-        std::bernoulli_distribution bernoulli(0.5);
-        uint32_t fith = grid_size/5;
-        for (uint32_t i = 0; i < fith; i++) {
-            for (uint32_t j = 0; j < fith; j++) {
-                mapped_memory[(((grid_size/2) - (fith /2) + i) * grid_size) + ((grid_size/2) - (fith /2) + j)].alive = bernoulli(generator);
-            }
-        }
-        device.unmapMemory(device_memory);
+    game::ThreadPool pool(options.threads, options.pin_threads);
+    game::GpuStepper gpu_stepper;
+    std::unique_ptr<game::Engine> gpu_engine;
+    if (game::isGpuEngine(options.engine)) {
+        game::Rule rule;
+        game::parseRule(options.rule, rule);
+        game::createGpuStepper(device, physical_device, compute_queue, options.engine, gpu_stepper);
+        game::createGpuEngine(gpu_stepper, rule, gpu_engine);
     }
+    game::Simulation simulation(options, pool, std::move(gpu_engine));
+    game::StepStats shown_cells;
+    game::uploadCells(device, grid_size, simulation.board(), simulation.stepStats(), true, cell_chunks, shown_cells);
 
     if (memory_offset % vertex_buffer.mem_reqs.alignment) {
         memory_offset += (vertex_buffer.mem_reqs.alignment - (memory_offset % vertex_buffer.mem_reqs.alignment));
@@ -393,6 +501,7 @@ int main(int argc, char** argv) {
     game::createRenderpass(
         device,
         surface_format.format,
+        vk::ImageLayout::ePresentSrcKHR,
         graphics_render_pass
     );
 
@@ -407,7 +516,7 @@ int main(int argc, char** argv) {
     vk::PipelineLayout graphics_pipeline_layout;
     game::createGraphicsPipeline(
         device,
-        grid_size,
+        static_cast<uint32_t>(grid_size),
         vk::Extent2D { static_cast<uint32_t>(window_width), static_cast<uint32_t>(window_height) },
         { descriptor_set_layout },
         { game::Vertex::getBindingDescription(), game::Cell::getBindingDescription() },
@@ -437,6 +546,19 @@ int main(int argc, char** argv) {
         );
     }
 
+    game::CellCompaction compaction;
+    if (options.compact_cells) {
+        game::createCellCompaction(
+            device,
+            physical_device,
+            grid_size,
+            cell_chunks,
+            camera_buffers,
+            { graphics_queue.index.value(), compute_queue.index.value() },
+            compaction
+        );
+    }
+
     std::vector<vk::CommandBuffer> command_buffers;
     game::createCommandBuffers(
         device,
@@ -448,29 +570,82 @@ int main(int argc, char** argv) {
         graphics_pipeline,
         graphics_pipeline_layout,
         vertex_buffer,
-        game_buffer,
+        cell_chunks,
         grid_size,
         uniform_sets,
+        compaction,
         command_buffers
     );
 
+    game::GenerationPacer pacer(options.generations_per_frame, options.generation_rate);
+    game::EditBatch edits;
+    game::Pattern stamp;
+    std::vector<std::string> pattern_names = game::builtinPatternNames();
+    size_t stamp_index = std::find(pattern_names.begin(), pattern_names.end(), options.stamp) - pattern_names.begin();
+    if (stamp_index < pattern_names.size()) {
+        game::builtinPattern(options.stamp, stamp);
+    } else {
+        game::loadPattern(options.stamp, stamp);
+        stamp_index = pattern_names.size() - 1;
+    }
     GameData* game_data = new GameData {
         &camera,
-        grid_size
+        grid_size,
+        &pacer,
+        0,
+        true,
+        &simulation.board(),
+        &edits,
+        &stamp,
+        stamp_index,
+        -1,
+        0,
+        0
     };
     glfwSetWindowUserPointer(window, game_data);
     glfwSetKeyCallback(window, keyCallback);
+    glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    glfwSetCursorPosCallback(window, cursorPosCallback);
+    glfwSetWindowRefreshCallback(window, refreshCallback);
     glfwShowWindow(window);
 
+    game::FrameLimiter limiter(options.max_fps);
     bool running = true;
     uint32_t current_frame = 0;
     while (running) {
+        // Nothing moves while paused with a still camera, so sleep in the
+        // event queue instead of redrawing the same frame.
+        if (pacer.idle() && !game_data->dirty) {
+            GAME_TRACE_SCOPE("waitEvents");
+            glfwWaitEvents();
+            limiter.reset();
+            running = !glfwWindowShouldClose(window);
+            continue;
+        }
+        limiter.wait();
+
+        GAME_TRACE_SCOPE("frame");
+        uint64_t frame_begin_ns = game::trace::now();
         glfwPollEvents();
+        game_data->dirty = false;
 
         // ###
-        device.waitForFences({ frame_in_flight[current_frame] }, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        {
+            GAME_TRACE_SCOPE("waitForFences");
+            device.waitForFences({ frame_in_flight[current_frame] }, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        }
 
-        vk::ResultValue<uint32_t> result = device.acquireNextImageKHR(swapchain, std::numeric_limits<uint64_t>::max(), image_available[current_frame], vk::Fence());
+        vk::ResultValue<uint32_t> result = vk::ResultValue<uint32_t>(vk::Result::eSuccess, 0);
+        {
+            GAME_TRACE_SCOPE("acquireNextImageKHR");
+            result = device.acquireNextImageKHR(swapchain, ACQUIRE_TIMEOUT_NS, image_available[current_frame], vk::Fence());
+        }
+        if (result.result == vk::Result::eTimeout || result.result == vk::Result::eNotReady) {
+            // Go back to handling input rather than stalling in the driver.
+            game_data->dirty = true;
+            running = !glfwWindowShouldClose(window);
+            continue;
+        }
 
         bool rebuild_swapchain = false;
         if (result.result == vk::Result::eErrorOutOfDateKHR) {
@@ -487,14 +662,16 @@ int main(int argc, char** argv) {
                 dispatcher,
                 grid_size,
                 vk::Extent2D { static_cast<uint32_t>(window_width), static_cast<uint32_t>(window_height) },
+                present_mode,
                 graphics_queue,
                 present_queue,
                 compute_queue,
                 device_memory,
                 descriptor_set_layout,
                 graphics_command_pool,
-                game_buffer,
+                cell_chunks,
                 vertex_buffer,
+                compaction,
                 swapchain,
                 surface_format,
                 swapchain_images,
@@ -514,6 +691,7 @@ int main(int argc, char** argv) {
 
         uint32_t image_index = result.value;
 		{
+			GAME_TRACE_SCOPE("mapMemory camera");
 			game::Camera* mapped_memory = static_cast<game::Camera*>(device.mapMemory(
 				device_memory,
 				camera_buffers[image_index].offset,
@@ -522,39 +700,46 @@ int main(int argc, char** argv) {
 			*mapped_memory = camera;
 			device.unmapMemory(device_memory);
 		}
-		{
-			game::Cell* temp_cells = new game::Cell[grid_size * grid_size];
-			game::Cell* mapped_memory = static_cast<game::Cell*>(device.mapMemory(
-				device_memory,
-				game_buffer.offset,
-				game_buffer.mem_reqs.size
-			));
-			std::memcpy(temp_cells, mapped_memory, grid_size * grid_size * sizeof(game::Cell));
-			for (uint32_t i = 0; i < grid_size; i++) {
-				for (uint32_t j = 0; j < grid_size; j++) {
-					uint32_t adjacent = 0;
-					adjacent += ((i != 0) && temp_cells[(i - 1) * grid_size + j].alive);
-					adjacent += ((i != grid_size - 1) && temp_cells[(i + 1) * grid_size + j].alive);
-					adjacent += ((j != 0) && temp_cells[i * grid_size + (j - 1)].alive);
-					adjacent += ((j != grid_size - 1) && temp_cells[i * grid_size + (j + 1)].alive);
-					adjacent += ((i != 0) && (j != 0) && temp_cells[(i - 1) * grid_size + (j - 1)].alive);
-					adjacent += ((i != grid_size - 1) && (j != 0) && temp_cells[(i + 1) * grid_size + (j - 1)].alive);
-					adjacent += ((i != 0) && (j != grid_size - 1) && temp_cells[(i - 1) * grid_size + (j + 1)].alive);
-					adjacent += ((i != grid_size - 1) && (j != grid_size - 1) && temp_cells[(i + 1) * grid_size + (j + 1)].alive);
-
-					if (temp_cells[i * grid_size + j].alive) {
-						if (adjacent < 2 || adjacent > 3) {
-							mapped_memory[i * grid_size + j].alive = 0;
-						}
-					} else {
-						if (adjacent == 3) {
-							mapped_memory[i * grid_size + j].alive = 1;
-						}
-					}
-				}
+		bool board_changed = false;
+		if (game_data->back_steps > 0) {
+			GAME_TRACE_SCOPE("rewind");
+			if (!pacer.paused()) {
+				pacer.togglePause();
 			}
-			device.unmapMemory(device_memory);
-			delete[] temp_cells;
+			if (game_data->back_steps == UINT32_MAX && options.history_mb != 0) {
+				simulation.rewind(0);
+			} else {
+				for (uint32_t b = 0; b < game_data->back_steps && simulation.stepBack(); b++) {}
+			}
+			game_data->back_steps = 0;
+			std::cerr << "generation " << simulation.generation() << std::endl;
+			board_changed = true;
+		}
+		// Edits land on the generation that is on screen, before it is
+		// stepped, and reach the GPU with the regular changed-rows upload.
+		if (!edits.empty()) {
+			GAME_TRACE_SCOPE("edit");
+			std::vector<game::CellEdit> batch;
+			edits.take(batch);
+			simulation.edit(batch);
+			board_changed = true;
+		}
+		uint64_t generations = pacer.generationsForFrame();
+		if (generations > 0) {
+			GAME_TRACE_SCOPE("step");
+			simulation.step(generations);
+			board_changed = true;
+		}
+		if (board_changed) {
+			// The cell chunks are shared by all frames, so the other frame
+			// in flight has to finish drawing them before they change. The
+			// step above still overlaps with it.
+			{
+				GAME_TRACE_SCOPE("waitForFences upload");
+				device.waitForFences(frame_in_flight, VK_TRUE, std::numeric_limits<uint64_t>::max());
+			}
+			GAME_TRACE_SCOPE("upload cells");
+			game::uploadCells(device, grid_size, simulation.board(), simulation.stepStats(), false, cell_chunks, shown_cells);
 		}
 
         std::vector<vk::Semaphore> wait_semaphores = { image_available[current_frame] };
@@ -572,7 +757,10 @@ int main(int argc, char** argv) {
             .setPSignalSemaphores(signal_semaphores.data());
 
         device.resetFences({ frame_in_flight[current_frame] });
-        graphics_queue.queue.submit({ submit_info }, frame_in_flight[current_frame]);
+        {
+            GAME_TRACE_SCOPE("submit");
+            graphics_queue.queue.submit({ submit_info }, frame_in_flight[current_frame]);
+        }
 
         std::vector<vk::SwapchainKHR> swapchains = { swapchain };
         vk::PresentInfoKHR present_info = vk::PresentInfoKHR()
@@ -581,7 +769,11 @@ int main(int argc, char** argv) {
             .setWaitSemaphoreCount(signal_semaphores.size())
             .setPWaitSemaphores(signal_semaphores.data())
             .setPImageIndices(&image_index);
-        vk::Result present_result = present_queue.queue.presentKHR(present_info);
+        vk::Result present_result;
+        {
+            GAME_TRACE_SCOPE("presentKHR");
+            present_result = present_queue.queue.presentKHR(present_info);
+        }
         if (present_result == vk::Result::eErrorOutOfDateKHR || present_result == vk::Result::eSuboptimalKHR) {
             window_width = 0;
             window_height = 0;
@@ -596,14 +788,16 @@ int main(int argc, char** argv) {
                 dispatcher,
                 grid_size,
                 vk::Extent2D { static_cast<uint32_t>(window_width), static_cast<uint32_t>(window_height) },
+                present_mode,
                 graphics_queue,
                 present_queue,
                 compute_queue,
                 device_memory,
                 descriptor_set_layout,
                 graphics_command_pool,
-                game_buffer,
+                cell_chunks,
                 vertex_buffer,
+                compaction,
                 swapchain,
                 surface_format,
                 swapchain_images,
@@ -622,6 +816,7 @@ int main(int argc, char** argv) {
         }
 
         current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+        game::metrics::recordFrame(game::trace::now() - frame_begin_ns);
 
         if (glfwWindowShouldClose(window)) {
             running = false;
@@ -643,7 +838,14 @@ int main(int argc, char** argv) {
         device.destroyBuffer(b.buffer);
     }
     device.destroyBuffer(vertex_buffer.buffer);
-    device.destroyBuffer(game_buffer.buffer);
+    if (!compaction.chunks.empty()) {
+        game::destroyCellCompaction(device, compaction);
+    }
+    game::destroyCellChunks(device, cell_chunks);
+    simulation.printStats(std::cerr);
+    if (game::isGpuEngine(options.engine)) {
+        game::destroyGpuStepper(device, gpu_stepper);
+    }
     device.freeMemory(device_memory);
     if (compute_queue != graphics_queue) {
         device.destroyCommandPool(compute_command_pool);
@@ -671,4 +873,18 @@ int main(int argc, char** argv) {
     glfwTerminate();
 
     return 0;
+}
+
+int main(int argc, char** argv) {
+    try {
+        int result = run(argc, argv);
+        // Only now are the threads that record events (the pool, the diff
+        // stream writer, the metrics server) joined, so the rings hold
+        // still while they are written out.
+        game::trace::dump();
+        return result;
+    } catch (std::exception& e) {
+        std::cerr << "game: " << e.what() << std::endl;
+        return 1;
+    }
 }
\ No newline at end of file
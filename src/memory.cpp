@@ -0,0 +1,119 @@
+#include "memory.hpp"
+#include "metrics.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace game {
+    namespace {
+        const size_t HUGE_PAGE_BYTES = size_t(2) << 20;
+
+        std::atomic<HugePages> g_huge_pages { HugePages::Transparent };
+
+        size_t roundUp(size_t bytes) {
+            return (bytes + HUGE_PAGE_BYTES - 1) / HUGE_PAGE_BYTES * HUGE_PAGE_BYTES;
+        }
+
+#ifdef __linux__
+        // Over-maps by one huge page and trims both ends so the block starts
+        // on a 2 MB boundary, which transparent huge pages need.
+        void* mapAligned(size_t bytes) {
+            size_t span = bytes + HUGE_PAGE_BYTES;
+            void* raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+            uintptr_t aligned = (begin + HUGE_PAGE_BYTES - 1) / HUGE_PAGE_BYTES * HUGE_PAGE_BYTES;
+            if (aligned > begin) {
+                munmap(raw, aligned - begin);
+            }
+            size_t tail = begin + span - (aligned + bytes);
+            if (tail > 0) {
+                munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+            }
+            return reinterpret_cast<void*>(aligned);
+        }
+#endif
+    }
+
+    void setHugePages(HugePages policy) {
+        g_huge_pages.store(policy, std::memory_order_relaxed);
+    }
+
+    HugePages hugePages() {
+        return g_huge_pages.load(std::memory_order_relaxed);
+    }
+
+    HugePages parseHugePages(std::string text) {
+        if (text == "off") {
+            return HugePages::Off;
+        } else if (text == "thp") {
+            return HugePages::Transparent;
+        } else if (text == "explicit") {
+            return HugePages::Explicit;
+        }
+        throw std::runtime_error("huge pages must be off, thp or explicit");
+    }
+
+    // Blocks smaller than a huge page are not worth a mapping of their own.
+    void* allocatePages(size_t bytes) {
+        if (bytes < HUGE_PAGE_BYTES) {
+            void* pointer = std::calloc(bytes == 0 ? 1 : bytes, 1);
+            if (pointer == nullptr) {
+                throw std::bad_alloc();
+            }
+            metrics::add(metrics::g_counters.heap_bytes, bytes);
+            return pointer;
+        }
+#ifdef __linux__
+        size_t rounded = roundUp(bytes);
+        HugePages policy = hugePages();
+        if (policy == HugePages::Explicit) {
+            void* pointer = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (pointer != MAP_FAILED) {
+                metrics::add(metrics::g_counters.page_bytes, rounded);
+                return pointer;
+            }
+        }
+        void* pointer = mapAligned(rounded);
+        if (policy != HugePages::Off) {
+            madvise(pointer, rounded, MADV_HUGEPAGE);
+        }
+        metrics::add(metrics::g_counters.page_bytes, rounded);
+        return pointer;
+#else
+        void* pointer = std::calloc(bytes, 1);
+        if (pointer == nullptr) {
+            throw std::bad_alloc();
+        }
+        metrics::add(metrics::g_counters.page_bytes, bytes);
+        return pointer;
+#endif
+    }
+
+    void freePages(void* pointer, size_t bytes) {
+        if (pointer == nullptr) {
+            return;
+        }
+#ifdef __linux__
+        if (bytes >= HUGE_PAGE_BYTES) {
+            metrics::g_counters.page_bytes.fetch_sub(roundUp(bytes), std::memory_order_relaxed);
+            munmap(pointer, roundUp(bytes));
+            return;
+        }
+#endif
+        if (bytes >= HUGE_PAGE_BYTES) {
+            metrics::g_counters.page_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        } else {
+            metrics::g_counters.heap_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        }
+        std::free(pointer);
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef __MEMORY__HPP__
+#define __MEMORY__HPP__
+
+#include <new>
+#include <cassert>
+#include <utility>
+#include <string>
+#include <cstddef>
+
+namespace game {
+    // How large page allocations are backed. Transparent asks the kernel to
+    // promote them to 2 MB pages, Explicit takes pages from the reserved
+    // hugetlb pool and falls back to Transparent when it is empty.
+    enum class HugePages {
+        Off,
+        Transparent,
+        Explicit
+    };
+
+    void setHugePages(HugePages policy);
+    HugePages hugePages();
+    HugePages parseHugePages(std::string text);
+
+    // Returns zeroed memory. Large blocks come straight from the kernel and
+    // are not touched here, so each page is placed on the NUMA node of the
+    // thread that first writes it.
+    void* allocatePages(size_t bytes);
+    void freePages(void* pointer, size_t bytes);
+
+    inline bool isZeroed(const void* pointer, size_t bytes) {
+        const unsigned char* begin = static_cast<const unsigned char*>(pointer);
+        for (size_t i = 0; i < bytes; i++) {
+            if (begin[i] != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Allocator for board storage. Default construction leaves elements as
+    // the (already zero) memory has them, so resizing a vector does not
+    // fault its pages in on the resizing thread. That is only right for
+    // memory allocate() just returned: a vector shrunk and grown again in
+    // place would show its old values. Board storage therefore only grows
+    // from empty into a new allocation, see createBoard, and debug builds
+    // check that every element default constructed is still zero.
+    template <class T>
+    struct PageAllocator {
+        using value_type = T;
+
+        PageAllocator() = default;
+
+        template <class U>
+        PageAllocator(const PageAllocator<U>&) {}
+
+        T* allocate(size_t count) {
+            if (count > size_t(-1) / sizeof(T)) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(allocatePages(count * sizeof(T)));
+        }
+
+        void deallocate(T* pointer, size_t count) {
+            freePages(pointer, count * sizeof(T));
+        }
+
+        template <class U>
+        void construct(U* pointer) {
+            assert(isZeroed(pointer, sizeof(U)));
+            ::new (static_cast<void*>(pointer)) U;
+        }
+
+        template <class U, class... Args>
+        void construct(U* pointer, Args&&... args) {
+            ::new (static_cast<void*>(pointer)) U(std::forward<Args>(args)...);
+        }
+
+        template <class U>
+        bool operator==(const PageAllocator<U>&) const {
+            return true;
+        }
+
+        template <class U>
+        bool operator!=(const PageAllocator<U>&) const {
+            return false;
+        }
+    };
+}
+
+#endif // __MEMORY__HPP__
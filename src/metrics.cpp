@@ -0,0 +1,272 @@
+#include "metrics.hpp"
+#include "board.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+namespace game {
+    namespace metrics {
+        Counters g_counters;
+
+        uint32_t frameBucket(uint64_t ns) {
+            uint64_t us = ns / 1000;
+            if (us < 4) {
+                return uint32_t(us);
+            }
+            uint32_t octave = 63 - countLeadingZeros64(us);
+            uint32_t bucket = 4 * (octave - 1) + uint32_t((us >> (octave - 2)) & 3);
+            return std::min(bucket, FRAME_BUCKETS - 1);
+        }
+
+        double frameBucketBound(uint32_t bucket) {
+            if (bucket < 4) {
+                return (bucket + 1) * 1e-6;
+            }
+            uint32_t octave = bucket / 4 + 1;
+            return double(uint64_t(5 + bucket % 4) << (octave - 2)) * 1e-6;
+        }
+    }
+
+    namespace {
+        uint64_t nowNs() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()
+            ).count();
+        }
+
+        uint64_t load(const std::atomic<uint64_t>& value) {
+            return value.load(std::memory_order_relaxed);
+        }
+
+        void family(std::ostream& os, const char* name, const char* type, const char* help) {
+            os << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+        }
+
+        // Counts go out as exact integers; doubles only for rates and
+        // seconds.
+        void sample(std::ostream& os, const char* name, uint64_t value) {
+            os << name << " " << value << "\n";
+        }
+
+        void sample(std::ostream& os, const char* name, double value) {
+            os << name << " " << value << "\n";
+        }
+    }
+
+    void MetricsServer::takeSnapshot(uint64_t now) {
+        using metrics::g_counters;
+        Snapshot& snapshot = snapshots[snapshots_taken++ % snapshots.size()];
+        snapshot.ns = now;
+        snapshot.generations = load(g_counters.generations);
+        snapshot.cell_updates = load(g_counters.cell_updates);
+        for (uint32_t b = 0; b < metrics::FRAME_BUCKETS; b++) {
+            snapshot.frames[b] = load(g_counters.frames[b]);
+        }
+    }
+
+    void MetricsServer::render(std::ostream& os) const {
+        using metrics::g_counters;
+        const Snapshot& window = snapshots[snapshots_taken <= snapshots.size() ? 0 : snapshots_taken % snapshots.size()];
+        uint64_t now = nowNs();
+        double seconds = (now - window.ns) * 1e-9;
+        uint64_t generations = load(g_counters.generations);
+        uint64_t cell_updates = load(g_counters.cell_updates);
+
+        std::array<uint64_t, metrics::FRAME_BUCKETS> frames;
+        uint64_t frame_count = 0;
+        uint64_t recent_count = 0;
+        for (uint32_t b = 0; b < metrics::FRAME_BUCKETS; b++) {
+            frames[b] = load(g_counters.frames[b]);
+            frame_count += frames[b];
+            recent_count += frames[b] - window.frames[b];
+        }
+
+        os.precision(9);
+        family(os, "game_generations_total", "counter", "Generations advanced, including fast-forwarded ones.");
+        sample(os, "game_generations_total", generations);
+        family(os, "game_generations_per_second", "gauge", "Generations advanced per second over the last 10 seconds.");
+        sample(os, "game_generations_per_second", seconds > 0 ? (generations - window.generations) / seconds : 0.);
+        family(os, "game_cell_updates_total", "counter", "Cells computed by the engine.");
+        sample(os, "game_cell_updates_total", cell_updates);
+        family(os, "game_cell_updates_per_second", "gauge", "Cells computed per second over the last 10 seconds.");
+        sample(os, "game_cell_updates_per_second", seconds > 0 ? (cell_updates - window.cell_updates) / seconds : 0.);
+        family(os, "game_generation", "gauge", "Generation currently shown.");
+        sample(os, "game_generation", load(g_counters.generation));
+        family(os, "game_population", "gauge", "Live cells in the current generation.");
+        sample(os, "game_population", load(g_counters.population));
+        if (load(g_counters.tiles) != 0) {
+            family(os, "game_tiles", "gauge", "Tiles watched by the period detector.");
+            sample(os, "game_tiles", load(g_counters.tiles));
+            family(os, "game_active_tiles", "gauge", "Tiles the period detector has not seen settle.");
+            sample(os, "game_active_tiles", load(g_counters.active_tiles));
+        }
+
+        family(os, "game_frame_seconds", "summary", "Time to produce a frame; quantiles over the last 10 seconds.");
+        const double quantiles[] = { 0.5, 0.9, 0.99 };
+        for (double q : quantiles) {
+            double value = NAN;
+            if (recent_count != 0) {
+                uint64_t rank = uint64_t(std::ceil(q * recent_count));
+                uint64_t seen = 0;
+                for (uint32_t b = 0; b < metrics::FRAME_BUCKETS; b++) {
+                    seen += frames[b] - window.frames[b];
+                    if (seen >= rank) {
+                        value = metrics::frameBucketBound(b);
+                        break;
+                    }
+                }
+            }
+            os << "game_frame_seconds{quantile=\"" << q << "\"} " << value << "\n";
+        }
+        sample(os, "game_frame_seconds_sum", load(g_counters.frame_ns) * 1e-9);
+        sample(os, "game_frame_seconds_count", frame_count);
+
+        family(os, "game_gpu_seconds_total", "counter", "Time from submitting GPU steps until their fence signalled.");
+        sample(os, "game_gpu_seconds_total", load(g_counters.gpu_ns) * 1e-9);
+        family(os, "game_gpu_submits_total", "counter", "GPU step submissions.");
+        sample(os, "game_gpu_submits_total", load(g_counters.gpu_submits));
+
+        family(os, "game_allocated_bytes", "gauge", "Live bytes per allocation pool.");
+        os << "game_allocated_bytes{pool=\"pages\"} " << load(g_counters.page_bytes) << "\n";
+        os << "game_allocated_bytes{pool=\"heap\"} " << load(g_counters.heap_bytes) << "\n";
+        family(os, "game_memory_bytes", "gauge", "Bytes held per owner.");
+        os << "game_memory_bytes{owner=\"engine\"} " << load(g_counters.engine_bytes) << "\n";
+        os << "game_memory_bytes{owner=\"history\"} " << load(g_counters.history_bytes) << "\n";
+    }
+
+#ifdef _WIN32
+    MetricsServer::MetricsServer(uint16_t) {
+        throw std::runtime_error("the metrics endpoint needs POSIX sockets");
+    }
+
+    MetricsServer::~MetricsServer() {}
+
+    void MetricsServer::serveLoop() {}
+
+    void MetricsServer::respond(int) {}
+#else
+    namespace {
+        std::string systemError(std::string what) {
+            return what + ": " + std::strerror(errno);
+        }
+
+        void sendAll(int fd, const std::string& text) {
+            const char* p = text.data();
+            size_t bytes = text.size();
+            while (bytes > 0) {
+#ifdef MSG_NOSIGNAL
+                ssize_t written = send(fd, p, bytes, MSG_NOSIGNAL);
+#else
+                ssize_t written = send(fd, p, bytes, 0);
+#endif
+                if (written < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (written <= 0) {
+                    return;
+                }
+                p += written;
+                bytes -= written;
+            }
+        }
+    }
+
+    MetricsServer::MetricsServer(uint16_t port) {
+        takeSnapshot(nowNs());
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        if (listener < 0) {
+            throw std::runtime_error(systemError("metrics socket"));
+        }
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 8) != 0) {
+            std::string error = systemError("metrics on port " + std::to_string(port));
+            close(listener);
+            throw std::runtime_error(error);
+        }
+        thread = std::thread(&MetricsServer::serveLoop, this);
+    }
+
+    MetricsServer::~MetricsServer() {
+        stopping.store(true, std::memory_order_relaxed);
+        thread.join();
+        close(listener);
+    }
+
+    // Polls with a timeout so the destructor never waits on accept and the
+    // window keeps moving without scrapes.
+    void MetricsServer::serveLoop() {
+        while (!stopping.load(std::memory_order_relaxed)) {
+            uint64_t now = nowNs();
+            if (now - snapshots[(snapshots_taken - 1) % snapshots.size()].ns >= 1000000000) {
+                takeSnapshot(now);
+            }
+            pollfd ready = { listener, POLLIN, 0 };
+            if (poll(&ready, 1, 200) <= 0) {
+                continue;
+            }
+            int client = accept(listener, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+            respond(client);
+            close(client);
+        }
+    }
+
+    void MetricsServer::respond(int client) {
+        // A client that never finishes its request only holds the server
+        // up for this long.
+        timeval timeout = { 1, 0 };
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        std::string request;
+        char buffer[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+            ssize_t got = recv(client, buffer, sizeof(buffer), 0);
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got <= 0) {
+                break;
+            }
+            request.append(buffer, got);
+        }
+
+        std::string status = "200 OK";
+        std::ostringstream body;
+        if (request.compare(0, 13, "GET /metrics ") == 0) {
+            render(body);
+        } else if (request.compare(0, 4, "GET ") == 0) {
+            status = "404 Not Found";
+            body << "metrics are at /metrics\n";
+        } else {
+            status = "405 Method Not Allowed";
+        }
+        std::string text = body.str();
+        std::ostringstream response;
+        response << "HTTP/1.1 " << status << "\r\n"
+            << "Content-Type: text/plain; version=0.0.4\r\n"
+            << "Content-Length: " << text.size() << "\r\n"
+            << "Connection: close\r\n\r\n"
+            << text;
+        sendAll(client, response.str());
+    }
+#endif
+}
@@ -0,0 +1,98 @@
+#ifndef __METRICS__HPP__
+#define __METRICS__HPP__
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <cstdint>
+#include <ostream>
+
+namespace game {
+    namespace metrics {
+        // Frame times go into buckets four per octave of microseconds, the
+        // last one catching everything from about 16 seconds up.
+        constexpr uint32_t FRAME_BUCKETS = 96;
+
+        // Updated from the hot paths with relaxed atomics only, once per
+        // step, frame or allocation rather than per cell. Counters only
+        // grow; gauges hold the latest value.
+        struct Counters {
+            std::atomic<uint64_t> generations { 0 };
+            std::atomic<uint64_t> cell_updates { 0 };
+            std::atomic<uint64_t> generation { 0 };
+            std::atomic<uint64_t> population { 0 };
+            // Tiles of the period detector, 0 while it is off.
+            std::atomic<uint64_t> tiles { 0 };
+            std::atomic<uint64_t> active_tiles { 0 };
+            std::atomic<uint64_t> gpu_ns { 0 };
+            std::atomic<uint64_t> gpu_submits { 0 };
+            std::atomic<uint64_t> frame_ns { 0 };
+            std::array<std::atomic<uint64_t>, FRAME_BUCKETS> frames {};
+            // Live bytes of the two pools allocatePages serves from.
+            std::atomic<uint64_t> page_bytes { 0 };
+            std::atomic<uint64_t> heap_bytes { 0 };
+            std::atomic<uint64_t> engine_bytes { 0 };
+            std::atomic<uint64_t> history_bytes { 0 };
+        };
+
+        extern Counters g_counters;
+
+        inline void add(std::atomic<uint64_t>& counter, uint64_t value) {
+            counter.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        inline void set(std::atomic<uint64_t>& gauge, uint64_t value) {
+            gauge.store(value, std::memory_order_relaxed);
+        }
+
+        uint32_t frameBucket(uint64_t ns);
+        // Upper bound of a bucket in seconds.
+        double frameBucketBound(uint32_t bucket);
+
+        inline void recordFrame(uint64_t ns) {
+            add(g_counters.frame_ns, ns);
+            add(g_counters.frames[frameBucket(ns)], 1);
+        }
+    }
+
+    // Serves the counters in the Prometheus text format at /metrics on
+    // 127.0.0.1, from a thread of its own. Rates and frame time quantiles
+    // cover a window of the last WINDOW_SECONDS, which the server thread
+    // moves along once a second, so scrapers don't reset each other's.
+    class MetricsServer {
+    public:
+        static constexpr uint32_t WINDOW_SECONDS = 10;
+
+        explicit MetricsServer(uint16_t port);
+        ~MetricsServer();
+
+        MetricsServer(const MetricsServer&) = delete;
+        MetricsServer& operator=(const MetricsServer&) = delete;
+
+        // Only called from the server thread.
+        void render(std::ostream& os) const;
+
+    private:
+        struct Snapshot {
+            uint64_t ns = 0;
+            uint64_t generations = 0;
+            uint64_t cell_updates = 0;
+            std::array<uint64_t, metrics::FRAME_BUCKETS> frames {};
+        };
+
+        void serveLoop();
+        void respond(int client);
+        void takeSnapshot(uint64_t now);
+
+        int listener = -1;
+        std::atomic<bool> stopping { false };
+        std::thread thread;
+
+        // One a second, the oldest is where the window starts.
+        std::array<Snapshot, WINDOW_SECONDS + 1> snapshots;
+        uint64_t snapshots_taken = 0;
+    };
+}
+
+#endif // __METRICS__HPP__
@@ -0,0 +1,115 @@
+#include "engine.hpp"
+#include "trace.hpp"
+
+namespace game {
+    namespace {
+        // One byte per cell, counting the eight neighbours one by one. Kept
+        // as the reference implementation the other engines are checked
+        // against.
+        class NaiveEngine : public Engine {
+        public:
+            NaiveEngine(Rule rule, ThreadPool& pool) : rule(rule), pool(pool), worker_stats(pool.size()) {}
+
+            const char* name() const override {
+                return "naive";
+            }
+
+            void load(const Board& board) override {
+                width = board.width;
+                height = board.height;
+                cells.assign(width * height, 0);
+                next.assign(width * height, 0);
+                for (uint64_t i = 0; i < height; i++) {
+                    for (uint64_t j = 0; j < width; j++) {
+                        cells[i * width + j] = board.get(i, j);
+                    }
+                }
+                step_stats = boardStats(board);
+            }
+
+            void store(Board& board) const override {
+                createBoard(width, height, board);
+                for (uint64_t i = 0; i < height; i++) {
+                    for (uint64_t j = 0; j < width; j++) {
+                        if (cells[i * width + j]) {
+                            board.set(i, j, true);
+                        }
+                    }
+                }
+            }
+
+            void step(uint64_t generations) override {
+                for (uint64_t g = 0; g < generations; g++) {
+                    GAME_TRACE_SCOPE("naive step");
+                    bool last = g + 1 == generations;
+                    if (last) {
+                        std::fill(worker_stats.begin(), worker_stats.end(), StepStats());
+                    }
+                    pool.parallelFor(height, [this, last](uint64_t begin, uint64_t end, uint32_t worker) {
+                        stepRows(begin, end, last ? &worker_stats[worker] : nullptr);
+                    });
+                    cells.swap(next);
+                }
+                if (generations > 0) {
+                    step_stats = StepStats();
+                    for (auto& s : worker_stats) {
+                        step_stats.merge(s);
+                    }
+                }
+            }
+
+            uint64_t memoryBytes() const override {
+                return cells.size() + next.size();
+            }
+
+        private:
+            void stepRows(uint64_t begin, uint64_t end, StepStats* stats) {
+                for (uint64_t i = begin; i < end; i++) {
+                    for (uint64_t j = 0; j < width; j++) {
+                        uint32_t adjacent = 0;
+                        for (int64_t di = -1; di <= 1; di++) {
+                            for (int64_t dj = -1; dj <= 1; dj++) {
+                                if (di != 0 || dj != 0) {
+                                    adjacent += alive(int64_t(i) + di, int64_t(j) + dj);
+                                }
+                            }
+                        }
+
+                        uint16_t mask = cells[i * width + j] ? rule.survive : rule.birth;
+                        next[i * width + j] = (mask >> adjacent) & 1;
+                        if (stats) {
+                            stats->addWord(
+                                i,
+                                j >> 6,
+                                uint64_t(cells[i * width + j]) << (j & 63),
+                                uint64_t(next[i * width + j]) << (j & 63)
+                            );
+                        }
+                    }
+                }
+            }
+
+            uint32_t alive(int64_t i, int64_t j) const {
+                if (rule.torus) {
+                    i = (i + int64_t(height)) % int64_t(height);
+                    j = (j + int64_t(width)) % int64_t(width);
+                } else if (i < 0 || j < 0 || i >= int64_t(height) || j >= int64_t(width)) {
+                    return 0;
+                }
+                return cells[i * width + j];
+            }
+
+            Rule rule;
+            ThreadPool& pool;
+            uint64_t width = 0;
+            uint64_t height = 0;
+            std::vector<StepStats> worker_stats;
+            std::vector<uint8_t> cells;
+            std::vector<uint8_t> next;
+        };
+    }
+
+    void createNaiveEngine(Rule rule, ThreadPool& pool, std::unique_ptr<Engine>& engine) {
+        engine = std::make_unique<NaiveEngine>(rule, pool);
+    }
+}
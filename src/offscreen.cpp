@@ -0,0 +1,363 @@
+#include "offscreen.hpp"
+#include "vulkan_methods.hpp"
+#include "frame_writer.hpp"
+#include "simulation.hpp"
+#include "gpu_engine.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+
+#include <limits>
+#include <iostream>
+#include <cassert>
+#include <algorithm>
+
+namespace game {
+    namespace {
+        // One entry of the readback ring: the image frame N is rendered to
+        // and the host visible buffer it is copied into. The copy is only
+        // read back once the ring comes around again, so encoding frame N
+        // overlaps rendering and copying the frames after it.
+        struct ReadbackSlot {
+            vk::Image image;
+            vk::DeviceMemory image_memory;
+            vk::ImageView image_view;
+            vk::Framebuffer framebuffer;
+            vk::Buffer buffer;
+            vk::DeviceMemory buffer_memory;
+            vk::MemoryRequirements buffer_reqs;
+            const uint8_t* mapped;
+            vk::CommandBuffer command_buffer;
+            vk::Fence fence;
+            bool pending;
+        };
+
+        const vk::Format offscreen_format = vk::Format::eR8G8B8A8Unorm;
+
+        std::array<Vertex, 6> offscreen_vertices = {
+            Vertex { 0, 0 },
+            Vertex { 0, 1 },
+            Vertex { 1, 0 },
+            Vertex { 0, 1 },
+            Vertex { 1, 0 },
+            Vertex { 1, 1 }
+        };
+
+        void readSlot(vk::Device device, ReadbackSlot& slot, vk::Extent2D extent, FrameWriter& writer) {
+            {
+                GAME_TRACE_SCOPE("waitForFences readback");
+                device.waitForFences({ slot.fence }, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            }
+            GAME_TRACE_SCOPE("encode frame");
+            device.invalidateMappedMemoryRanges({ vk::MappedMemoryRange(slot.buffer_memory, 0, VK_WHOLE_SIZE) });
+            writer.write(slot.mapped, extent.width, extent.height);
+            slot.pending = false;
+        }
+    }
+
+    int runOffscreen(const Options& options) {
+        uint64_t grid_size = options.grid_size;
+        vk::Extent2D extent { options.offscreen_width, options.offscreen_height };
+
+        vk::Instance instance;
+        vk::DispatchLoaderDynamic dispatcher;
+        vk::DebugUtilsMessengerEXT debug_utils;
+        createInstance(instance, dispatcher, debug_utils, true);
+
+        vk::PhysicalDevice physical_device;
+        vk::Device device;
+        Queue graphics_queue, present_queue, compute_queue;
+        createDevice(instance, vk::SurfaceKHR(), dispatcher, physical_device, device, graphics_queue, present_queue, compute_queue);
+
+        ThreadPool pool(options.threads, options.pin_threads);
+        GpuStepper gpu_stepper;
+        std::unique_ptr<Engine> gpu_engine;
+        if (isGpuEngine(options.engine)) {
+            Rule rule;
+            parseRule(options.rule, rule);
+            createGpuStepper(device, physical_device, compute_queue, options.engine, gpu_stepper);
+            createGpuEngine(gpu_stepper, rule, gpu_engine);
+        }
+        Simulation simulation(options, pool, std::move(gpu_engine));
+
+        Camera camera {
+            grid_size / 2.f,
+            grid_size / 2.f,
+            2.
+        };
+
+        std::vector<CellChunk> cell_chunks;
+        createCellChunks(
+            device,
+            physical_device,
+            grid_size,
+            { graphics_queue.index.value() },
+            cell_chunks
+        );
+        StepStats shown_cells;
+        uploadCells(device, grid_size, simulation.board(), simulation.stepStats(), true, cell_chunks, shown_cells);
+
+        Buffer vertex_buffer;
+        Buffer camera_buffer;
+        createBuffer(
+            device,
+            offscreen_vertices.size() * sizeof(Vertex),
+            { graphics_queue.index.value() },
+            vk::BufferUsageFlagBits::eVertexBuffer,
+            vertex_buffer.buffer
+        );
+        createBuffer(
+            device,
+            sizeof(Camera),
+            { graphics_queue.index.value() },
+            vk::BufferUsageFlagBits::eUniformBuffer,
+            camera_buffer.buffer
+        );
+        vertex_buffer.mem_reqs = device.getBufferMemoryRequirements(vertex_buffer.buffer);
+        camera_buffer.mem_reqs = device.getBufferMemoryRequirements(camera_buffer.buffer);
+        vertex_buffer.offset = 0;
+        camera_buffer.offset = vertex_buffer.mem_reqs.size;
+        if (camera_buffer.offset % camera_buffer.mem_reqs.alignment) {
+            camera_buffer.offset += camera_buffer.mem_reqs.alignment - (camera_buffer.offset % camera_buffer.mem_reqs.alignment);
+        }
+
+        vk::DeviceMemory device_memory;
+        uint32_t device_memory_type_index;
+        createDeviceMemory(device, physical_device, camera_buffer.offset + camera_buffer.mem_reqs.size, device_memory_type_index, device_memory);
+        assert(bool(vertex_buffer.mem_reqs.memoryTypeBits & (1 << device_memory_type_index)));
+        assert(bool(camera_buffer.mem_reqs.memoryTypeBits & (1 << device_memory_type_index)));
+        device.bindBufferMemory(vertex_buffer.buffer, device_memory, vertex_buffer.offset);
+        device.bindBufferMemory(camera_buffer.buffer, device_memory, camera_buffer.offset);
+        {
+            Vertex* mapped_memory = static_cast<Vertex*>(device.mapMemory(device_memory, vertex_buffer.offset, vertex_buffer.mem_reqs.size));
+            for (uint32_t i = 0; i < offscreen_vertices.size(); i++) {
+                mapped_memory[i] = offscreen_vertices[i];
+            }
+            device.unmapMemory(device_memory);
+        }
+        {
+            Camera* mapped_memory = static_cast<Camera*>(device.mapMemory(device_memory, camera_buffer.offset, camera_buffer.mem_reqs.size));
+            *mapped_memory = camera;
+            device.unmapMemory(device_memory);
+        }
+
+        vk::DescriptorSetLayout descriptor_set_layout;
+        createDescriptorSetLayout(device, descriptor_set_layout);
+        vk::DescriptorPool descriptor_pool;
+        createDescriptorPool(device, 1, descriptor_pool);
+        std::vector<vk::DescriptorSet> uniform_sets;
+        createDescriptorSets(device, { descriptor_set_layout }, descriptor_pool, { camera_buffer }, uniform_sets);
+
+        vk::CommandPool graphics_command_pool;
+        vk::CommandPool compute_command_pool;
+        createCommandPools(
+            device,
+            graphics_queue.index.value(),
+            compute_queue.index.value(),
+            graphics_command_pool,
+            compute_command_pool
+        );
+
+        vk::RenderPass render_pass;
+        createRenderpass(device, offscreen_format, vk::ImageLayout::eTransferSrcOptimal, render_pass);
+
+        std::vector<vk::VertexInputAttributeDescription> vertex_attributes;
+        {
+            auto vertex_attr = Vertex::getAttributeDescriptions();
+            vertex_attributes.insert(vertex_attributes.end(), vertex_attr.begin(), vertex_attr.end());
+            auto cell_attr = Cell::getAttributeDescriptions();
+            vertex_attributes.insert(vertex_attributes.end(), cell_attr.begin(), cell_attr.end());
+        }
+        vk::Pipeline graphics_pipeline;
+        vk::PipelineLayout graphics_pipeline_layout;
+        createGraphicsPipeline(
+            device,
+            static_cast<uint32_t>(grid_size),
+            extent,
+            { descriptor_set_layout },
+            { Vertex::getBindingDescription(), Cell::getBindingDescription() },
+            vertex_attributes,
+            render_pass,
+            graphics_pipeline_layout,
+            graphics_pipeline
+        );
+
+        std::vector<ReadbackSlot> slots(std::max<uint32_t>(options.readback_ring, 1));
+        {
+            vk::CommandBufferAllocateInfo command_buffers_info = vk::CommandBufferAllocateInfo()
+                .setCommandPool(graphics_command_pool)
+                .setCommandBufferCount(slots.size())
+                .setLevel(vk::CommandBufferLevel::ePrimary);
+            std::vector<vk::CommandBuffer> command_buffers = device.allocateCommandBuffers(command_buffers_info);
+
+            for (uint32_t i = 0; i < slots.size(); i++) {
+                ReadbackSlot& slot = slots[i];
+                createImage(
+                    device,
+                    physical_device,
+                    extent,
+                    offscreen_format,
+                    vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+                    slot.image,
+                    slot.image_memory
+                );
+                createImageView(device, slot.image, offscreen_format, slot.image_view);
+                createFramebuffer(device, extent, { slot.image_view }, render_pass, slot.framebuffer);
+
+                createBuffer(
+                    device,
+                    vk::DeviceSize(extent.width) * extent.height * 4,
+                    { graphics_queue.index.value() },
+                    vk::BufferUsageFlagBits::eTransferDst,
+                    slot.buffer
+                );
+                slot.buffer_reqs = device.getBufferMemoryRequirements(slot.buffer);
+                vk::MemoryAllocateInfo memory_info = vk::MemoryAllocateInfo()
+                    .setAllocationSize(slot.buffer_reqs.size)
+                    .setMemoryTypeIndex(findMemoryType(
+                        physical_device,
+                        slot.buffer_reqs.memoryTypeBits,
+                        vk::MemoryPropertyFlagBits::eHostVisible,
+                        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached
+                    ));
+                slot.buffer_memory = device.allocateMemory(memory_info);
+                device.bindBufferMemory(slot.buffer, slot.buffer_memory, 0);
+                slot.mapped = static_cast<const uint8_t*>(device.mapMemory(slot.buffer_memory, 0, VK_WHOLE_SIZE));
+
+                slot.command_buffer = command_buffers[i];
+                slot.command_buffer.begin(vk::CommandBufferBeginInfo());
+                recordBoardDraw(
+                    slot.command_buffer,
+                    render_pass,
+                    slot.framebuffer,
+                    extent,
+                    graphics_pipeline,
+                    graphics_pipeline_layout,
+                    vertex_buffer,
+                    cell_chunks,
+                    grid_size,
+                    uniform_sets[0],
+                    {}
+                );
+                vk::BufferImageCopy region = vk::BufferImageCopy()
+                    .setBufferOffset(0)
+                    .setBufferRowLength(0)
+                    .setBufferImageHeight(0)
+                    .setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+                    .setImageOffset(vk::Offset3D { 0, 0, 0 })
+                    .setImageExtent(vk::Extent3D { extent.width, extent.height, 1 });
+                slot.command_buffer.copyImageToBuffer(slot.image, vk::ImageLayout::eTransferSrcOptimal, slot.buffer, { region });
+                vk::BufferMemoryBarrier host_barrier = vk::BufferMemoryBarrier()
+                    .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+                    .setDstAccessMask(vk::AccessFlagBits::eHostRead)
+                    .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                    .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                    .setBuffer(slot.buffer)
+                    .setOffset(0)
+                    .setSize(VK_WHOLE_SIZE);
+                slot.command_buffer.pipelineBarrier(
+                    vk::PipelineStageFlagBits::eTransfer,
+                    vk::PipelineStageFlagBits::eHost,
+                    {},
+                    {},
+                    { host_barrier },
+                    {}
+                );
+                slot.command_buffer.end();
+
+                slot.fence = device.createFence(vk::FenceCreateInfo());
+                slot.pending = false;
+            }
+        }
+
+        std::unique_ptr<FrameWriter> writer;
+        createFrameWriter(options.output, extent.width, extent.height, options.fps, writer);
+
+        // Video time is fixed at fps, so a generation rate becomes a
+        // (fractional, carried over) number of generations per frame.
+        double generations_owed = 0.;
+
+        // Frame N: step the CPU board while the GPU still works on N - 1,
+        // wait for N - 1 to stop reading the cell buffers, upload, submit,
+        // then encode whichever frame left the ring.
+        for (uint64_t frame = 0; frame < options.frames; frame++) {
+            GAME_TRACE_SCOPE("frame");
+            uint64_t frame_begin_ns = trace::now();
+            ReadbackSlot& slot = slots[frame % slots.size()];
+            if (frame != 0) {
+                GAME_TRACE_SCOPE("step");
+                uint64_t generations = options.generations_per_frame;
+                if (options.generation_rate > 0.) {
+                    generations_owed += options.generation_rate / options.fps;
+                    generations = static_cast<uint64_t>(generations_owed);
+                    generations_owed -= double(generations);
+                }
+                simulation.step(generations);
+            }
+            if (frame != 0) {
+                ReadbackSlot& previous = slots[(frame - 1) % slots.size()];
+                GAME_TRACE_SCOPE("waitForFences render");
+                device.waitForFences({ previous.fence }, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            }
+            if (slot.pending) {
+                readSlot(device, slot, extent, *writer);
+            }
+            {
+                GAME_TRACE_SCOPE("upload cells");
+                uploadCells(device, grid_size, simulation.board(), simulation.stepStats(), false, cell_chunks, shown_cells);
+            }
+            device.resetFences({ slot.fence });
+            vk::SubmitInfo submit_info = vk::SubmitInfo()
+                .setCommandBufferCount(1)
+                .setPCommandBuffers(&slot.command_buffer);
+            {
+                GAME_TRACE_SCOPE("submit");
+                graphics_queue.queue.submit({ submit_info }, slot.fence);
+            }
+            slot.pending = true;
+            metrics::recordFrame(trace::now() - frame_begin_ns);
+        }
+        for (uint64_t i = 0; i < slots.size(); i++) {
+            ReadbackSlot& slot = slots[(options.frames + i) % slots.size()];
+            if (slot.pending) {
+                readSlot(device, slot, extent, *writer);
+            }
+        }
+        writer->finish();
+        writer.reset();
+
+        device.waitIdle();
+
+        for (ReadbackSlot& slot : slots) {
+            device.destroyFence(slot.fence);
+            device.unmapMemory(slot.buffer_memory);
+            device.destroyBuffer(slot.buffer);
+            device.freeMemory(slot.buffer_memory);
+            device.destroyFramebuffer(slot.framebuffer);
+            device.destroyImageView(slot.image_view);
+            device.destroyImage(slot.image);
+            device.freeMemory(slot.image_memory);
+        }
+        device.destroyPipeline(graphics_pipeline);
+        device.destroyPipelineLayout(graphics_pipeline_layout);
+        device.destroyRenderPass(render_pass);
+        device.destroyBuffer(camera_buffer.buffer);
+        device.destroyBuffer(vertex_buffer.buffer);
+        device.freeMemory(device_memory);
+        destroyCellChunks(device, cell_chunks);
+        simulation.printStats(std::cerr);
+        if (isGpuEngine(options.engine)) {
+            destroyGpuStepper(device, gpu_stepper);
+        }
+        if (compute_queue != graphics_queue) {
+            device.destroyCommandPool(compute_command_pool);
+        }
+        device.destroyCommandPool(graphics_command_pool);
+        device.destroyDescriptorPool(descriptor_pool);
+        device.destroyDescriptorSetLayout(descriptor_set_layout);
+        device.destroy();
+        instance.destroyDebugUtilsMessengerEXT(debug_utils, nullptr, dispatcher);
+        instance.destroy();
+
+        return 0;
+    }
+}
@@ -0,0 +1,12 @@
+#ifndef __OFFSCREEN__HPP__
+#define __OFFSCREEN__HPP__
+
+#include "options.hpp"
+
+namespace game {
+    // Renders options.frames generations into device images without a
+    // window or swapchain and streams them to options.output.
+    int runOffscreen(const Options& options);
+}
+
+#endif // __OFFSCREEN__HPP__
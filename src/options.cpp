@@ -0,0 +1,117 @@
+#include "options.hpp"
+
+#include <cerrno>
+#include <limits>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace game {
+    namespace {
+        std::string value(int argc, char** argv, int& i) {
+            if (i + 1 >= argc) {
+                throw std::runtime_error(std::string(argv[i]) + " expects a value");
+            }
+            return argv[++i];
+        }
+    }
+
+    uint64_t parseGridSize(std::string text) {
+        errno = 0;
+        char* end = nullptr;
+        unsigned long long size = std::strtoull(text.c_str(), &end, 10);
+        if (text.empty() || text[0] == '-' || *end != '\0' || errno == ERANGE) {
+            throw std::runtime_error("invalid grid size " + text);
+        }
+        // The vertex shader receives the size as a 32 bit specialization
+        // constant.
+        if (size == 0 || size > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("grid size out of range " + text);
+        }
+        return size;
+    }
+
+    void parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--draw-all") {
+                options.compact_cells = false;
+            } else if (arg == "--pin-threads") {
+                options.pin_threads = true;
+            } else if (arg == "--present-mode") {
+                options.present_mode = value(argc, argv, i);
+            } else if (arg == "--max-fps") {
+                options.max_fps = std::stod(value(argc, argv, i));
+            } else if (arg == "--generations-per-frame") {
+                options.generations_per_frame = std::stoull(value(argc, argv, i));
+            } else if (arg == "--generation-rate") {
+                options.generation_rate = std::stod(value(argc, argv, i));
+            } else if (arg == "--stamp") {
+                options.stamp = value(argc, argv, i);
+            } else if (arg == "--trace") {
+                options.trace_path = value(argc, argv, i);
+            } else if (arg == "--engine") {
+                options.engine = value(argc, argv, i);
+            } else if (arg == "--engine-log") {
+                options.engine_log = true;
+            } else if (arg == "--rule") {
+                options.rule = value(argc, argv, i);
+            } else if (arg == "--threads") {
+                options.threads = std::atoi(value(argc, argv, i).c_str());
+            } else if (arg == "--huge-pages") {
+                options.huge_pages = value(argc, argv, i);
+            } else if (arg == "--seed") {
+                options.seed = std::stoull(value(argc, argv, i));
+                options.has_seed = true;
+            } else if (arg == "--density") {
+                options.density = std::stod(value(argc, argv, i));
+            } else if (arg == "--soup") {
+                options.soup = value(argc, argv, i);
+            } else if (arg == "--period-window") {
+                options.period_window = std::stoul(value(argc, argv, i));
+            } else if (arg == "--history-mb") {
+                options.history_mb = std::stoull(value(argc, argv, i));
+            } else if (arg == "--keyframe-interval") {
+                options.keyframe_interval = std::stoull(value(argc, argv, i));
+            } else if (arg == "--stream") {
+                options.stream = value(argc, argv, i);
+            } else if (arg == "--stream-keyframes") {
+                options.stream_keyframes = std::stoull(value(argc, argv, i));
+            } else if (arg == "--publish") {
+                options.publish = value(argc, argv, i);
+            } else if (arg == "--publish-slots") {
+                options.publish_slots = std::stoul(value(argc, argv, i));
+            } else if (arg == "--metrics-port") {
+                unsigned long port = std::stoul(value(argc, argv, i));
+                if (port > 65535) {
+                    throw std::runtime_error("--metrics-port must be a TCP port");
+                }
+                options.metrics_port = static_cast<uint16_t>(port);
+            } else if (arg == "--offscreen") {
+                std::string extent = value(argc, argv, i);
+                size_t split = extent.find('x');
+                if (split == std::string::npos) {
+                    throw std::runtime_error("--offscreen expects <width>x<height>");
+                }
+                options.offscreen = true;
+                options.offscreen_width = std::stoul(extent.substr(0, split));
+                options.offscreen_height = std::stoul(extent.substr(split + 1));
+            } else if (arg == "--frames") {
+                options.frames = std::stoull(value(argc, argv, i));
+            } else if (arg == "--fps") {
+                options.fps = std::stoul(value(argc, argv, i));
+                if (options.fps == 0) {
+                    throw std::runtime_error("--fps must be at least 1");
+                }
+            } else if (arg == "--readback-ring") {
+                options.readback_ring = std::stoul(value(argc, argv, i));
+            } else if (arg == "--output") {
+                options.output = value(argc, argv, i);
+            } else {
+                options.grid_size = parseGridSize(arg);
+            }
+        }
+        if (options.offscreen && options.stream == "-" && options.output == "-") {
+            throw std::runtime_error("--stream and --output can't both go to stdout");
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef __OPTIONS__HPP__
+#define __OPTIONS__HPP__
+
+#include <string>
+#include <cstdint>
+
+namespace game {
+    struct Options {
+        uint64_t grid_size = 1000;
+        std::string trace_path;
+        std::string engine = "bitpacked";
+        // Report the adaptive engine's choices on stderr.
+        bool engine_log = false;
+        std::string rule = "B3/S23";
+        uint32_t threads = 0;
+        bool pin_threads = false;
+        // "off", "thp" or "explicit", see HugePages.
+        std::string huge_pages = "thp";
+        uint64_t seed = 0;
+        bool has_seed = false;
+        double density = 0.5;
+        std::string soup = "center";
+        // Generations of board hashes kept for period detection, 0 is off.
+        uint32_t period_window = 0;
+        // Memory for rewinding through past generations, 0 is off.
+        uint64_t history_mb = 0;
+        uint64_t keyframe_interval = 64;
+        // Every generation as a binary diff stream to this path, "-" for
+        // stdout; empty is off. 0 keyframes means only the first record.
+        std::string stream;
+        uint64_t stream_keyframes = 0;
+        // Every generation into a shared memory ring of this many frames
+        // under this name, e.g. "/life"; empty is off.
+        std::string publish;
+        uint32_t publish_slots = 4;
+        // Prometheus metrics on 127.0.0.1 at this port, 0 is off.
+        uint16_t metrics_port = 0;
+        // Draw only live cells, compacted on the GPU each frame.
+        bool compact_cells = true;
+        // "fifo", "mailbox" or "immediate".
+        std::string present_mode = "fifo";
+        // 0 leaves the frame rate to the present mode.
+        double max_fps = 0.;
+        uint64_t generations_per_frame = 1;
+        // Generations per second; overrides generations_per_frame when set.
+        double generation_rate = 0.;
+        // Builtin pattern name or pattern file placed by stamping.
+        std::string stamp = "glider";
+
+        bool offscreen = false;
+        uint32_t offscreen_width = 1280;
+        uint32_t offscreen_height = 720;
+        uint64_t frames = 300;
+        uint32_t fps = 30;
+        uint32_t readback_ring = 3;
+        std::string output = "frame_%06d.png";
+    };
+
+    uint64_t parseGridSize(std::string text);
+    void parseOptions(int argc, char** argv, Options& options);
+}
+
+#endif // __OPTIONS__HPP__
@@ -0,0 +1,107 @@
+#include "patterns.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace game {
+    namespace {
+        struct BuiltinPattern {
+            const char* name;
+            const char* rle;
+        };
+
+        const BuiltinPattern builtin_patterns[] = {
+            { "glider", "bo$2bo$3o!" },
+            { "blinker", "3o!" },
+            { "lwss", "bo2bo$o4b$o3bo$4o!" },
+            { "pulsar", "2b3o3b3o2b2$o4bobo4bo$o4bobo4bo$o4bobo4bo$2b3o3b3o2b2$2b3o3b3o2b$o4bobo4bo$o4bobo4bo$o4bobo4bo2$2b3o3b3o!" },
+            { "gosper_gun", "24bo11b$22bobo11b$12b2o6b2o12b2o$11bo3bo4b2o12b2o$2o8bo5bo3b2o14b$2o8bo3bob2o4bobo11b$10bo5bo7bo11b$11bo3bo20b$12b2o!" },
+            { "r_pentomino", "b2o$2ob$bo!" },
+        };
+    }
+
+    void parseRle(std::string text, Pattern& pattern) {
+        pattern = Pattern();
+        std::istringstream stream(text);
+        std::string line;
+        std::string body;
+        while (std::getline(stream, line)) {
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            if (line[0] == 'x' && line.find('=') != std::string::npos) {
+                continue;
+            }
+            body += line;
+        }
+
+        uint64_t row = 0;
+        uint64_t column = 0;
+        uint64_t run = 0;
+        for (char c : body) {
+            if (c >= '0' && c <= '9') {
+                run = run * 10 + (c - '0');
+                continue;
+            }
+            uint64_t count = run == 0 ? 1 : run;
+            run = 0;
+            if (c == 'b' || c == '.') {
+                column += count;
+            } else if (c == 'o' || c == 'A') {
+                for (uint64_t k = 0; k < count; k++) {
+                    pattern.cells.push_back({ row, column + k });
+                }
+                column += count;
+                pattern.width = std::max(pattern.width, column);
+                pattern.height = std::max(pattern.height, row + 1);
+            } else if (c == '$') {
+                row += count;
+                column = 0;
+            } else if (c == '!') {
+                break;
+            } else if (c != ' ' && c != '\r' && c != '\t') {
+                throw std::runtime_error(std::string("invalid RLE character ") + c);
+            }
+        }
+    }
+
+    void loadPattern(std::string path, Pattern& pattern) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            throw std::runtime_error("couldn't read pattern " + path);
+        }
+        std::stringstream contents;
+        contents << file.rdbuf();
+        parseRle(contents.str(), pattern);
+    }
+
+    void builtinPattern(std::string name, Pattern& pattern) {
+        for (const BuiltinPattern& p : builtin_patterns) {
+            if (name == p.name) {
+                parseRle(p.rle, pattern);
+                return;
+            }
+        }
+        throw std::runtime_error("unknown pattern " + name);
+    }
+
+    std::vector<std::string> builtinPatternNames() {
+        std::vector<std::string> names;
+        for (const BuiltinPattern& p : builtin_patterns) {
+            names.push_back(p.name);
+        }
+        return names;
+    }
+
+    void stampPattern(Board& board, const Pattern& pattern, uint64_t row, uint64_t column) {
+        for (auto& cell : pattern.cells) {
+            uint64_t i = row + cell.first;
+            uint64_t j = column + cell.second;
+            if (i < board.height && j < board.width) {
+                board.set(i, j, true);
+            }
+        }
+    }
+}
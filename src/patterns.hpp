@@ -0,0 +1,27 @@
+#ifndef __PATTERNS__HPP__
+#define __PATTERNS__HPP__
+
+#include "board.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace game {
+    struct Pattern {
+        uint64_t width = 0;
+        uint64_t height = 0;
+        // (row, column) of every live cell, relative to the top left corner.
+        std::vector<std::pair<uint64_t, uint64_t>> cells;
+    };
+
+    void parseRle(std::string text, Pattern& pattern);
+    void loadPattern(std::string path, Pattern& pattern);
+    void builtinPattern(std::string name, Pattern& pattern);
+    std::vector<std::string> builtinPatternNames();
+
+    // Cells falling outside the board are dropped.
+    void stampPattern(Board& board, const Pattern& pattern, uint64_t row, uint64_t column);
+}
+
+#endif // __PATTERNS__HPP__
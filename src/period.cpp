@@ -0,0 +1,102 @@
+#include "period.hpp"
+#include "trace.hpp"
+
+#include <atomic>
+#include <algorithm>
+
+namespace game {
+    namespace {
+        uint64_t mix(uint64_t z) {
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+    }
+
+    PeriodDetector::PeriodDetector(uint32_t window) : history(window) {}
+
+    void PeriodDetector::reset() {
+        observed = 0;
+        settled_tiles = 0;
+        board_hashes.clear();
+        tile_hashes.clear();
+    }
+
+    uint64_t PeriodDetector::observe(const Board& board, uint64_t generation, ThreadPool& pool) {
+        GAME_TRACE_SCOPE("period observe");
+        if (history == 0) {
+            return 0;
+        }
+        uint64_t tile_rows = (board.height + TILE_ROWS - 1) / TILE_ROWS;
+        tile_columns = (board.words_per_row + TILE_WORDS - 1) / TILE_WORDS;
+        if (observed == 0 || tiles != tile_rows * tile_columns || generation != last_generation + 1) {
+            tiles = tile_rows * tile_columns;
+            observed = 0;
+            board_hashes.assign(history + 1, 0);
+            tile_hashes.assign(tiles * (history + 1), 0);
+        }
+        uint64_t slot = generation % (history + 1);
+        std::atomic<uint64_t> settled { 0 };
+
+        pool.parallelFor(tiles, [&](uint64_t begin, uint64_t end, uint32_t) {
+            uint64_t local_settled = 0;
+            for (uint64_t t = begin; t < end; t++) {
+                uint64_t row_begin = (t / tile_columns) * TILE_ROWS;
+                uint64_t row_end = std::min(board.height, row_begin + TILE_ROWS);
+                uint64_t word_begin = (t % tile_columns) * TILE_WORDS;
+                uint64_t word_end = std::min(board.words_per_row, word_begin + TILE_WORDS);
+                uint64_t h = t;
+                for (uint64_t i = row_begin; i < row_end; i++) {
+                    const uint64_t* row = board.row(i);
+                    for (uint64_t w = word_begin; w < word_end; w++) {
+                        h = (h ^ row[w]) * 0x100000001B3ull;
+                        h ^= h >> 29;
+                    }
+                }
+                h = mix(h);
+                uint64_t* hashes = tile_hashes.data() + t * (history + 1);
+                hashes[slot] = h;
+                uint64_t available = std::min<uint64_t>(observed, history);
+                for (uint64_t p = 1; p <= available; p++) {
+                    if (hashes[(generation - p) % (history + 1)] == h) {
+                        local_settled++;
+                        break;
+                    }
+                }
+            }
+            settled += local_settled;
+        });
+        settled_tiles = settled;
+
+        uint64_t h = 0;
+        for (uint64_t t = 0; t < tiles; t++) {
+            h = mix(h ^ tile_hashes[t * (history + 1) + slot]);
+        }
+        board_hashes[slot] = h;
+        uint64_t available = std::min<uint64_t>(observed, history);
+        observed++;
+        last_generation = generation;
+        for (uint64_t p = 1; p <= available; p++) {
+            if (board_hashes[(generation - p) % (history + 1)] == h) {
+                return p;
+            }
+        }
+        return 0;
+    }
+
+    // Earliest generation still in the window from which the hash sequence
+    // already repeats with `period`.
+    uint64_t PeriodDetector::firstRepeat(uint64_t generation, uint64_t period) const {
+        uint64_t first = generation - period;
+        uint64_t available = std::min<uint64_t>(observed, history + 1);
+        while (first > 0 && generation - (first - 1) < available) {
+            uint64_t a = board_hashes[(first - 1) % (history + 1)];
+            uint64_t b = board_hashes[(first - 1 + period) % (history + 1)];
+            if (a != b) {
+                break;
+            }
+            first--;
+        }
+        return first;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef __PERIOD__HPP__
+#define __PERIOD__HPP__
+
+#include "board.hpp"
+#include "thread_pool.hpp"
+
+#include <vector>
+#include <cstdint>
+
+namespace game {
+    struct PeriodStats {
+        // 0 until the whole board is confirmed periodic.
+        uint64_t period = 0;
+        uint64_t stabilized_generation = 0;
+        // Tiles whose own contents repeated within the window.
+        uint64_t settled_tiles = 0;
+        uint64_t tiles = 0;
+    };
+
+    // Keeps hashes of the board, and of each tile of it, for the last
+    // `window` generations. observe() reports the smallest period whose
+    // hashes match; the caller confirms it against real board states since
+    // hashes can collide.
+    class PeriodDetector {
+    public:
+        static constexpr uint64_t TILE_ROWS = 64;
+        static constexpr uint64_t TILE_WORDS = 4;
+
+        explicit PeriodDetector(uint32_t window);
+
+        uint64_t observe(const Board& board, uint64_t generation, ThreadPool& pool);
+        uint64_t firstRepeat(uint64_t generation, uint64_t period) const;
+        void reset();
+
+        uint32_t window() const {
+            return history;
+        }
+
+        uint64_t settledTiles() const {
+            return settled_tiles;
+        }
+
+        uint64_t tileCount() const {
+            return tiles;
+        }
+
+    private:
+        uint32_t history;
+        uint64_t observed = 0;
+        uint64_t last_generation = 0;
+        uint64_t tiles = 0;
+        uint64_t tile_columns = 0;
+        uint64_t settled_tiles = 0;
+        std::vector<uint64_t> board_hashes;
+        std::vector<uint64_t> tile_hashes;
+    };
+}
+
+#endif // __PERIOD__HPP__
@@ -0,0 +1,148 @@
+#include "seed.hpp"
+#include "trace.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+namespace game {
+    namespace {
+        uint64_t mix(uint64_t z) {
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        uint64_t rangeMask(uint64_t word, uint64_t begin, uint64_t end) {
+            uint64_t lo = word * 64;
+            uint64_t from = begin > lo ? begin - lo : 0;
+            uint64_t to = end - lo >= 64 ? 64 : end - lo;
+            uint64_t upper = to == 64 ? ~uint64_t(0) : (uint64_t(1) << to) - 1;
+            return upper & ~((uint64_t(1) << from) - 1);
+        }
+
+        void seedRowRange(
+            Board& board,
+            uint64_t i,
+            uint64_t column_begin,
+            uint64_t column_end,
+            uint64_t key,
+            uint32_t threshold
+        ) {
+            uint64_t* row = board.row(i);
+            for (uint64_t w = column_begin / 64; w <= (column_end - 1) / 64; w++) {
+                uint64_t mask = rangeMask(w, column_begin, column_end);
+                uint64_t cells = randomCells(key, i * board.words_per_row + w, threshold);
+                row[w] = (row[w] & ~mask) | (cells & mask);
+            }
+        }
+    }
+
+    uint64_t seedKey(uint64_t seed) {
+        return mix(seed + 0x9E3779B97F4A7C15ull);
+    }
+
+    uint64_t randomWord(uint64_t key, uint64_t counter) {
+        return mix(mix(key ^ ((counter + 1) * 0x9E3779B97F4A7C15ull)));
+    }
+
+    uint32_t densityThreshold(double density) {
+        if (!(density >= 0.) || density > 1.) {
+            throw std::runtime_error("density must be within [0, 1]");
+        }
+        return static_cast<uint32_t>(std::lround(density * 65536.));
+    }
+
+    uint64_t randomCells(uint64_t key, uint64_t counter, uint32_t threshold) {
+        if (threshold == 0) {
+            return 0;
+        }
+        if (threshold >= 65536) {
+            return ~uint64_t(0);
+        }
+        uint64_t cells = 0;
+        for (uint32_t b = countTrailingZeros64(threshold); b < 16; b++) {
+            uint64_t w = randomWord(key, (counter << 4) | b);
+            cells = (threshold >> b) & 1 ? cells | w : cells & w;
+        }
+        return cells;
+    }
+
+    void seedRegion(Board& board, SeedRegion region, uint64_t seed, double density, ThreadPool& pool) {
+        GAME_TRACE_SCOPE("seedRegion");
+        if (region.row >= board.height || region.column >= board.width) {
+            return;
+        }
+        uint64_t row_end = std::min(board.height, region.row + region.height);
+        uint64_t column_end = std::min(board.width, region.column + region.width);
+        if (column_end <= region.column) {
+            return;
+        }
+        uint64_t key = seedKey(seed);
+        uint32_t threshold = densityThreshold(density);
+        pool.parallelFor(row_end - region.row, [&](uint64_t begin, uint64_t end, uint32_t) {
+            for (uint64_t i = region.row + begin; i < region.row + end; i++) {
+                seedRowRange(board, i, region.column, column_end, key, threshold);
+            }
+        });
+    }
+
+    void seedTiles(
+        Board& board,
+        SeedRegion area,
+        uint64_t tile_size,
+        uint64_t stride,
+        uint64_t seed,
+        double density,
+        ThreadPool& pool
+    ) {
+        GAME_TRACE_SCOPE("seedTiles");
+        if (tile_size == 0 || stride == 0) {
+            throw std::runtime_error("tile size and stride must be positive");
+        }
+        if (area.row >= board.height || area.column >= board.width) {
+            return;
+        }
+        uint64_t row_end = std::min(board.height, area.row + area.height);
+        uint64_t column_end = std::min(board.width, area.column + area.width);
+        uint64_t key = seedKey(seed);
+        uint32_t threshold = densityThreshold(density);
+        pool.parallelFor(row_end - area.row, [&](uint64_t begin, uint64_t end, uint32_t) {
+            for (uint64_t r = begin; r < end; r++) {
+                if (r % stride >= tile_size) {
+                    continue;
+                }
+                for (uint64_t j = area.column; j < column_end; j += stride) {
+                    seedRowRange(board, area.row + r, j, std::min(j + tile_size, column_end), key, threshold);
+                }
+            }
+        });
+    }
+
+    void seedSoup(Board& board, std::string layout, uint64_t seed, double density, ThreadPool& pool) {
+        SeedRegion full { 0, 0, board.height, board.width };
+        if (layout == "full") {
+            seedRegion(board, full, seed, density, pool);
+        } else if (layout == "center") {
+            uint64_t fith_rows = board.height / 5;
+            uint64_t fith_columns = board.width / 5;
+            SeedRegion center {
+                board.height / 2 - fith_rows / 2,
+                board.width / 2 - fith_columns / 2,
+                fith_rows,
+                fith_columns
+            };
+            seedRegion(board, center, seed, density, pool);
+        } else if (layout.rfind("tiles:", 0) == 0) {
+            size_t split = layout.find(':', 6);
+            if (split == std::string::npos) {
+                throw std::runtime_error("tiles layout expects tiles:<size>:<stride>");
+            }
+            uint64_t tile_size = std::stoull(layout.substr(6, split - 6));
+            uint64_t stride = std::stoull(layout.substr(split + 1));
+            seedTiles(board, full, tile_size, stride, seed, density, pool);
+        } else {
+            throw std::runtime_error("unknown soup layout " + layout);
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef __SEED__HPP__
+#define __SEED__HPP__
+
+#include "board.hpp"
+#include "thread_pool.hpp"
+
+#include <string>
+#include <cstdint>
+
+namespace game {
+    struct SeedRegion {
+        uint64_t row;
+        uint64_t column;
+        uint64_t height;
+        uint64_t width;
+    };
+
+    // Counter based generator: every word of random bits is a pure function
+    // of (seed, counter), so any part of the board can be filled in any
+    // order, on any number of threads, with the same result.
+    uint64_t seedKey(uint64_t seed);
+    uint64_t randomWord(uint64_t key, uint64_t counter);
+
+    // 64 cells, each alive with probability threshold / 2^16. Costs one
+    // random word per significant bit of threshold, so a density of 0.5 is
+    // a single draw.
+    uint64_t randomCells(uint64_t key, uint64_t counter, uint32_t threshold);
+    uint32_t densityThreshold(double density);
+
+    void seedRegion(Board& board, SeedRegion region, uint64_t seed, double density, ThreadPool& pool);
+    void seedTiles(
+        Board& board,
+        SeedRegion area,
+        uint64_t tile_size,
+        uint64_t stride,
+        uint64_t seed,
+        double density,
+        ThreadPool& pool
+    );
+
+    // layout is "full", "center" (the middle fifth of the board) or
+    // "tiles:<size>:<stride>".
+    void seedSoup(Board& board, std::string layout, uint64_t seed, double density, ThreadPool& pool);
+}
+
+#endif // __SEED__HPP__
@@ -0,0 +1,191 @@
+#include "shared_board.hpp"
+
+#include <new>
+#include <thread>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace game {
+    namespace {
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared frames need lock-free 64 bit atomics");
+
+        std::string systemError(std::string what) {
+            return what + ": " + std::strerror(errno);
+        }
+
+        size_t frameOffset() {
+            return (sizeof(SharedBoardHeader) + 63) / 64 * 64;
+        }
+
+        const SharedFrame* frameAt(const SharedBoardHeader* header, uint64_t slot) {
+            const char* base = reinterpret_cast<const char*>(header) + frameOffset();
+            return reinterpret_cast<const SharedFrame*>(base + slot * header->slot_bytes);
+        }
+
+        const uint64_t* frameWords(const SharedFrame* frame) {
+            return reinterpret_cast<const uint64_t*>(frame + 1);
+        }
+    }
+
+#ifdef _WIN32
+    SharedBoardPublisher::SharedBoardPublisher(std::string name, uint64_t, uint64_t, Rule, uint32_t) : name(name) {
+        throw std::runtime_error("publishing the board needs POSIX shared memory");
+    }
+
+    SharedBoardPublisher::~SharedBoardPublisher() {}
+
+    void SharedBoardPublisher::publish(const Board&, uint64_t, uint64_t) {}
+
+    SharedBoardReader::SharedBoardReader(std::string) {
+        throw std::runtime_error("reading a published board needs POSIX shared memory");
+    }
+
+    SharedBoardReader::~SharedBoardReader() {}
+#else
+    SharedBoardPublisher::SharedBoardPublisher(std::string name, uint64_t width, uint64_t height, Rule rule, uint32_t slots)
+        : name(name) {
+        if (slots < 2) {
+            throw std::runtime_error("a published board needs at least 2 slots");
+        }
+        uint64_t words_per_row = (width + 63) / 64;
+        uint64_t slot_bytes = (sizeof(SharedFrame) + words_per_row * height * sizeof(uint64_t) + 63) / 64 * 64;
+        bytes = frameOffset() + slots * slot_bytes;
+
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) {
+            throw std::runtime_error(systemError("shm_open " + name));
+        }
+        if (ftruncate(fd, bytes) != 0) {
+            close(fd);
+            shm_unlink(name.c_str());
+            throw std::runtime_error(systemError("ftruncate " + name));
+        }
+        address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED) {
+            shm_unlink(name.c_str());
+            throw std::runtime_error(systemError("mmap " + name));
+        }
+
+        // The object starts out zeroed, so every sequence starts even.
+        header = new (address) SharedBoardHeader();
+        header->version = SHARED_BOARD_VERSION;
+        header->slots = slots;
+        header->width = width;
+        header->height = height;
+        header->words_per_row = words_per_row;
+        header->slot_bytes = slot_bytes;
+        header->birth = rule.birth;
+        header->survive = rule.survive;
+        header->torus = rule.torus;
+        header->published.store(0, std::memory_order_relaxed);
+        for (uint32_t slot = 0; slot < slots; slot++) {
+            new (const_cast<SharedFrame*>(frameAt(header, slot))) SharedFrame();
+        }
+        header->magic.store(SHARED_BOARD_MAGIC, std::memory_order_release);
+    }
+
+    SharedBoardPublisher::~SharedBoardPublisher() {
+        munmap(address, bytes);
+        shm_unlink(name.c_str());
+    }
+
+    void SharedBoardPublisher::publish(const Board& board, uint64_t generation, uint64_t population) {
+        if (board.width != header->width || board.height != header->height) {
+            throw std::runtime_error("a published board keeps the size it started with");
+        }
+        uint64_t index = header->published.load(std::memory_order_relaxed);
+        SharedFrame* frame = const_cast<SharedFrame*>(frameAt(header, index % header->slots));
+        uint64_t sequence = frame->sequence.load(std::memory_order_relaxed);
+        frame->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        frame->generation.store(generation, std::memory_order_relaxed);
+        frame->population.store(population, std::memory_order_relaxed);
+        std::memcpy(const_cast<uint64_t*>(frameWords(frame)), board.words.data(), board.words.size() * sizeof(uint64_t));
+        frame->sequence.store(sequence + 2, std::memory_order_release);
+        header->published.store(index + 1, std::memory_order_release);
+    }
+
+    SharedBoardReader::SharedBoardReader(std::string name) {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            throw std::runtime_error(systemError("shm_open " + name));
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(SharedBoardHeader)) {
+            close(fd);
+            throw std::runtime_error(name + " is not a published board");
+        }
+        bytes = info.st_size;
+        address = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED) {
+            throw std::runtime_error(systemError("mmap " + name));
+        }
+        header = static_cast<const SharedBoardHeader*>(address);
+        if (header->magic.load(std::memory_order_acquire) != SHARED_BOARD_MAGIC
+            || header->version != SHARED_BOARD_VERSION
+            || frameOffset() + header->slots * header->slot_bytes > bytes) {
+            munmap(address, bytes);
+            throw std::runtime_error(name + " is not a published board");
+        }
+    }
+
+    SharedBoardReader::~SharedBoardReader() {
+        munmap(address, bytes);
+    }
+#endif
+
+    bool SharedBoardReader::latest(SharedBoardView& view) const {
+        while (true) {
+            uint64_t published = header->published.load(std::memory_order_acquire);
+            if (published == 0) {
+                return false;
+            }
+            const SharedFrame* frame = frameAt(header, (published - 1) % header->slots);
+            uint64_t sequence = frame->sequence.load(std::memory_order_acquire);
+            if (sequence & 1) {
+                // The writer lapped the ring and is refilling this slot.
+                std::this_thread::yield();
+                continue;
+            }
+            view.generation = frame->generation.load(std::memory_order_relaxed);
+            view.population = frame->population.load(std::memory_order_relaxed);
+            view.words = frameWords(frame);
+            view.frame = frame;
+            view.sequence = sequence;
+            if (valid(view)) {
+                return true;
+            }
+        }
+    }
+
+    bool SharedBoardReader::valid(const SharedBoardView& view) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return view.frame->sequence.load(std::memory_order_relaxed) == view.sequence;
+    }
+
+    bool SharedBoardReader::snapshot(Board& board, uint64_t& generation) const {
+        if (board.width != header->width || board.height != header->height) {
+            createBoard(header->width, header->height, board);
+        }
+        SharedBoardView view;
+        do {
+            if (!latest(view)) {
+                return false;
+            }
+            std::memcpy(board.words.data(), view.words, board.words.size() * sizeof(uint64_t));
+        } while (!valid(view));
+        generation = view.generation;
+        return true;
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef __SHARED__BOARD__HPP__
+#define __SHARED__BOARD__HPP__
+
+#include "board.hpp"
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace game {
+    // Layout of a published board segment, in the writer's byte order.
+    // The header is followed by `slots` frames of slot_bytes each: a
+    // SharedFrame and then the board words, laid out as in Board.
+    struct SharedBoardHeader {
+        // SHARED_BOARD_MAGIC once every other field is set.
+        std::atomic<uint64_t> magic;
+        uint32_t version;
+        uint32_t slots;
+        uint64_t width;
+        uint64_t height;
+        uint64_t words_per_row;
+        uint64_t slot_bytes;
+        uint16_t birth;
+        uint16_t survive;
+        uint8_t torus;
+        // Frames published so far; the newest is in slot (published - 1)
+        // % slots.
+        alignas(64) std::atomic<uint64_t> published;
+    };
+
+    // sequence is odd while the writer fills the frame and goes up by two
+    // per publication, so a reader that sees the same even value before
+    // and after using the frame knows it was not overwritten meanwhile.
+    struct alignas(64) SharedFrame {
+        std::atomic<uint64_t> sequence;
+        std::atomic<uint64_t> generation;
+        std::atomic<uint64_t> population;
+    };
+
+    constexpr uint64_t SHARED_BOARD_MAGIC = 0x314452414F424C47ull;
+    constexpr uint32_t SHARED_BOARD_VERSION = 1;
+
+    // Publishes boards into a POSIX shared memory object as a ring of
+    // seqlocked frames. Publishing is a copy of the words and a few
+    // stores; it never waits for readers.
+    class SharedBoardPublisher {
+    public:
+        // name is a shared memory object name such as "/life". An object
+        // left over under that name is replaced; readers still attached to
+        // it keep the old one.
+        SharedBoardPublisher(std::string name, uint64_t width, uint64_t height, Rule rule, uint32_t slots);
+        ~SharedBoardPublisher();
+
+        SharedBoardPublisher(const SharedBoardPublisher&) = delete;
+        SharedBoardPublisher& operator=(const SharedBoardPublisher&) = delete;
+
+        void publish(const Board& board, uint64_t generation, uint64_t population);
+
+    private:
+        std::string name;
+        void* address = nullptr;
+        size_t bytes = 0;
+        SharedBoardHeader* header = nullptr;
+    };
+
+    // A frame in the segment, read in place. words stays readable but may
+    // be overwritten by the writer once it laps the ring, so check
+    // SharedBoardReader::valid() after using it.
+    struct SharedBoardView {
+        const uint64_t* words = nullptr;
+        uint64_t generation = 0;
+        uint64_t population = 0;
+        const SharedFrame* frame = nullptr;
+        uint64_t sequence = 0;
+    };
+
+    class SharedBoardReader {
+    public:
+        // Maps the object read-only.
+        explicit SharedBoardReader(std::string name);
+        ~SharedBoardReader();
+
+        SharedBoardReader(const SharedBoardReader&) = delete;
+        SharedBoardReader& operator=(const SharedBoardReader&) = delete;
+
+        const SharedBoardHeader& info() const {
+            return *header;
+        }
+
+        // Points view at the newest complete frame; false when nothing has
+        // been published yet.
+        bool latest(SharedBoardView& view) const;
+        bool valid(const SharedBoardView& view) const;
+        // Copies the newest frame into board, retrying until the copy is
+        // consistent, and returns its generation.
+        bool snapshot(Board& board, uint64_t& generation) const;
+
+    private:
+        void* address = nullptr;
+        size_t bytes = 0;
+        const SharedBoardHeader* header = nullptr;
+    };
+}
+
+#endif // __SHARED__BOARD__HPP__
@@ -0,0 +1,225 @@
+#include "simulation.hpp"
+#include "seed.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+
+#include <random>
+#include <stdexcept>
+#include <iostream>
+
+namespace game {
+    Simulation::Simulation(const Options& options, ThreadPool& pool, std::unique_ptr<Engine> custom_engine)
+        : pool(pool), engine(std::move(custom_engine)), detector(options.period_window) {
+        createBoard(options.grid_size, options.grid_size, current);
+        {
+            uint64_t seed = options.seed;
+            if (!options.has_seed) {
+                std::random_device rd;
+                seed = (uint64_t(rd()) << 32) | rd();
+            }
+            std::cerr << "seed " << seed << std::endl;
+            seedSoup(current, options.soup, seed, options.density, pool);
+        }
+        Rule rule;
+        parseRule(options.rule, rule);
+        if (!engine) {
+            createEngine(options.engine, rule, pool, engine, options.engine_log ? &std::cerr : nullptr);
+        }
+        engine->load(current);
+        if (options.history_mb != 0) {
+            history = std::make_unique<History>(options.keyframe_interval, options.history_mb << 20);
+            history->record(current, generation_count);
+        }
+        if (!options.stream.empty()) {
+            stream = std::make_unique<DiffStreamWriter>(options.stream, rule, options.stream_keyframes);
+        }
+        if (!options.publish.empty()) {
+            shared_board = std::make_unique<SharedBoardPublisher>(
+                options.publish, current.width, current.height, rule, options.publish_slots
+            );
+        }
+        emitBoard();
+    }
+
+    void Simulation::emitGeneration() {
+        if (stream) {
+            stream->write(current, generation_count);
+        }
+        if (shared_board) {
+            shared_board->publish(current, generation_count, engine->stats().population);
+        }
+    }
+
+    // For boards that did not come from stepping.
+    void Simulation::emitBoard() {
+        emitGeneration();
+        if (stream) {
+            stream->submit();
+        }
+        reportMetrics();
+    }
+
+    void Simulation::reportMetrics() {
+        using metrics::g_counters;
+        metrics::set(g_counters.generation, generation_count);
+        metrics::set(g_counters.population, engine->stats().population);
+        metrics::set(g_counters.tiles, period_stats.tiles);
+        metrics::set(g_counters.active_tiles, period_stats.tiles - period_stats.settled_tiles);
+        metrics::set(g_counters.engine_bytes, engine->memoryBytes());
+        metrics::set(g_counters.history_bytes, history ? history->memoryBytes() : 0);
+    }
+
+    void Simulation::load(const Board& board) {
+        current = board;
+        engine->load(current);
+        detector.reset();
+        period_stats = PeriodStats();
+        if (history) {
+            history->clear();
+            history->record(current, generation_count);
+        }
+        emitBoard();
+    }
+
+    void Simulation::edit(const std::vector<CellEdit>& edits) {
+        if (edits.empty()) {
+            return;
+        }
+        applyEdits(current, edits);
+        engine->edit(edits);
+        detector.reset();
+        period_stats = PeriodStats();
+        if (history) {
+            history->record(current, generation_count);
+        }
+        emitBoard();
+    }
+
+    void Simulation::rewind(uint64_t generation) {
+        if (!history) {
+            throw std::runtime_error("rewinding needs a history budget");
+        }
+        generation_count = history->restore(generation, current);
+        engine->load(current);
+        detector.reset();
+        period_stats = PeriodStats();
+        emitBoard();
+    }
+
+    bool Simulation::stepBack() {
+        if (!history || history->empty() || generation_count <= history->oldest()) {
+            return false;
+        }
+        rewind(generation_count - 1);
+        return true;
+    }
+
+    void Simulation::step(uint64_t generations) {
+        if (generations == 0) {
+            return;
+        }
+        uint64_t generations_before = generation_count;
+        uint64_t computed_before = computed_generations;
+        if (stream || shared_board) {
+            for (uint64_t g = 0; g < generations; g++) {
+                advance(1);
+                emitGeneration();
+            }
+            if (stream) {
+                stream->submit();
+            }
+        } else {
+            advance(generations);
+        }
+        if (history) {
+            history->record(current, generation_count);
+        }
+        metrics::add(metrics::g_counters.generations, generation_count - generations_before);
+        metrics::add(metrics::g_counters.cell_updates, (computed_generations - computed_before) * current.width * current.height);
+        reportMetrics();
+    }
+
+    void Simulation::advance(uint64_t generations) {
+        if (period_stats.period != 0) {
+            // The board cycles, so only the phase within the cycle matters.
+            uint64_t remainder = generations % period_stats.period;
+            if (remainder != 0) {
+                engine->step(remainder);
+                engine->store(current);
+                computed_generations += remainder;
+            }
+            generation_count += generations;
+            return;
+        }
+        if (detector.window() == 0) {
+            engine->step(generations);
+            engine->store(current);
+            generation_count += generations;
+            computed_generations += generations;
+            return;
+        }
+        for (uint64_t g = 0; g < generations; g++) {
+            if (period_stats.period != 0) {
+                advance(generations - g);
+                return;
+            }
+            stepWatched();
+        }
+    }
+
+    void Simulation::stepWatched() {
+        engine->step(1);
+        engine->store(current);
+        generation_count++;
+        computed_generations++;
+
+        uint64_t period = detector.observe(current, generation_count, pool);
+        period_stats.settled_tiles = detector.settledTiles();
+        period_stats.tiles = detector.tileCount();
+        if (period == 0) {
+            return;
+        }
+
+        // Hashes can collide, so run the candidate period for real and only
+        // trust it if the board comes back unchanged.
+        GAME_TRACE_SCOPE("period confirm");
+        Board probe;
+        engine->step(period);
+        engine->store(probe);
+        if (!(probe == current)) {
+            engine->load(current);
+            return;
+        }
+        period_stats.period = period;
+        period_stats.stabilized_generation = detector.firstRepeat(generation_count, period);
+        period_stats.settled_tiles = period_stats.tiles;
+        std::cerr
+            << "period " << period
+            << " from generation " << period_stats.stabilized_generation
+            << ", fast-forwarding" << std::endl;
+    }
+
+    void Simulation::printStats(std::ostream& os) const {
+        const StepStats& stats = engine->stats();
+        os << "generations " << generation_count
+            << ", computed " << computed_generations
+            << ", population " << stats.population
+            << ", births " << stats.births
+            << ", deaths " << stats.deaths;
+        if (stats.population != 0) {
+            os << ", bounds rows " << stats.min_row << ".." << stats.max_row
+                << " columns " << stats.min_column << ".." << stats.max_column;
+        }
+        if (period_stats.period != 0) {
+            os << ", period " << period_stats.period
+                << " from generation " << period_stats.stabilized_generation;
+        } else if (period_stats.tiles != 0) {
+            os << ", settled tiles " << period_stats.settled_tiles << "/" << period_stats.tiles;
+        }
+        if (history && !history->empty()) {
+            os << ", history " << history->oldest() << ".." << history->newest()
+                << " in " << (history->memoryBytes() >> 10) << " KiB";
+        }
+        os << std::endl;
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef __SIMULATION__HPP__
+#define __SIMULATION__HPP__
+
+#include "board.hpp"
+#include "diff_stream.hpp"
+#include "engine.hpp"
+#include "history.hpp"
+#include "period.hpp"
+#include "options.hpp"
+#include "shared_board.hpp"
+#include "thread_pool.hpp"
+
+#include <memory>
+#include <ostream>
+
+namespace game {
+    // Owns the board and engine described by the options. With a period
+    // window set, the simulation watches for the board repeating and, once
+    // a period is confirmed, steps only the remainder of each request.
+    // With a history budget set, every stepped-to generation is recorded
+    // and can be rewound to. With a stream or a shared memory name set,
+    // every generation is written or published, so batches are then
+    // stepped one generation at a time.
+    class Simulation {
+    public:
+        // Engines that need more than a rule and a pool, like the GPU one,
+        // are created by the caller and passed in instead of options.engine.
+        Simulation(const Options& options, ThreadPool& pool, std::unique_ptr<Engine> custom_engine = nullptr);
+
+        // Runs the generations as one batch and stores only the final
+        // state into board().
+        void step(uint64_t generations);
+        void load(const Board& board);
+        // Changes cells of the current generation in place. Period
+        // detection starts over, and the recorded history, if any, takes
+        // the edited board as this generation.
+        void edit(const std::vector<CellEdit>& edits);
+        // Goes back to the newest recorded generation <= generation.
+        // Stepping afterwards replaces the recorded future.
+        void rewind(uint64_t generation);
+        // Goes back to the recorded generation before the current one, and
+        // returns false when there is none.
+        bool stepBack();
+        void printStats(std::ostream& os) const;
+
+        const Board& board() const {
+            return current;
+        }
+
+        uint64_t generation() const {
+            return generation_count;
+        }
+
+        // Population, births, deaths and bounding box of the latest
+        // generation, as counted by the engine while stepping.
+        const StepStats& stepStats() const {
+            return engine->stats();
+        }
+
+        const PeriodStats& periodStats() const {
+            return period_stats;
+        }
+
+    private:
+        void advance(uint64_t generations);
+        void stepWatched();
+        void emitGeneration();
+        void emitBoard();
+        void reportMetrics();
+
+        ThreadPool& pool;
+        Board current;
+        std::unique_ptr<Engine> engine;
+        PeriodDetector detector;
+        PeriodStats period_stats;
+        std::unique_ptr<History> history;
+        std::unique_ptr<DiffStreamWriter> stream;
+        std::unique_ptr<SharedBoardPublisher> shared_board;
+        uint64_t generation_count = 0;
+        uint64_t computed_generations = 0;
+    };
+}
+
+#endif // __SIMULATION__HPP__
@@ -0,0 +1,139 @@
+#include "thread_pool.hpp"
+#include "trace.hpp"
+
+#include <string>
+
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#endif
+
+namespace game {
+    namespace {
+        void band(uint64_t count, uint32_t bands, uint32_t index, uint64_t& begin, uint64_t& end) {
+            begin = count * index / bands;
+            end = count * (index + 1) / bands;
+        }
+
+        // CPUs this process may use, in order. Empty where affinity isn't
+        // supported, which turns pinning into a no-op.
+        std::vector<int> allowedCpus() {
+            std::vector<int> cpus;
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+                for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                    if (CPU_ISSET(cpu, &set)) {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+#endif
+            return cpus;
+        }
+
+        void pinCurrentThread(int cpu) {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+            (void)cpu;
+#endif
+        }
+    }
+
+    ThreadPool::ThreadPool(uint32_t thread_count, bool pin_threads) : thread_count(thread_count == 0 ? defaultThreadCount() : thread_count) {
+        if (pin_threads) {
+            cpus = allowedCpus();
+            if (!cpus.empty()) {
+                pinCurrentThread(cpus[0]);
+            }
+        }
+        for (uint32_t i = 1; i < this->thread_count; i++) {
+            threads.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_ready.notify_all();
+        for (std::thread& t : threads) {
+            t.join();
+        }
+    }
+
+    void ThreadPool::parallelFor(uint64_t count, const Task& task) {
+        if (thread_count == 1 || count < 2) {
+            GAME_TRACE_SCOPE("task");
+            task(0, count, 0);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current_task = &task;
+            current_count = count;
+            pending = thread_count - 1;
+            generation++;
+        }
+        work_ready.notify_all();
+
+        {
+            GAME_TRACE_SCOPE("task");
+            uint64_t begin, end;
+            band(count, thread_count, 0, begin, end);
+            task(begin, end, 0);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        work_done.wait(lock, [this] { return pending == 0; });
+        current_task = nullptr;
+    }
+
+    void ThreadPool::workerLoop(uint32_t worker) {
+        trace::setThreadName("worker " + std::to_string(worker));
+        if (!cpus.empty()) {
+            pinCurrentThread(cpus[worker % cpus.size()]);
+        }
+        uint64_t seen_generation = 0;
+        while (true) {
+            const Task* task;
+            uint64_t count;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work_ready.wait(lock, [&] { return stopping || generation != seen_generation; });
+                if (stopping) {
+                    return;
+                }
+                seen_generation = generation;
+                task = current_task;
+                count = current_count;
+            }
+
+            {
+                GAME_TRACE_SCOPE("task");
+                uint64_t begin, end;
+                band(count, thread_count, worker, begin, end);
+                if (begin < end) {
+                    (*task)(begin, end, worker);
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending--;
+            }
+            work_done.notify_one();
+        }
+    }
+
+    uint32_t defaultThreadCount() {
+        uint32_t count = std::thread::hardware_concurrency();
+        return count == 0 ? 1 : count;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef __THREAD__POOL__HPP__
+#define __THREAD__POOL__HPP__
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+namespace game {
+    // Fixed set of workers that split a range into one contiguous band per
+    // worker. The calling thread runs band 0, so a pool of size 1 spawns no
+    // threads at all. A thread count of 0 uses every hardware thread.
+    //
+    // With pin_threads, worker i (the calling thread for i = 0) is bound to
+    // the i-th CPU the process may run on, so a band keeps running next to
+    // the memory it first touched.
+    class ThreadPool {
+    public:
+        using Task = std::function<void(uint64_t begin, uint64_t end, uint32_t worker)>;
+
+        explicit ThreadPool(uint32_t thread_count, bool pin_threads = false);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        uint32_t size() const {
+            return thread_count;
+        }
+
+        void parallelFor(uint64_t count, const Task& task);
+
+    private:
+        void workerLoop(uint32_t worker);
+
+        uint32_t thread_count;
+        std::vector<int> cpus;
+        std::vector<std::thread> threads;
+
+        std::mutex mutex;
+        std::condition_variable work_ready;
+        std::condition_variable work_done;
+        const Task* current_task = nullptr;
+        uint64_t current_count = 0;
+        uint64_t generation = 0;
+        uint32_t pending = 0;
+        bool stopping = false;
+    };
+
+    uint32_t defaultThreadCount();
+}
+
+#endif // __THREAD__POOL__HPP__
@@ -0,0 +1,184 @@
+#include "engine.hpp"
+#include "kernels.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace game {
+    namespace {
+        // Temporal blocking: each tile is copied together with a halo of
+        // `depth` rows and one word of columns into a small cache resident
+        // buffer, advanced `depth` generations there, and only the interior
+        // (which is still exact) is written back. Main memory is streamed
+        // once per `depth` generations instead of once per generation.
+        class TiledEngine : public Engine {
+        public:
+            static constexpr uint64_t TILE_ROWS = 128;
+            static constexpr uint64_t TILE_WORDS = 16;
+
+            TiledEngine(Rule rule, ThreadPool& pool, uint32_t depth) : rule(rule), pool(pool), depth(depth), scratch(pool.size()), worker_stats(pool.size()) {
+                if (depth == 0 || depth > 64) {
+                    throw std::runtime_error("tiled engine depth must be within [1, 64]");
+                }
+            }
+
+            const char* name() const override {
+                return "tiled";
+            }
+
+            void load(const Board& board) override {
+                copyBoard(board, current, pool);
+                createBoard(board.width, board.height, next);
+                step_stats = boardStats(board);
+            }
+
+            void store(Board& board) const override {
+                board = current;
+            }
+
+            void edit(const std::vector<CellEdit>& edits) override {
+                applyEdits(current, edits, &step_stats);
+            }
+
+            void step(uint64_t generations) override {
+                while (generations > 0) {
+                    uint32_t pass = static_cast<uint32_t>(std::min<uint64_t>(generations, depth));
+                    GAME_TRACE_SCOPE("tiled pass");
+                    bool last = pass == generations;
+                    if (last) {
+                        std::fill(worker_stats.begin(), worker_stats.end(), StepStats());
+                    }
+                    uint64_t tile_rows = (current.height + TILE_ROWS - 1) / TILE_ROWS;
+                    uint64_t tile_columns = (current.words_per_row + TILE_WORDS - 1) / TILE_WORDS;
+                    pool.parallelFor(tile_rows * tile_columns, [this, pass, last, tile_columns](uint64_t begin, uint64_t end, uint32_t worker) {
+                        StepStats* stats = last ? &worker_stats[worker] : nullptr;
+                        for (uint64_t t = begin; t < end; t++) {
+                            advanceTile((t / tile_columns) * TILE_ROWS, (t % tile_columns) * TILE_WORDS, pass, scratch[worker], stats);
+                        }
+                    });
+                    std::swap(current, next);
+                    generations -= pass;
+                    if (last) {
+                        step_stats = StepStats();
+                        for (auto& s : worker_stats) {
+                            step_stats.merge(s);
+                        }
+                    }
+                }
+            }
+
+            uint64_t memoryBytes() const override {
+                uint64_t scratch_bytes = 0;
+                for (auto& s : scratch) {
+                    scratch_bytes += (s.a.size() + s.b.size()) * sizeof(uint64_t);
+                }
+                return (current.words.size() + next.words.size()) * sizeof(uint64_t) + scratch_bytes;
+            }
+
+        private:
+            struct Scratch {
+                std::vector<uint64_t> a;
+                std::vector<uint64_t> b;
+            };
+
+            void advanceTile(uint64_t row, uint64_t word, uint32_t pass, Scratch& s, StepStats* stats) {
+                uint64_t rows = std::min(TILE_ROWS, current.height - row);
+                uint64_t words = std::min(TILE_WORDS, current.words_per_row - word);
+                // Local coordinates: local row 0 is board row `row - pass`,
+                // local word 0 is board word `word - 1`.
+                uint64_t local_rows = rows + 2 * pass;
+                uint64_t local_words = words + 2;
+                s.a.assign(local_rows * local_words, 0);
+                s.b.assign(local_rows * local_words, 0);
+
+                for (uint64_t li = 0; li < local_rows; li++) {
+                    int64_t i = int64_t(row + li) - pass;
+                    if (i < 0 || uint64_t(i) >= current.height) {
+                        continue;
+                    }
+                    for (uint64_t lw = 0; lw < local_words; lw++) {
+                        int64_t w = int64_t(word + lw) - 1;
+                        if (w >= 0 && uint64_t(w) < current.words_per_row) {
+                            s.a[li * local_words + lw] = current.row(i)[w];
+                        }
+                    }
+                }
+
+                uint64_t* src = s.a.data();
+                uint64_t* dst = s.b.data();
+                // Generation g only needs rows that are still exact afterwards,
+                // so the computed band shrinks by one row per side each time.
+                for (uint32_t g = 0; g < pass; g++) {
+                    for (uint64_t li = g + 1; li + g + 1 < local_rows; li++) {
+                        stepRow(
+                            src + (li - 1) * local_words,
+                            src + li * local_words,
+                            src + (li + 1) * local_words,
+                            dst + li * local_words,
+                            local_words,
+                            ~uint64_t(0),
+                            rule
+                        );
+                    }
+                    clampToBoard(dst, row, word, pass, local_rows, local_words);
+                    std::swap(src, dst);
+                }
+
+                // src holds the final generation and dst the one before it,
+                // both still in cache, so counting here costs no extra
+                // trip to memory.
+                for (uint64_t r = 0; r < rows; r++) {
+                    if (stats) {
+                        const uint64_t* before = dst + (r + pass) * local_words + 1;
+                        const uint64_t* after = src + (r + pass) * local_words + 1;
+                        for (uint64_t w = 0; w < words; w++) {
+                            stats->addWord(row + r, word + w, before[w], after[w]);
+                        }
+                    }
+                    std::copy(
+                        src + (r + pass) * local_words + 1,
+                        src + (r + pass) * local_words + 1 + words,
+                        next.row(row + r) + word
+                    );
+                }
+            }
+
+            // Cells outside the board never come alive, whatever the halo
+            // computes for them.
+            void clampToBoard(uint64_t* local, uint64_t row, uint64_t word, uint32_t pass, uint64_t local_rows, uint64_t local_words) {
+                for (uint64_t li = 0; li < local_rows; li++) {
+                    int64_t i = int64_t(row + li) - pass;
+                    uint64_t* local_row = local + li * local_words;
+                    if (i < 0 || uint64_t(i) >= current.height) {
+                        std::fill(local_row, local_row + local_words, 0);
+                        continue;
+                    }
+                    if (word == 0) {
+                        local_row[0] = 0;
+                    }
+                    for (uint64_t lw = 1; lw < local_words; lw++) {
+                        uint64_t w = word + lw - 1;
+                        if (w + 1 == current.words_per_row) {
+                            local_row[lw] &= current.lastWordMask();
+                        } else if (w >= current.words_per_row) {
+                            local_row[lw] = 0;
+                        }
+                    }
+                }
+            }
+
+            Rule rule;
+            ThreadPool& pool;
+            uint32_t depth;
+            std::vector<Scratch> scratch;
+            std::vector<StepStats> worker_stats;
+            Board current;
+            Board next;
+        };
+    }
+
+    void createTiledEngine(Rule rule, ThreadPool& pool, uint32_t depth, std::unique_ptr<Engine>& engine) {
+        engine = std::make_unique<TiledEngine>(rule, pool, depth);
+    }
+}
@@ -0,0 +1,117 @@
+#include "trace.hpp"
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace game {
+    namespace trace {
+        std::atomic<bool> g_enabled { false };
+
+        namespace {
+            struct ThreadBuffer {
+                uint32_t tid;
+                std::string name;
+                std::unique_ptr<std::array<Event, RING_CAPACITY>> events;
+                std::atomic<uint64_t> head { 0 };
+            };
+
+            std::mutex g_registry_mutex;
+            std::vector<std::unique_ptr<ThreadBuffer>> g_registry;
+            std::string g_path;
+            uint64_t g_start_ns = 0;
+
+            thread_local ThreadBuffer* t_buffer = nullptr;
+
+            ThreadBuffer* threadBuffer() {
+                if (t_buffer == nullptr) {
+                    std::lock_guard<std::mutex> lock(g_registry_mutex);
+                    std::unique_ptr<ThreadBuffer> buffer = std::make_unique<ThreadBuffer>();
+                    buffer->tid = g_registry.size() + 1;
+                    buffer->name = buffer->tid == 1 ? "main" : "thread " + std::to_string(buffer->tid);
+                    buffer->events = std::make_unique<std::array<Event, RING_CAPACITY>>();
+                    t_buffer = buffer.get();
+                    g_registry.push_back(std::move(buffer));
+                }
+                return t_buffer;
+            }
+
+            void writeEscaped(std::ostream& os, const std::string& s) {
+                for (char c : s) {
+                    if (c == '"' || c == '\\') {
+                        os << '\\';
+                    }
+                    os << c;
+                }
+            }
+        }
+
+        void enable(std::string path) {
+            g_path = path;
+            g_start_ns = now();
+            g_enabled.store(true, std::memory_order_relaxed);
+            setThreadName("main");
+        }
+
+        void setThreadName(std::string name) {
+            if (!enabled()) {
+                return;
+            }
+            ThreadBuffer* buffer = threadBuffer();
+            std::lock_guard<std::mutex> lock(g_registry_mutex);
+            buffer->name = name;
+        }
+
+        uint64_t now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()
+            ).count();
+        }
+
+        void record(const char* name, uint64_t begin_ns, uint64_t end_ns) {
+            ThreadBuffer* buffer = threadBuffer();
+            uint64_t head = buffer->head.load(std::memory_order_relaxed);
+            (*buffer->events)[head & (RING_CAPACITY - 1)] = Event { name, begin_ns, end_ns };
+            buffer->head.store(head + 1, std::memory_order_release);
+        }
+
+        void dump() {
+            if (!enabled()) {
+                return;
+            }
+            g_enabled.store(false, std::memory_order_relaxed);
+
+            std::ofstream out(g_path, std::ios::out | std::ios::trunc);
+            if (!out.is_open()) {
+                throw std::runtime_error("couldn't open trace file " + g_path);
+            }
+            out << std::fixed << std::setprecision(3);
+            out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+            std::lock_guard<std::mutex> lock(g_registry_mutex);
+            bool first = true;
+            for (auto& buffer : g_registry) {
+                out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                    << ",\"args\":{\"name\":\"";
+                writeEscaped(out, buffer->name);
+                out << "\"}}";
+                first = false;
+
+                uint64_t head = buffer->head.load(std::memory_order_acquire);
+                uint64_t begin = head > RING_CAPACITY ? head - RING_CAPACITY : 0;
+                for (uint64_t i = begin; i < head; i++) {
+                    const Event& e = (*buffer->events)[i & (RING_CAPACITY - 1)];
+                    out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                        << ",\"ts\":" << (e.begin_ns - g_start_ns) / 1000.
+                        << ",\"dur\":" << (e.end_ns - e.begin_ns) / 1000. << "}";
+                }
+            }
+            out << "\n]}\n";
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef __TRACE__HPP__
+#define __TRACE__HPP__
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+#define GAME_TRACE_CONCAT_INNER(a, b) a##b
+#define GAME_TRACE_CONCAT(a, b) GAME_TRACE_CONCAT_INNER(a, b)
+#define GAME_TRACE_SCOPE(name) game::trace::Scope GAME_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+namespace game {
+    namespace trace {
+        // Events are kept in a per-thread ring of this many entries, older
+        // events are overwritten once it wraps.
+        constexpr uint64_t RING_CAPACITY = 1 << 16;
+
+        struct Event {
+            const char* name;
+            uint64_t begin_ns;
+            uint64_t end_ns;
+        };
+
+        extern std::atomic<bool> g_enabled;
+
+        inline bool enabled() {
+            return g_enabled.load(std::memory_order_relaxed);
+        }
+
+        void enable(std::string path);
+        void setThreadName(std::string name);
+        uint64_t now();
+        void record(const char* name, uint64_t begin_ns, uint64_t end_ns);
+        // Writes every ring to the trace file and turns tracing off. The
+        // rings are read without locking, so call it only after all other
+        // threads that may record events have been joined.
+        void dump();
+
+        class Scope {
+        public:
+            explicit Scope(const char* name) : name(name), begin_ns(0) {
+                if (enabled()) {
+                    begin_ns = now();
+                }
+            }
+
+            ~Scope() {
+                if (begin_ns != 0) {
+                    record(name, begin_ns, now());
+                }
+            }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            const char* name;
+            uint64_t begin_ns;
+        };
+    }
+}
+
+#endif // __TRACE__HPP__
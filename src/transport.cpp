@@ -0,0 +1,249 @@
+#include "transport.hpp"
+
+#include <atomic>
+#include <thread>
+#include <cerrno>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+
+namespace game {
+    namespace {
+        std::string systemError(std::string what) {
+            return what + ": " + std::strerror(errno);
+        }
+
+        class SocketChannel : public Channel {
+        public:
+            explicit SocketChannel(int fd) : fd(fd) {}
+
+            ~SocketChannel() override {
+                close(fd);
+            }
+
+            void send(const void* data, size_t bytes) override {
+                const char* p = static_cast<const char*>(data);
+                while (bytes > 0) {
+                    ssize_t written = ::send(fd, p, bytes, MSG_NOSIGNAL);
+                    if (written < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        throw std::runtime_error(systemError("socket send"));
+                    }
+                    p += written;
+                    bytes -= written;
+                }
+            }
+
+            void receive(void* data, size_t bytes) override {
+                char* p = static_cast<char*>(data);
+                while (bytes > 0) {
+                    ssize_t read = ::recv(fd, p, bytes, 0);
+                    if (read < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (read <= 0) {
+                        throw std::runtime_error(read == 0 ? "socket closed by peer" : systemError("socket receive"));
+                    }
+                    p += read;
+                    bytes -= read;
+                }
+            }
+
+        private:
+            int fd;
+        };
+
+        // An exited process that was not reaped yet still takes signals,
+        // so zombies are looked for too: with waitid for children and in
+        // /proc for the siblings of cluster workers.
+        bool processAlive(pid_t pid) {
+            if (kill(pid, 0) != 0 && errno == ESRCH) {
+                return false;
+            }
+            siginfo_t info = {};
+            if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid) {
+                return false;
+            }
+#ifdef __linux__
+            std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+            std::string line;
+            if (std::getline(stat, line)) {
+                size_t name_end = line.rfind(')');
+                if (name_end != std::string::npos && name_end + 2 < line.size()) {
+                    char state = line[name_end + 2];
+                    return state != 'Z' && state != 'X';
+                }
+            }
+#endif
+            return true;
+        }
+
+        // One direction of a shared memory channel. head and tail count
+        // bytes ever written and read, the data wraps around capacity.
+        // writer is the process attached to the sending end, 0 until one
+        // attaches.
+        struct Ring {
+            std::atomic<uint64_t> head;
+            std::atomic<uint64_t> tail;
+            std::atomic<int64_t> writer;
+        };
+
+        struct SharedMapping {
+            void* address;
+            size_t bytes;
+
+            SharedMapping(void* address, size_t bytes) : address(address), bytes(bytes) {}
+            SharedMapping(const SharedMapping&) = delete;
+            SharedMapping& operator=(const SharedMapping&) = delete;
+
+            ~SharedMapping() {
+                munmap(address, bytes);
+            }
+        };
+
+        // Both ends wait by spinning with yields: halo messages are small and
+        // the peer is usually about to answer, so sleeping in the kernel
+        // would mostly add latency. Every CHECK_SPINS spins a waiting end
+        // makes sure the attached peer process still exists.
+        class SharedMemoryChannel : public Channel {
+        public:
+            static constexpr uint64_t CHECK_SPINS = 4096;
+
+            SharedMemoryChannel(std::shared_ptr<SharedMapping> mapping, Ring* out, Ring* in, size_t capacity)
+                : mapping(mapping), out(out), in(in), capacity(capacity) {}
+
+            void attach() override {
+                out->writer.store(getpid(), std::memory_order_relaxed);
+            }
+
+            void send(const void* data, size_t bytes) override {
+                const char* p = static_cast<const char*>(data);
+                char* ring = reinterpret_cast<char*>(out + 1);
+                uint64_t head = out->head.load(std::memory_order_relaxed);
+                uint64_t spins = 0;
+                while (bytes > 0) {
+                    uint64_t space = capacity - (head - out->tail.load(std::memory_order_acquire));
+                    if (space == 0) {
+                        wait(spins);
+                        continue;
+                    }
+                    size_t offset = head % capacity;
+                    size_t chunk = std::min<size_t>({ bytes, space, capacity - offset });
+                    std::memcpy(ring + offset, p, chunk);
+                    head += chunk;
+                    out->head.store(head, std::memory_order_release);
+                    p += chunk;
+                    bytes -= chunk;
+                }
+            }
+
+            void receive(void* data, size_t bytes) override {
+                char* p = static_cast<char*>(data);
+                const char* ring = reinterpret_cast<const char*>(in + 1);
+                uint64_t tail = in->tail.load(std::memory_order_relaxed);
+                uint64_t spins = 0;
+                while (bytes > 0) {
+                    uint64_t available = in->head.load(std::memory_order_acquire) - tail;
+                    if (available == 0) {
+                        wait(spins);
+                        continue;
+                    }
+                    size_t offset = tail % capacity;
+                    size_t chunk = std::min<size_t>({ bytes, available, capacity - offset });
+                    std::memcpy(p, ring + offset, chunk);
+                    tail += chunk;
+                    in->tail.store(tail, std::memory_order_release);
+                    p += chunk;
+                    bytes -= chunk;
+                }
+            }
+
+        private:
+            void wait(uint64_t& spins) {
+                if (++spins % CHECK_SPINS == 0) {
+                    pid_t peer = pid_t(in->writer.load(std::memory_order_relaxed));
+                    if (peer != 0 && !processAlive(peer)) {
+                        throw std::runtime_error("shared memory peer " + std::to_string(peer) + " exited");
+                    }
+                }
+                std::this_thread::yield();
+            }
+
+            std::shared_ptr<SharedMapping> mapping;
+            Ring* out;
+            Ring* in;
+            size_t capacity;
+        };
+
+        void createSocketPair(std::unique_ptr<Channel>& first, std::unique_ptr<Channel>& second) {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+                throw std::runtime_error(systemError("socketpair"));
+            }
+            first = std::make_unique<SocketChannel>(fds[0]);
+            second = std::make_unique<SocketChannel>(fds[1]);
+        }
+
+        // The object is unlinked as soon as it is mapped: the mapping is
+        // inherited across fork and disappears with the last process.
+        void createSharedMemoryPair(size_t capacity, std::unique_ptr<Channel>& first, std::unique_ptr<Channel>& second) {
+            static std::atomic<uint32_t> counter { 0 };
+            std::string name = "/game-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+            int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd < 0) {
+                throw std::runtime_error(systemError("shm_open " + name));
+            }
+            shm_unlink(name.c_str());
+
+            size_t ring_bytes = (sizeof(Ring) + capacity + 63) / 64 * 64;
+            size_t bytes = 2 * ring_bytes;
+            if (ftruncate(fd, bytes) != 0) {
+                close(fd);
+                throw std::runtime_error(systemError("ftruncate " + name));
+            }
+            void* address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (address == MAP_FAILED) {
+                throw std::runtime_error(systemError("mmap " + name));
+            }
+            auto mapping = std::make_shared<SharedMapping>(address, bytes);
+
+            Ring* a = new (address) Ring { { 0 }, { 0 }, { 0 } };
+            Ring* b = new (static_cast<char*>(address) + ring_bytes) Ring { { 0 }, { 0 }, { 0 } };
+            first = std::make_unique<SharedMemoryChannel>(mapping, a, b, capacity);
+            second = std::make_unique<SharedMemoryChannel>(mapping, b, a, capacity);
+        }
+    }
+
+    std::vector<std::string> transportNames() {
+        return { "socket", "shm" };
+    }
+
+    void createChannelPair(
+        std::string transport,
+        size_t capacity,
+        std::unique_ptr<Channel>& first,
+        std::unique_ptr<Channel>& second
+    ) {
+        if (transport == "socket") {
+            createSocketPair(first, second);
+        } else if (transport == "shm") {
+            if (capacity == 0) {
+                throw std::runtime_error("shared memory channels need a capacity");
+            }
+            createSharedMemoryPair(capacity, first, second);
+        } else {
+            throw std::runtime_error("unknown transport " + transport);
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef __TRANSPORT__HPP__
+#define __TRANSPORT__HPP__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace game {
+    // A blocking, ordered, point to point byte stream between two
+    // processes. Both ends are created up front in one process and handed
+    // to the processes that use them, so a backend only has to provide
+    // the pair factory and the two calls below.
+    class Channel {
+    public:
+        virtual ~Channel() = default;
+
+        virtual void send(const void* data, size_t bytes) = 0;
+        virtual void receive(void* data, size_t bytes) = 0;
+
+        // Called in the process that uses this end, before its first send
+        // or receive. A peer waiting on the other end can then throw once
+        // that process is gone instead of waiting forever.
+        virtual void attach() {}
+    };
+
+    std::vector<std::string> transportNames();
+    // "socket" connects the ends with a Unix domain socket pair, "shm" with
+    // two single producer rings of `capacity` bytes in POSIX shared memory.
+    void createChannelPair(
+        std::string transport,
+        size_t capacity,
+        std::unique_ptr<Channel>& first,
+        std::unique_ptr<Channel>& second
+    );
+}
+
+#endif // __TRANSPORT__HPP__
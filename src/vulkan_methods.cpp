@@ -1,7 +1,11 @@
 #include "vulkan_methods.hpp"
 
+#include <limits>
+#include <cassert>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <stdexcept>
 
 std::ostream& operator<<(std::ostream& os, vk::DebugUtilsMessageSeverityFlagsEXT flags) {
     if (flags & vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose) {
@@ -51,7 +55,8 @@ namespace game {
     void createInstance(
         vk::Instance& instance,
         vk::DispatchLoaderDynamic& dispatcher,
-        vk::DebugUtilsMessengerEXT& debug_utils
+        vk::DebugUtilsMessengerEXT& debug_utils,
+        bool headless
     ) {
         vk::DebugUtilsMessengerCreateInfoEXT debug_utils_info = vk::DebugUtilsMessengerCreateInfoEXT()
             .setMessageSeverity(
@@ -65,9 +70,14 @@ namespace game {
             )
             .setPfnUserCallback(vkDebugUtilsMessengerCallbackEXT);
 
-        std::vector<const char*> layers = { "VK_LAYER_KHRONOS_validation" };
+        std::vector<const char*> layers;
+        for (auto& layer : vk::enumerateInstanceLayerProperties()) {
+            if (std::string(layer.layerName.data()) == "VK_LAYER_KHRONOS_validation") {
+                layers.push_back("VK_LAYER_KHRONOS_validation");
+            }
+        }
         std::vector<const char*> extensions = { VK_EXT_DEBUG_UTILS_EXTENSION_NAME };
-        {
+        if (!headless) {
             uint32_t count;
             const char** exts = glfwGetRequiredInstanceExtensions(&count);
             for (uint32_t i = 0; i < count; i++) {
@@ -75,7 +85,12 @@ namespace game {
             }
         }
 
+        // 1.1 where the loader has it, for subgroup operations in compute.
+        vk::ApplicationInfo app_info = vk::ApplicationInfo()
+            .setApiVersion(std::min<uint32_t>(vk::enumerateInstanceVersion(), VK_API_VERSION_1_1));
+
         vk::InstanceCreateInfo instance_info = vk::InstanceCreateInfo()
+            .setPApplicationInfo(&app_info)
             .setEnabledLayerCount(layers.size())
             .setPpEnabledLayerNames(layers.data())
             .setEnabledExtensionCount(extensions.size())
@@ -108,7 +123,7 @@ namespace game {
         for (uint32_t i = 0; i < queue_families.size(); i++) {
             vk::QueueFamilyProperties& qf = queue_families[i];
             bool is_graphics = qf.queueCount > 0 ? bool(qf.queueFlags & vk::QueueFlagBits::eGraphics) : false;
-            bool is_present = qf.queueCount > 0 ? bool(physical_device.getSurfaceSupportKHR(i, surface, dispatcher)) : false;
+            bool is_present = qf.queueCount > 0 && surface ? bool(physical_device.getSurfaceSupportKHR(i, surface, dispatcher)) : false;
             bool is_compute = qf.queueCount > 0 ? bool(qf.queueFlags & vk::QueueFlagBits::eCompute) : false;
 
             if (is_graphics && is_present && is_compute) {
@@ -122,7 +137,20 @@ namespace game {
             if (is_compute && !compute_queue.index.has_value()) compute_queue.index = i;
         }
 
-        std::vector<const char*> extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+        // Without a surface nothing is presented, the present queue just
+        // aliases the graphics one.
+        std::vector<const char*> extensions;
+        if (surface) {
+            extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        } else {
+            for (uint32_t i = 0; i < queue_families.size(); i++) {
+                if (queue_families[i].queueCount > 0 && (queue_families[i].queueFlags & vk::QueueFlagBits::eGraphics)) {
+                    graphics_queue.index = i;
+                    break;
+                }
+            }
+            present_queue.index = graphics_queue.index;
+        }
         std::vector<vk::DeviceQueueCreateInfo> queue_infos;
         std::set<uint32_t> unique_queue_indexes = {
             graphics_queue.index.value(),
@@ -155,6 +183,38 @@ namespace game {
         compute_queue.queue = device.getQueue(compute_queue.index.value(), 0);
     }
 
+    vk::PresentModeKHR choosePresentMode(
+        vk::PhysicalDevice physical_device,
+        vk::SurfaceKHR surface,
+        vk::DispatchLoaderDynamic dispatcher,
+        std::string policy
+    ) {
+        // Mailbox and immediate both avoid blocking on vblank, so each is
+        // the other's closest substitute.
+        std::vector<vk::PresentModeKHR> preference;
+        if (policy == "mailbox") {
+            preference = { vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eImmediate };
+        } else if (policy == "immediate") {
+            preference = { vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox };
+        } else if (policy != "fifo") {
+            throw std::runtime_error("present mode must be fifo, mailbox or immediate");
+        }
+
+        auto supported = physical_device.getSurfacePresentModesKHR(surface, dispatcher);
+        for (vk::PresentModeKHR mode : preference) {
+            if (std::find(supported.begin(), supported.end(), mode) != supported.end()) {
+                if (mode != preference.front()) {
+                    std::cerr << policy << " present mode unsupported, using " << vk::to_string(mode) << std::endl;
+                }
+                return mode;
+            }
+        }
+        if (!preference.empty()) {
+            std::cerr << policy << " present mode unsupported, using fifo" << std::endl;
+        }
+        return vk::PresentModeKHR::eFifo;
+    }
+
     void createSwapchain(
         vk::PhysicalDevice physical_device,
         vk::Device device,
@@ -162,6 +222,7 @@ namespace game {
         vk::Extent2D image_extent,
         vk::DispatchLoaderDynamic dispatcher,
         std::set<uint32_t> queue_indexes,
+        vk::PresentModeKHR present_mode,
         vk::SurfaceFormatKHR& surface_format,
         vk::SwapchainKHR& swapchain
     ) {
@@ -194,7 +255,7 @@ namespace game {
         swapchain_info
             .setPreTransform(vk::SurfaceTransformFlagBitsKHR::eIdentity)
             .setCompositeAlpha(vk::CompositeAlphaFlagBitsKHR::eOpaque)
-            .setPresentMode(vk::PresentModeKHR::eFifo)
+            .setPresentMode(present_mode)
             .setClipped(VK_TRUE);
 
         swapchain = device.createSwapchainKHR(swapchain_info, nullptr, dispatcher);
@@ -362,9 +423,193 @@ namespace game {
         device_memory = device.allocateMemory(memory_info);
     }
 
+    void createCellChunks(
+        vk::Device device,
+        vk::PhysicalDevice physical_device,
+        uint64_t grid_size,
+        std::set<uint32_t> queue_indexes,
+        std::vector<CellChunk>& cell_chunks
+    ) {
+        const vk::DeviceSize max_chunk_bytes = vk::DeviceSize(1) << 30;
+        uint64_t max_instances = std::min<uint64_t>(
+            physical_device.getProperties().limits.maxDrawIndexedIndexValue,
+            std::numeric_limits<uint32_t>::max()
+        );
+        uint64_t row_bytes = grid_size * sizeof(Cell);
+        uint64_t rows_per_chunk = std::min(max_chunk_bytes / row_bytes, max_instances / grid_size);
+        if (rows_per_chunk == 0) {
+            throw std::runtime_error("grid_size too large for a single row per chunk");
+        }
+
+        cell_chunks.clear();
+        for (uint64_t first_row = 0; first_row < grid_size; first_row += rows_per_chunk) {
+            CellChunk chunk;
+            chunk.first_row = first_row;
+            chunk.rows = std::min(rows_per_chunk, grid_size - first_row);
+            createBuffer(
+                device,
+                chunk.rows * row_bytes,
+                queue_indexes,
+                vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+                chunk.buffer.buffer
+            );
+            chunk.buffer.mem_reqs = device.getBufferMemoryRequirements(chunk.buffer.buffer);
+            chunk.buffer.offset = 0;
+            uint32_t memory_type_index = findMemoryType(
+                physical_device,
+                chunk.buffer.mem_reqs.memoryTypeBits,
+                vk::MemoryPropertyFlagBits::eHostVisible,
+                vk::MemoryPropertyFlagBits::eDeviceLocal
+            );
+            vk::MemoryAllocateInfo memory_info = vk::MemoryAllocateInfo()
+                .setAllocationSize(chunk.buffer.mem_reqs.size)
+                .setMemoryTypeIndex(memory_type_index);
+            chunk.memory = device.allocateMemory(memory_info);
+            device.bindBufferMemory(chunk.buffer.buffer, chunk.memory, 0);
+            chunk.mapped = static_cast<Cell*>(device.mapMemory(chunk.memory, 0, VK_WHOLE_SIZE));
+            bool coherent = bool(
+                physical_device.getMemoryProperties().memoryTypes[memory_type_index].propertyFlags
+                & vk::MemoryPropertyFlagBits::eHostCoherent
+            );
+            chunk.flush_atom = coherent ? 0 : physical_device.getProperties().limits.nonCoherentAtomSize;
+            cell_chunks.push_back(chunk);
+        }
+    }
+
+    void destroyCellChunks(vk::Device device, std::vector<CellChunk>& cell_chunks) {
+        for (CellChunk& chunk : cell_chunks) {
+            device.unmapMemory(chunk.memory);
+            device.destroyBuffer(chunk.buffer.buffer);
+            device.freeMemory(chunk.memory);
+        }
+        cell_chunks.clear();
+    }
+
+    uint32_t findMemoryType(
+        vk::PhysicalDevice physical_device,
+        uint32_t type_bits,
+        vk::MemoryPropertyFlags required,
+        vk::MemoryPropertyFlags preferred
+    ) {
+        auto memory_properties = physical_device.getMemoryProperties();
+        std::optional<uint32_t> fallback;
+        for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+            vk::MemoryPropertyFlags flags = memory_properties.memoryTypes[i].propertyFlags;
+            if (!(type_bits & (1 << i)) || (flags & required) != required) {
+                continue;
+            }
+            if ((flags & preferred) == preferred) {
+                return i;
+            }
+            if (!fallback.has_value()) {
+                fallback = i;
+            }
+        }
+        if (!fallback.has_value()) {
+            throw std::runtime_error("no suitable memory type");
+        }
+        return fallback.value();
+    }
+
+    void createImage(
+        vk::Device device,
+        vk::PhysicalDevice physical_device,
+        vk::Extent2D extent,
+        vk::Format format,
+        vk::ImageUsageFlags usage,
+        vk::Image& image,
+        vk::DeviceMemory& image_memory
+    ) {
+        vk::ImageCreateInfo image_info = vk::ImageCreateInfo()
+            .setImageType(vk::ImageType::e2D)
+            .setFormat(format)
+            .setExtent(vk::Extent3D { extent.width, extent.height, 1 })
+            .setMipLevels(1)
+            .setArrayLayers(1)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setTiling(vk::ImageTiling::eOptimal)
+            .setUsage(usage)
+            .setSharingMode(vk::SharingMode::eExclusive)
+            .setInitialLayout(vk::ImageLayout::eUndefined);
+        image = device.createImage(image_info);
+
+        vk::MemoryRequirements mem_reqs = device.getImageMemoryRequirements(image);
+        vk::MemoryAllocateInfo memory_info = vk::MemoryAllocateInfo()
+            .setAllocationSize(mem_reqs.size)
+            .setMemoryTypeIndex(findMemoryType(
+                physical_device,
+                mem_reqs.memoryTypeBits,
+                vk::MemoryPropertyFlags(),
+                vk::MemoryPropertyFlagBits::eDeviceLocal
+            ));
+        image_memory = device.allocateMemory(memory_info);
+        device.bindImageMemory(image, image_memory, 0);
+    }
+
+    void uploadCells(
+        vk::Device device,
+        uint64_t grid_size,
+        const Board& board,
+        const StepStats& bounds,
+        bool write_positions,
+        const std::vector<CellChunk>& cell_chunks,
+        StepStats& shown
+    ) {
+        // Cells outside both the previous and the new bounding box are dead
+        // in both boards, so only the union of the two can have changed.
+        uint64_t min_row = std::min(bounds.min_row, shown.min_row);
+        uint64_t max_row = std::max(bounds.max_row, shown.max_row);
+        uint64_t begin = std::min(bounds.min_column, shown.min_column);
+        uint64_t end = std::max(bounds.max_column, shown.max_column) + 1;
+        if (write_positions) {
+            min_row = 0;
+            max_row = grid_size - 1;
+            begin = 0;
+            end = grid_size;
+        }
+        shown = bounds;
+        if (min_row > max_row || begin >= grid_size) {
+            return;
+        }
+        end = std::min(end, grid_size);
+
+        for (const CellChunk& chunk : cell_chunks) {
+            uint64_t first = std::max(chunk.first_row, min_row);
+            uint64_t last = std::min(chunk.first_row + chunk.rows - 1, max_row);
+            if (first > last) {
+                continue;
+            }
+            for (uint64_t i = first; i <= last; i++) {
+                const uint64_t* row = board.row(i);
+                Cell* cells = chunk.mapped + (i - chunk.first_row) * grid_size;
+                for (uint64_t j = begin; j < end; j++) {
+                    if (write_positions) {
+                        cells[j].x = i;
+                        cells[j].y = j;
+                    }
+                    cells[j].alive = (row[j >> 6] >> (j & 63)) & 1;
+                }
+            }
+
+            if (chunk.flush_atom == 0) {
+                continue;
+            }
+            // One range from the first to the last written cell; flushing
+            // the columns in between is cheaper than one call per row.
+            vk::DeviceSize atom = chunk.flush_atom;
+            vk::DeviceSize offset = ((first - chunk.first_row) * grid_size + begin) * sizeof(Cell) / atom * atom;
+            vk::DeviceSize range_end = std::min(
+                (((last - chunk.first_row) * grid_size + end) * sizeof(Cell) + atom - 1) / atom * atom,
+                chunk.buffer.mem_reqs.size
+            );
+            device.flushMappedMemoryRanges({ vk::MappedMemoryRange(chunk.memory, offset, range_end - offset) });
+        }
+    }
+
     void createRenderpass(
         vk::Device device,
         vk::Format format,
+        vk::ImageLayout final_layout,
         vk::RenderPass& render_pass
     ) {
         std::vector<vk::AttachmentDescription> attachments = {
@@ -377,7 +622,7 @@ namespace game {
                 vk::AttachmentLoadOp::eDontCare,
                 vk::AttachmentStoreOp::eDontCare,
                 vk::ImageLayout::eUndefined,
-                vk::ImageLayout::ePresentSrcKHR
+                final_layout
             }
         };
 
@@ -421,6 +666,11 @@ namespace game {
                 vk::AccessFlagBits()
             }
         };
+        if (final_layout == vk::ImageLayout::eTransferSrcOptimal) {
+            dependencies[1]
+                .setDstStageMask(vk::PipelineStageFlagBits::eTransfer)
+                .setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+        }
 
         vk::RenderPassCreateInfo render_pass_info = vk::RenderPassCreateInfo()
             .setAttachmentCount(attachments.size())
@@ -628,9 +878,10 @@ namespace game {
         vk::Pipeline graphics_pipeline,
         vk::PipelineLayout graphics_pipeline_layout,
         Buffer vertex_buffer,
-        Buffer game_buffer,
-        uint32_t grid_size,
+        std::vector<CellChunk> cell_chunks,
+        uint64_t grid_size,
         std::vector<vk::DescriptorSet> descriptor_sets,
+        const CellCompaction& compaction,
         std::vector<vk::CommandBuffer>& command_buffers
     ) {
         vk::CommandBufferAllocateInfo command_buffers_info = vk::CommandBufferAllocateInfo()
@@ -646,38 +897,316 @@ namespace game {
             vk::CommandBufferBeginInfo command_buffer_begin = vk::CommandBufferBeginInfo()
                 .setFlags(vk::CommandBufferUsageFlagBits::eSimultaneousUse);
             cmd.begin(command_buffer_begin);
+            if (!compaction.chunks.empty()) {
+                recordCellCompaction(cmd, compaction, i, cell_chunks, grid_size);
+            }
+            recordBoardDraw(
+                cmd,
+                render_pass,
+                framebuffers[i],
+                render_area,
+                graphics_pipeline,
+                graphics_pipeline_layout,
+                vertex_buffer,
+                cell_chunks,
+                grid_size,
+                descriptor_sets[i],
+                compaction.chunks
+            );
+            cmd.end();
+        }
+    }
 
-            std::vector<vk::ClearValue> clear_colors = {
-                vk::ClearValue {
-                    vk::ClearColorValue {
-                        std::array<float, 4> { .0f, .0f, .0f, 1.f }
-                    }
+    void recordBoardDraw(
+        vk::CommandBuffer cmd,
+        vk::RenderPass render_pass,
+        vk::Framebuffer framebuffer,
+        vk::Extent2D render_area,
+        vk::Pipeline graphics_pipeline,
+        vk::PipelineLayout graphics_pipeline_layout,
+        Buffer vertex_buffer,
+        const std::vector<CellChunk>& cell_chunks,
+        uint64_t grid_size,
+        vk::DescriptorSet descriptor_set,
+        const std::vector<CompactedChunk>& compacted_chunks
+    ) {
+        std::vector<vk::ClearValue> clear_colors = {
+            vk::ClearValue {
+                vk::ClearColorValue {
+                    std::array<float, 4> { .0f, .0f, .0f, 1.f }
                 }
-            };
+            }
+        };
 
-            vk::RenderPassBeginInfo render_pass_begin = vk::RenderPassBeginInfo()
-                .setFramebuffer(framebuffers[i])
-                .setRenderPass(render_pass)
-                .setRenderArea(
-                    vk::Rect2D {
-                        vk::Offset2D { 0, 0 },
-                        render_area
-                    }
-                )
-                .setClearValueCount(clear_colors.size())
-                .setPClearValues(clear_colors.data());
+        vk::RenderPassBeginInfo render_pass_begin = vk::RenderPassBeginInfo()
+            .setFramebuffer(framebuffer)
+            .setRenderPass(render_pass)
+            .setRenderArea(
+                vk::Rect2D {
+                    vk::Offset2D { 0, 0 },
+                    render_area
+                }
+            )
+            .setClearValueCount(clear_colors.size())
+            .setPClearValues(clear_colors.data());
 
-            cmd.beginRenderPass(render_pass_begin, vk::SubpassContents::eInline);
+        cmd.beginRenderPass(render_pass_begin, vk::SubpassContents::eInline);
 
-            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, graphics_pipeline_layout, 0, { descriptor_sets[i] }, {});
-            cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, graphics_pipeline);
-            
-            cmd.bindVertexBuffers(0, { vertex_buffer.buffer }, { 0 });
-            cmd.bindVertexBuffers(1, { game_buffer.buffer }, { 0 });
-            cmd.draw(6, grid_size * grid_size, 0, 0);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, graphics_pipeline_layout, 0, { descriptor_set }, {});
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, graphics_pipeline);
+        
+        cmd.bindVertexBuffers(0, { vertex_buffer.buffer }, { 0 });
+        if (compacted_chunks.empty()) {
+            for (const CellChunk& chunk : cell_chunks) {
+                cmd.bindVertexBuffers(1, { chunk.buffer.buffer }, { 0 });
+                cmd.draw(6, static_cast<uint32_t>(chunk.rows * grid_size), 0, 0);
+            }
+        } else {
+            // Dead cells are left to the clear colour.
+            for (const CompactedChunk& chunk : compacted_chunks) {
+                cmd.bindVertexBuffers(1, { chunk.instances.buffer }, { 0 });
+                cmd.drawIndirect(chunk.indirect.buffer, 0, 1, sizeof(vk::DrawIndirectCommand));
+            }
+        }
 
-            cmd.endRenderPass();
-            cmd.end();
+        cmd.endRenderPass();
+    }
+
+    namespace {
+        const uint32_t COMPACTION_GROUP_SIZE = 256;
+        const uint32_t MAX_GROUPS_X = 65535;
+    }
+
+    vk::ShaderModule loadShader(vk::Device device, const char* path) {
+        std::ifstream code(path, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!code.is_open()) {
+            throw std::runtime_error(std::string("couldn't read ") + path);
+        }
+        std::vector<char> bytes(static_cast<size_t>(code.tellg()));
+        code.seekg(0, std::ios::beg);
+        code.read(bytes.data(), bytes.size());
+
+        vk::ShaderModuleCreateInfo shader_info = vk::ShaderModuleCreateInfo()
+            .setCodeSize(bytes.size())
+            .setPCode(reinterpret_cast<const uint32_t*>(bytes.data()));
+        return device.createShaderModule(shader_info);
+    }
+
+    void createCellCompaction(
+        vk::Device device,
+        vk::PhysicalDevice physical_device,
+        uint64_t grid_size,
+        const std::vector<CellChunk>& cell_chunks,
+        const std::vector<Buffer>& camera_buffers,
+        std::set<uint32_t> queue_indexes,
+        CellCompaction& compaction
+    ) {
+        std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+            vk::DescriptorSetLayoutBinding { 0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+            vk::DescriptorSetLayoutBinding { 1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+            vk::DescriptorSetLayoutBinding { 2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr },
+            vk::DescriptorSetLayoutBinding { 3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr }
+        };
+        vk::DescriptorSetLayoutCreateInfo set_layout_info = vk::DescriptorSetLayoutCreateInfo()
+            .setBindingCount(bindings.size())
+            .setPBindings(bindings.data());
+        compaction.set_layout = device.createDescriptorSetLayout(set_layout_info);
+
+        uint32_t set_count = camera_buffers.size() * cell_chunks.size();
+        std::vector<vk::DescriptorPoolSize> sizes = {
+            vk::DescriptorPoolSize { vk::DescriptorType::eUniformBuffer, set_count },
+            vk::DescriptorPoolSize { vk::DescriptorType::eStorageBuffer, 3 * set_count }
+        };
+        vk::DescriptorPoolCreateInfo pool_info = vk::DescriptorPoolCreateInfo()
+            .setMaxSets(set_count)
+            .setPoolSizeCount(sizes.size())
+            .setPPoolSizes(sizes.data());
+        compaction.descriptor_pool = device.createDescriptorPool(pool_info);
+
+        vk::PushConstantRange push_range = vk::PushConstantRange()
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+            .setOffset(0)
+            .setSize(sizeof(uint32_t));
+        vk::PipelineLayoutCreateInfo pipeline_layout_info = vk::PipelineLayoutCreateInfo()
+            .setSetLayoutCount(1)
+            .setPSetLayouts(&compaction.set_layout)
+            .setPushConstantRangeCount(1)
+            .setPPushConstantRanges(&push_range);
+        compaction.pipeline_layout = device.createPipelineLayout(pipeline_layout_info);
+
+        uint32_t grid_size_constant = static_cast<uint32_t>(grid_size);
+        vk::SpecializationMapEntry specialization_entry = vk::SpecializationMapEntry()
+            .setConstantID(0)
+            .setOffset(0)
+            .setSize(sizeof(uint32_t));
+        vk::SpecializationInfo specialization = vk::SpecializationInfo()
+            .setMapEntryCount(1)
+            .setPMapEntries(&specialization_entry)
+            .setDataSize(sizeof(uint32_t))
+            .setPData(&grid_size_constant);
+
+        vk::ShaderModule shader = loadShader(device, "compact.spv");
+        vk::ComputePipelineCreateInfo pipeline_info = vk::ComputePipelineCreateInfo()
+            .setStage(
+                vk::PipelineShaderStageCreateInfo()
+                    .setStage(vk::ShaderStageFlagBits::eCompute)
+                    .setModule(shader)
+                    .setPName("main")
+                    .setPSpecializationInfo(&specialization)
+            )
+            .setLayout(compaction.pipeline_layout);
+        compaction.pipeline = device.createComputePipeline(vk::PipelineCache(), pipeline_info).value;
+        device.destroyShaderModule(shader);
+
+        // Worst case every cell of a chunk is live, so the instance buffer
+        // matches the chunk. Only the GPU touches it: device local.
+        compaction.chunks.clear();
+        for (const CellChunk& cell_chunk : cell_chunks) {
+            CompactedChunk chunk;
+            createBuffer(
+                device,
+                cell_chunk.rows * grid_size * sizeof(Cell),
+                queue_indexes,
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer,
+                chunk.instances.buffer
+            );
+            createBuffer(
+                device,
+                sizeof(vk::DrawIndirectCommand),
+                queue_indexes,
+                vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                chunk.indirect.buffer
+            );
+            chunk.instances.mem_reqs = device.getBufferMemoryRequirements(chunk.instances.buffer);
+            chunk.indirect.mem_reqs = device.getBufferMemoryRequirements(chunk.indirect.buffer);
+            chunk.instances.offset = 0;
+            vk::DeviceSize alignment = chunk.indirect.mem_reqs.alignment;
+            chunk.indirect.offset = (chunk.instances.mem_reqs.size + alignment - 1) / alignment * alignment;
+
+            vk::MemoryAllocateInfo memory_info = vk::MemoryAllocateInfo()
+                .setAllocationSize(chunk.indirect.offset + chunk.indirect.mem_reqs.size)
+                .setMemoryTypeIndex(findMemoryType(
+                    physical_device,
+                    chunk.instances.mem_reqs.memoryTypeBits & chunk.indirect.mem_reqs.memoryTypeBits,
+                    vk::MemoryPropertyFlags(),
+                    vk::MemoryPropertyFlagBits::eDeviceLocal
+                ));
+            chunk.memory = device.allocateMemory(memory_info);
+            device.bindBufferMemory(chunk.instances.buffer, chunk.memory, chunk.instances.offset);
+            device.bindBufferMemory(chunk.indirect.buffer, chunk.memory, chunk.indirect.offset);
+            compaction.chunks.push_back(chunk);
+        }
+
+        updateCellCompactionSets(device, cell_chunks, camera_buffers, compaction);
+    }
+
+    void updateCellCompactionSets(
+        vk::Device device,
+        const std::vector<CellChunk>& cell_chunks,
+        const std::vector<Buffer>& camera_buffers,
+        CellCompaction& compaction
+    ) {
+        device.resetDescriptorPool(compaction.descriptor_pool);
+        std::vector<vk::DescriptorSetLayout> layouts(camera_buffers.size() * cell_chunks.size(), compaction.set_layout);
+        vk::DescriptorSetAllocateInfo set_info = vk::DescriptorSetAllocateInfo()
+            .setDescriptorPool(compaction.descriptor_pool)
+            .setDescriptorSetCount(layouts.size())
+            .setPSetLayouts(layouts.data());
+        compaction.sets = device.allocateDescriptorSets(set_info);
+
+        for (uint32_t image = 0; image < camera_buffers.size(); image++) {
+            for (uint32_t c = 0; c < cell_chunks.size(); c++) {
+                vk::DescriptorSet set = compaction.sets[image * cell_chunks.size() + c];
+                vk::DescriptorBufferInfo camera_info { camera_buffers[image].buffer, 0, sizeof(Camera) };
+                vk::DescriptorBufferInfo cells_info { cell_chunks[c].buffer.buffer, 0, VK_WHOLE_SIZE };
+                vk::DescriptorBufferInfo instances_info { compaction.chunks[c].instances.buffer, 0, VK_WHOLE_SIZE };
+                vk::DescriptorBufferInfo indirect_info { compaction.chunks[c].indirect.buffer, 0, VK_WHOLE_SIZE };
+                std::vector<vk::WriteDescriptorSet> writes = {
+                    vk::WriteDescriptorSet(set, 0, 0, 1, vk::DescriptorType::eUniformBuffer, nullptr, &camera_info, nullptr),
+                    vk::WriteDescriptorSet(set, 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &cells_info, nullptr),
+                    vk::WriteDescriptorSet(set, 2, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &instances_info, nullptr),
+                    vk::WriteDescriptorSet(set, 3, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &indirect_info, nullptr)
+                };
+                device.updateDescriptorSets(writes, {});
+            }
+        }
+    }
+
+    void destroyCellCompaction(vk::Device device, CellCompaction& compaction) {
+        for (CompactedChunk& chunk : compaction.chunks) {
+            device.destroyBuffer(chunk.instances.buffer);
+            device.destroyBuffer(chunk.indirect.buffer);
+            device.freeMemory(chunk.memory);
+        }
+        compaction.chunks.clear();
+        compaction.sets.clear();
+        device.destroyPipeline(compaction.pipeline);
+        device.destroyPipelineLayout(compaction.pipeline_layout);
+        device.destroyDescriptorPool(compaction.descriptor_pool);
+        device.destroyDescriptorSetLayout(compaction.set_layout);
+    }
+
+    void recordCellCompaction(
+        vk::CommandBuffer cmd,
+        const CellCompaction& compaction,
+        uint32_t image,
+        const std::vector<CellChunk>& cell_chunks,
+        uint64_t grid_size
+    ) {
+        // The previous frame's draw may still be reading the instances and
+        // the counts this frame is about to overwrite.
+        cmd.pipelineBarrier(
+            vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput,
+            vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+            {},
+            {},
+            {},
+            {}
+        );
+
+        vk::DrawIndirectCommand reset { 6, 0, 0, 0 };
+        for (const CompactedChunk& chunk : compaction.chunks) {
+            cmd.updateBuffer(chunk.indirect.buffer, 0, sizeof(reset), &reset);
+        }
+        vk::MemoryBarrier reset_barrier = vk::MemoryBarrier()
+            .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+        cmd.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eComputeShader,
+            {},
+            { reset_barrier },
+            {},
+            {}
+        );
+
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, compaction.pipeline);
+        for (uint32_t c = 0; c < cell_chunks.size(); c++) {
+            uint32_t cell_count = static_cast<uint32_t>(cell_chunks[c].rows * grid_size);
+            uint32_t groups = (cell_count + COMPACTION_GROUP_SIZE - 1) / COMPACTION_GROUP_SIZE;
+            uint32_t groups_x = std::min(groups, MAX_GROUPS_X);
+            uint32_t groups_y = (groups + groups_x - 1) / groups_x;
+            cmd.bindDescriptorSets(
+                vk::PipelineBindPoint::eCompute,
+                compaction.pipeline_layout,
+                0,
+                { compaction.sets[image * cell_chunks.size() + c] },
+                {}
+            );
+            cmd.pushConstants(compaction.pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(cell_count), &cell_count);
+            cmd.dispatch(groups_x, groups_y, 1);
         }
+
+        vk::MemoryBarrier draw_barrier = vk::MemoryBarrier()
+            .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eVertexAttributeRead);
+        cmd.pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput,
+            {},
+            { draw_barrier },
+            {},
+            {}
+        );
     }
-}
\ No newline at end of file
+}
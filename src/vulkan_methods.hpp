@@ -4,12 +4,15 @@
 #include <set>
 #include <vector>
 #include <array>
+#include <string>
 #include <iostream>
 #include <optional>
 
 #include <vulkan/vulkan.hpp>
 #include <GLFW/glfw3.h>
 
+#include "board.hpp"
+
 namespace game {
     struct Vertex {
         struct {
@@ -105,10 +108,51 @@ namespace game {
     struct Buffer {
         vk::Buffer buffer;
         vk::MemoryRequirements mem_reqs;
-        uint32_t offset;
+        vk::DeviceSize offset;
+    };
+
+    // Boards are split into bands of whole rows so that no single buffer,
+    // allocation or instanced draw has to cover more than the device allows.
+    // The memory stays mapped, in device local memory when the host can see
+    // it.
+    struct CellChunk {
+        Buffer buffer;
+        vk::DeviceMemory memory;
+        Cell* mapped;
+        // Writes must be flushed in multiples of this, 0 when the memory is
+        // coherent.
+        vk::DeviceSize flush_atom;
+        uint64_t first_row;
+        uint64_t rows;
+    };
+
+    // Live cells of one CellChunk, packed by the compaction pass, and the
+    // indirect draw command that says how many there are.
+    struct CompactedChunk {
+        Buffer instances;
+        Buffer indirect;
+        vk::DeviceMemory memory;
     };
 
-    void createInstance(vk::Instance& instance, vk::DispatchLoaderDynamic& dispatcher, vk::DebugUtilsMessengerEXT& debug_utils);
+    // Per frame GPU stream compaction of live, visible cells so the board
+    // draw only instances those. An empty chunk list means compaction is
+    // off and every cell is drawn.
+    struct CellCompaction {
+        vk::DescriptorSetLayout set_layout;
+        vk::DescriptorPool descriptor_pool;
+        vk::PipelineLayout pipeline_layout;
+        vk::Pipeline pipeline;
+        std::vector<CompactedChunk> chunks;
+        // One per (camera buffer, chunk): sets[image * chunks.size() + chunk].
+        std::vector<vk::DescriptorSet> sets;
+    };
+
+    void createInstance(
+        vk::Instance& instance,
+        vk::DispatchLoaderDynamic& dispatcher,
+        vk::DebugUtilsMessengerEXT& debug_utils,
+        bool headless
+    );
     void createSurface(vk::Instance instance, GLFWwindow* window, vk::SurfaceKHR& surface);
     void createDevice(
         vk::Instance instance,
@@ -120,6 +164,15 @@ namespace game {
         Queue& present_queue,
         Queue& compute_queue
     );
+    // policy is "fifo", "mailbox" or "immediate". Unsupported modes fall
+    // back to the nearest supported one, ending at FIFO which is always
+    // available.
+    vk::PresentModeKHR choosePresentMode(
+        vk::PhysicalDevice physical_device,
+        vk::SurfaceKHR surface,
+        vk::DispatchLoaderDynamic dispatcher,
+        std::string policy
+    );
     void createSwapchain(
         vk::PhysicalDevice physical_device,
         vk::Device device,
@@ -127,6 +180,7 @@ namespace game {
         vk::Extent2D image_extent,
         vk::DispatchLoaderDynamic dispatcher,
         std::set<uint32_t> queue_indexes,
+        vk::PresentModeKHR present_mode,
         vk::SurfaceFormatKHR& surface_format,
         vk::SwapchainKHR& swapchain
     );
@@ -170,9 +224,49 @@ namespace game {
         uint32_t& device_memory_type_index,
         vk::DeviceMemory& device_memory
     );
+    void createCellChunks(
+        vk::Device device,
+        vk::PhysicalDevice physical_device,
+        uint64_t grid_size,
+        std::set<uint32_t> queue_indexes,
+        std::vector<CellChunk>& cell_chunks
+    );
+    void destroyCellChunks(vk::Device device, std::vector<CellChunk>& cell_chunks);
+    uint32_t findMemoryType(
+        vk::PhysicalDevice physical_device,
+        uint32_t type_bits,
+        vk::MemoryPropertyFlags required,
+        vk::MemoryPropertyFlags preferred
+    );
+    void createImage(
+        vk::Device device,
+        vk::PhysicalDevice physical_device,
+        vk::Extent2D extent,
+        vk::Format format,
+        vk::ImageUsageFlags usage,
+        vk::Image& image,
+        vk::DeviceMemory& image_memory
+    );
+    // Only rewrites (and flushes) the cells inside the bounding boxes of
+    // board (bounds, from the engine's step stats) and of the previous
+    // upload (shown), so the traffic follows the live area rather than the
+    // board size. write_positions writes everything. shown is then set to
+    // bounds. The caller must make sure no submitted frame still reads the
+    // chunks.
+    void uploadCells(
+        vk::Device device,
+        uint64_t grid_size,
+        const Board& board,
+        const StepStats& bounds,
+        bool write_positions,
+        const std::vector<CellChunk>& cell_chunks,
+        StepStats& shown
+    );
+    vk::ShaderModule loadShader(vk::Device device, const char* path);
     void createRenderpass(
         vk::Device device,
         vk::Format format,
+        vk::ImageLayout final_layout,
         vk::RenderPass& render_pass
     );
     void createGraphicsPipeline(
@@ -203,11 +297,53 @@ namespace game {
         vk::Pipeline graphics_pipeline,
         vk::PipelineLayout graphics_pipeline_layout,
         Buffer vertex_buffer,
-        Buffer game_buffers,
-        uint32_t grid_size,
+        std::vector<CellChunk> cell_chunks,
+        uint64_t grid_size,
         std::vector<vk::DescriptorSet> descriptor_sets,
+        const CellCompaction& compaction,
         std::vector<vk::CommandBuffer>& command_buffers
     );
+    void recordBoardDraw(
+        vk::CommandBuffer cmd,
+        vk::RenderPass render_pass,
+        vk::Framebuffer framebuffer,
+        vk::Extent2D render_area,
+        vk::Pipeline graphics_pipeline,
+        vk::PipelineLayout graphics_pipeline_layout,
+        Buffer vertex_buffer,
+        const std::vector<CellChunk>& cell_chunks,
+        uint64_t grid_size,
+        vk::DescriptorSet descriptor_set,
+        const std::vector<CompactedChunk>& compacted_chunks
+    );
+    void createCellCompaction(
+        vk::Device device,
+        vk::PhysicalDevice physical_device,
+        uint64_t grid_size,
+        const std::vector<CellChunk>& cell_chunks,
+        const std::vector<Buffer>& camera_buffers,
+        std::set<uint32_t> queue_indexes,
+        CellCompaction& compaction
+    );
+    // Camera buffers are recreated with the swapchain, so the sets are
+    // rewritten separately.
+    void updateCellCompactionSets(
+        vk::Device device,
+        const std::vector<CellChunk>& cell_chunks,
+        const std::vector<Buffer>& camera_buffers,
+        CellCompaction& compaction
+    );
+    void destroyCellCompaction(vk::Device device, CellCompaction& compaction);
+    // Records the reset, the dispatch and the barriers that make the result
+    // visible to the draw, for the frame using camera buffer `image`. Must
+    // be recorded outside a render pass.
+    void recordCellCompaction(
+        vk::CommandBuffer cmd,
+        const CellCompaction& compaction,
+        uint32_t image,
+        const std::vector<CellChunk>& cell_chunks,
+        uint64_t grid_size
+    );
 }
 
 #endif // __VULKAN__METHODS__HPP__
\ No newline at end of file
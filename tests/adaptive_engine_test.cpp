@@ -0,0 +1,57 @@
+#include "engine_check.hpp"
+
+#include <sstream>
+#include <string>
+
+namespace {
+    // A long enough run for several races and switches, with each decision
+    // logged, still matches naive.
+    void checkDecisions() {
+        game::Rule rule;
+        game::parseRule("B3/S23", rule);
+        game::ThreadPool pool(2);
+        game::Board board;
+        game::createBoard(200, 150, board);
+        game::seedSoup(board, "center", 9, 0.5, pool);
+
+        std::ostringstream log;
+        std::unique_ptr<game::Engine> naive, engine;
+        game::createEngine("naive", rule, pool, naive);
+        game::createAdaptiveEngine(rule, pool, { "bitpacked", "lut", "tiled:2" }, &log, engine);
+        naive->load(board);
+        engine->load(board);
+        naive->step(400);
+        engine->step(400);
+        game::Board expected, actual;
+        naive->store(expected);
+        engine->store(actual);
+        GAME_CHECK(expected == actual);
+        GAME_CHECK(log.str().find("adaptive: after ") != std::string::npos);
+    }
+
+    bool refused(game::Rule rule, std::vector<std::string> candidates) {
+        game::ThreadPool pool(1);
+        std::unique_ptr<game::Engine> engine;
+        try {
+            game::createAdaptiveEngine(rule, pool, candidates, nullptr, engine);
+        } catch (std::runtime_error&) {
+            return true;
+        }
+        return false;
+    }
+}
+
+int main() {
+    test::checkEngine("adaptive", true);
+    test::checkEngine("adaptive:lut+bitpacked", false);
+    checkDecisions();
+
+    game::Rule torus;
+    game::parseRule("B3/S23:T", torus);
+    // The default candidates leave out engines without torus support,
+    // named ones are taken as given.
+    GAME_CHECK(!refused(torus, {}));
+    GAME_CHECK(refused(torus, { "bitpacked", "lut" }));
+    GAME_CHECK(!refused(torus, { "bitpacked" }));
+    return 0;
+}
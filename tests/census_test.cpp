@@ -0,0 +1,64 @@
+#include "check.hpp"
+#include "census.hpp"
+
+#include <string>
+
+namespace {
+    uint64_t countOf(const game::CensusReport& report, const std::string& name) {
+        for (auto& object : report.census) {
+            if (object.name == name) {
+                return object.count;
+            }
+        }
+        return 0;
+    }
+
+    // Soups small enough that many throw out gliders: those must reach
+    // the census as gliders rather than as the debris they leave where
+    // they hit the edge.
+    void checkShipsEscape() {
+        game::CensusOptions options;
+        options.width = 32;
+        options.height = 32;
+        options.soups = 256;
+        options.batch = 128;
+        options.generations = 3000;
+        game::ThreadPool pool(2);
+        game::CensusReport report;
+        game::runCensus(options, pool, report);
+
+        GAME_CHECK(report.soups == 256);
+        GAME_CHECK(report.escaped != 0);
+        GAME_CHECK(countOf(report, "glider") != 0);
+        // Settled soups hold no ships, so every ship is an escapee.
+        uint64_t objects = 0, ships = 0;
+        for (auto& object : report.census) {
+            objects += object.count;
+            ships += object.displacement[0] != 0 ? object.count : 0;
+        }
+        GAME_CHECK(objects == report.objects);
+        GAME_CHECK(ships == report.escaped);
+    }
+
+    // Soups cut off long before they settle add nothing but escapees.
+    void checkUnsettled() {
+        game::CensusOptions options;
+        options.width = 48;
+        options.height = 48;
+        options.soups = 64;
+        options.batch = 64;
+        options.generations = 20;
+        game::ThreadPool pool(1);
+        game::CensusReport report;
+        game::runCensus(options, pool, report);
+
+        GAME_CHECK(report.unsettled + report.died == 64);
+        GAME_CHECK(report.objects == report.escaped);
+    }
+}
+
+int main() {
+    checkShipsEscape();
+    checkUnsettled();
+    return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef __CHECK__HPP__
+#define __CHECK__HPP__
+
+#include <cstdlib>
+#include <iostream>
+
+// Test programs stop at the first failed check; ctest reports the line.
+#define GAME_CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            std::exit(1); \
+        } \
+    } while (false)
+
+#endif // __CHECK__HPP__
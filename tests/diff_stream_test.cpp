@@ -0,0 +1,178 @@
+#include "check.hpp"
+#include "delta.hpp"
+#include "diff_stream.hpp"
+#include "engine.hpp"
+#include "simulation.hpp"
+#include "seed.hpp"
+
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    // Both encodings of the change between two boards rebuild the second.
+    void checkDeltas() {
+        game::ThreadPool pool(1);
+        for (uint64_t width : { 1, 63, 64, 65, 200 }) {
+            game::Board before, after;
+            game::createBoard(width, 37, before);
+            game::createBoard(width, 37, after);
+            game::seedSoup(before, "full", width, 0.3, pool);
+            game::seedSoup(after, "center", width + 1, 0.3, pool);
+            const game::Board* bases[] = { &before, nullptr };
+            for (const game::Board* base : bases) {
+                std::vector<uint8_t> words, runs;
+                game::encodeWordDelta(base, after, words);
+                game::wordDeltaToCellRuns(words.data(), words.size(), after.words_per_row, runs);
+
+                game::Board from_words, from_runs;
+                game::createBoard(width, 37, from_words);
+                if (base) {
+                    from_words = *base;
+                }
+                from_runs = from_words;
+                game::StepStats stats;
+                game::applyWordDelta(words.data(), words.size(), from_words, &stats);
+                game::applyCellRuns(runs.data(), runs.size(), from_runs);
+                GAME_CHECK(from_words == after);
+                GAME_CHECK(from_runs == after);
+                uint64_t start = base ? game::population(*base) : 0;
+                GAME_CHECK(start + stats.births - stats.deaths == game::population(after));
+            }
+        }
+    }
+
+    // Streams a run with edits and a rewind, then reads it back: every
+    // board the simulation showed must come out in order, and consecutive
+    // generations must be one step apart.
+    void checkRoundTrip(const std::string& rule_name, const std::string& soup, uint64_t size, uint64_t keyframes) {
+        const std::string path = "diff_stream_test.bin";
+        game::Options options;
+        options.grid_size = size;
+        options.has_seed = true;
+        options.seed = 5;
+        options.soup = soup;
+        options.density = 0.4;
+        options.rule = rule_name;
+        options.stream = path;
+        options.stream_keyframes = keyframes;
+        options.history_mb = 16;
+
+        std::vector<std::pair<uint64_t, game::Board>> shown;
+        {
+            game::ThreadPool pool(2);
+            game::Simulation simulation(options, pool);
+            shown.emplace_back(0, simulation.board());
+            for (int k = 0; k < 40; k++) {
+                simulation.step(1 + k % 4);
+                shown.emplace_back(simulation.generation(), simulation.board());
+                if (k == 10) {
+                    simulation.edit({ { 3, 4, true }, { 3, 5, true }, { 3, 6, true } });
+                    shown.emplace_back(simulation.generation(), simulation.board());
+                }
+                if (k == 20) {
+                    simulation.rewind(simulation.generation() - 5);
+                    shown.emplace_back(simulation.generation(), simulation.board());
+                }
+            }
+        }
+
+        game::Rule rule;
+        game::parseRule(rule_name, rule);
+        game::ThreadPool pool(1);
+        std::unique_ptr<game::Engine> naive;
+        game::createEngine("naive", rule, pool, naive);
+
+        game::DiffStreamReader reader(path);
+        GAME_CHECK(reader.rule() == rule);
+        size_t matched = 0;
+        uint64_t records = 0;
+        uint64_t previous_generation = 0;
+        game::Board previous;
+        while (reader.next()) {
+            GAME_CHECK(reader.stats().population == game::population(reader.board()));
+            if (records != 0 && reader.generation() == previous_generation + 1) {
+                game::Board stepped;
+                naive->load(previous);
+                naive->step(1);
+                naive->store(stepped);
+                GAME_CHECK(stepped == reader.board());
+            }
+            if (matched < shown.size() && shown[matched].first == reader.generation() && shown[matched].second == reader.board()) {
+                matched++;
+            }
+            previous_generation = reader.generation();
+            previous = reader.board();
+            records++;
+        }
+        GAME_CHECK(matched == shown.size());
+        std::remove(path.c_str());
+    }
+
+    bool readFails(const std::string& path, const std::vector<uint8_t>& bytes) {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        GAME_CHECK(file != nullptr);
+        GAME_CHECK(std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size());
+        std::fclose(file);
+        try {
+            game::DiffStreamReader reader(path);
+            while (reader.next()) {}
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    }
+
+    // Truncated or corrupt streams are reported, not read past their end.
+    void checkDamaged() {
+        const std::string path = "diff_stream_damaged.bin";
+        game::Options options;
+        options.grid_size = 64;
+        options.has_seed = true;
+        options.seed = 3;
+        options.soup = "full";
+        options.density = 0.4;
+        options.stream = path;
+        {
+            game::ThreadPool pool(1);
+            game::Simulation simulation(options, pool);
+            simulation.step(3);
+        }
+        std::vector<uint8_t> bytes;
+        {
+            std::FILE* file = std::fopen(path.c_str(), "rb");
+            GAME_CHECK(file != nullptr);
+            int c;
+            while ((c = std::fgetc(file)) != EOF) {
+                bytes.push_back(uint8_t(c));
+            }
+            std::fclose(file);
+        }
+        // Stream header is 32 bytes and each record header 16.
+        GAME_CHECK(bytes.size() > 48);
+        GAME_CHECK(!readFails(path, bytes));
+
+        GAME_CHECK(readFails(path, std::vector<uint8_t>(bytes.begin(), bytes.begin() + 32 + 5)));
+        GAME_CHECK(readFails(path, std::vector<uint8_t>(bytes.begin(), bytes.begin() + 32 + 16 + 1)));
+        GAME_CHECK(readFails(path, std::vector<uint8_t>(bytes.begin(), bytes.begin() + 20)));
+
+        std::vector<uint8_t> zero_width = bytes;
+        std::fill(zero_width.begin() + 8, zero_width.begin() + 16, 0);
+        GAME_CHECK(readFails(path, zero_width));
+        std::vector<uint8_t> huge_height = bytes;
+        std::fill(huge_height.begin() + 16, huge_height.begin() + 24, 0xff);
+        GAME_CHECK(readFails(path, huge_height));
+        std::remove(path.c_str());
+    }
+}
+
+int main() {
+    checkDeltas();
+    checkRoundTrip("B3/S23", "center", 300, 0);
+    checkRoundTrip("B3/S23", "full", 300, 7);
+    checkRoundTrip("B36/S23:T", "center", 100, 0);
+    checkDamaged();
+    return 0;
+}
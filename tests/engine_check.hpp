@@ -0,0 +1,79 @@
+#ifndef __ENGINE_CHECK__HPP__
+#define __ENGINE_CHECK__HPP__
+
+#include "check.hpp"
+#include "engine.hpp"
+#include "seed.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace test {
+    // Sizes and rules the engine tests step each engine through.
+    const std::vector<std::pair<uint64_t, uint64_t>> SIZES = { { 1, 1 }, { 70, 33 }, { 128, 64 }, { 200, 7 }, { 65, 41 } };
+    const std::vector<std::string> RULES = { "B3/S23", "B36/S23", "B2/S", "B0123/S8" };
+
+    // Steps engine and the naive engine side by side through batches of
+    // different lengths and compares boards and stats after each batch.
+    inline void checkAgainstNaive(const std::string& name, const std::string& rule_name, uint32_t threads, uint64_t width, uint64_t height) {
+        game::Rule rule;
+        game::parseRule(rule_name, rule);
+        game::ThreadPool pool(threads);
+        game::Board board;
+        game::createBoard(width, height, board);
+        game::seedSoup(board, "full", width * 7 + height, 0.4, pool);
+
+        std::unique_ptr<game::Engine> naive, engine;
+        game::createEngine("naive", rule, pool, naive);
+        game::createEngine(name, rule, pool, engine);
+        naive->load(board);
+        engine->load(board);
+        for (uint64_t batch : { 1, 2, 5, 13, 70 }) {
+            naive->step(batch);
+            engine->step(batch);
+            game::Board expected, actual;
+            naive->store(expected);
+            engine->store(actual);
+            if (!(expected == actual)) {
+                std::cerr << name << " " << rule_name << " " << width << "x" << height << " on " << threads << " threads" << std::endl;
+            }
+            GAME_CHECK(expected == actual);
+            GAME_CHECK(engine->stats().population == game::population(actual));
+        }
+    }
+
+    // checkAgainstNaive over every rule, both thread counts and all sizes,
+    // on bounded boards and, with torus set, on tori too.
+    inline void checkEngine(const std::string& name, bool torus) {
+        for (auto& rule : RULES) {
+            for (uint32_t threads : { 1, 3 }) {
+                for (auto& size : SIZES) {
+                    checkAgainstNaive(name, rule, threads, size.first, size.second);
+                    if (torus) {
+                        checkAgainstNaive(name, rule + ":T", threads, size.first, size.second);
+                    }
+                }
+            }
+        }
+    }
+
+    // Engines without torus support refuse such rules instead of stepping
+    // them as bounded boards.
+    inline void checkRefusesTorus(const std::string& name) {
+        game::Rule rule;
+        game::parseRule("B3/S23:T", rule);
+        game::ThreadPool pool(1);
+        std::unique_ptr<game::Engine> engine;
+        bool refused = false;
+        try {
+            game::createEngine(name, rule, pool, engine);
+        } catch (std::runtime_error&) {
+            refused = true;
+        }
+        GAME_CHECK(refused);
+    }
+}
+
+#endif // __ENGINE_CHECK__HPP__
@@ -0,0 +1,6 @@
+#include "engine_check.hpp"
+
+int main() {
+    test::checkEngine("bitpacked", true);
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include "check.hpp"
+#include "engine.hpp"
+#include "ensemble.hpp"
+#include "seed.hpp"
+
+#include <string>
+
+namespace {
+    // Every board of the ensemble matches naive at the generation it
+    // stopped at: the end of the run, its death, or one period after the
+    // repeat was found.
+    void checkEnsemble(const std::string& rule_name, uint64_t width, uint64_t height) {
+        game::Rule rule;
+        game::parseRule(rule_name, rule);
+        game::ThreadPool pool(2);
+        const uint64_t count = 70;
+        const uint64_t generations = 40;
+        game::Ensemble ensemble(width, height, count, rule);
+        ensemble.seed(11, 0.35, pool);
+        ensemble.run(generations, 2, pool);
+        for (uint64_t k = 0; k < count; k++) {
+            game::Board board;
+            game::createBoard(width, height, board);
+            game::seedSoup(board, "full", 11 + k, 0.35, pool);
+            const game::EnsembleResult& result = ensemble.result(k);
+            uint64_t reached = result.end == game::EnsembleEnd::Running ? generations
+                : result.generation + (result.end == game::EnsembleEnd::Periodic ? result.period : 0);
+            std::unique_ptr<game::Engine> naive;
+            game::createEngine("naive", rule, pool, naive);
+            naive->load(board);
+            naive->step(reached);
+            game::Board expected, actual;
+            naive->store(expected);
+            ensemble.store(k, actual);
+            GAME_CHECK(expected == actual);
+        }
+    }
+}
+
+int main() {
+    for (std::string rule_name : { "B3/S23", "B3/S23:T", "B36/S23" }) {
+        checkEnsemble(rule_name, 20, 17);
+        checkEnsemble(rule_name, 64, 9);
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "check.hpp"
+#include "engine.hpp"
+#include "gpu_engine.hpp"
+#include "seed.hpp"
+#include "vulkan_methods.hpp"
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+namespace {
+    // Steps the gpu engine and the bitpacked engine side by side through
+    // batches that are and aren't multiples of the generations per
+    // dispatch, and compares boards and populations after each.
+    void checkAgainstBitpacked(game::GpuStepper& stepper, const std::string& name, const std::string& rule_name, uint64_t width, uint64_t height) {
+        game::Rule rule;
+        game::parseRule(rule_name, rule);
+        game::ThreadPool pool(1);
+        game::Board board;
+        game::createBoard(width, height, board);
+        game::seedSoup(board, "full", width * 7 + height, 0.4, pool);
+
+        std::unique_ptr<game::Engine> reference, engine;
+        game::createEngine("bitpacked", rule, pool, reference);
+        game::createGpuEngine(stepper, rule, engine);
+        reference->load(board);
+        engine->load(board);
+        for (uint64_t batch : { 1, 2, 5, 13, 70 }) {
+            reference->step(batch);
+            engine->step(batch);
+            game::Board expected, actual;
+            reference->store(expected);
+            engine->store(actual);
+            if (!(expected == actual)) {
+                std::cerr << name << " " << rule_name << " " << width << "x" << height << " after a batch of " << batch << std::endl;
+            }
+            GAME_CHECK(expected == actual);
+            GAME_CHECK(engine->stats().population == game::population(actual));
+        }
+    }
+}
+
+// Needs a Vulkan device and the compute shaders in the working directory.
+int main() {
+    vk::Instance instance;
+    vk::DispatchLoaderDynamic dispatcher;
+    vk::DebugUtilsMessengerEXT debug_utils;
+    game::createInstance(instance, dispatcher, debug_utils, true);
+    vk::PhysicalDevice physical_device;
+    vk::Device device;
+    game::Queue graphics_queue, present_queue, compute_queue;
+    game::createDevice(instance, vk::SurfaceKHR(), dispatcher, physical_device, device, graphics_queue, present_queue, compute_queue);
+
+    const std::vector<std::pair<uint64_t, uint64_t>> sizes = { { 1, 1 }, { 70, 33 }, { 128, 64 }, { 200, 7 }, { 65, 41 }, { 1000, 300 } };
+    const std::vector<std::string> rules = { "B3/S23", "B36/S23", "B2/S", "B0123/S8" };
+    // Deep dispatches need workgroups tall enough for their halo. The
+    // shared ones run compute.spv on devices that would pick the subgroup
+    // shader.
+    const std::vector<std::string> names = {
+        "gpu:1", "gpu:2", "gpu:3:16x16", "gpu:4", "gpu:8:32x32",
+        "gpu:1:32x16:shared", "gpu:3:16x16:shared", "gpu:8:32x32:shared"
+    };
+    for (auto& name : names) {
+        game::GpuStepper stepper;
+        game::createGpuStepper(device, physical_device, compute_queue, name, stepper);
+        for (auto& rule : rules) {
+            for (auto& size : sizes) {
+                checkAgainstBitpacked(stepper, name, rule, size.first, size.second);
+            }
+        }
+        game::destroyGpuStepper(device, stepper);
+    }
+
+    device.destroy();
+    instance.destroyDebugUtilsMessengerEXT(debug_utils, nullptr, dispatcher);
+    instance.destroy();
+    return 0;
+}
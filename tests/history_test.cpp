@@ -0,0 +1,145 @@
+#include "check.hpp"
+#include "engine.hpp"
+#include "history.hpp"
+#include "simulation.hpp"
+#include "seed.hpp"
+
+#include <vector>
+
+namespace {
+    // Generations 0..count-1 of a board; sparse boards are mostly deltas,
+    // dense ones mostly keyframes.
+    std::vector<game::Board> run(uint64_t size, double density, uint64_t count) {
+        game::Rule rule;
+        game::parseRule("B3/S23", rule);
+        game::ThreadPool pool(1);
+        game::Board board;
+        game::createBoard(size, size, board);
+        game::seedSoup(board, "center", 5, density, pool);
+        std::unique_ptr<game::Engine> engine;
+        game::createEngine("bitpacked", rule, pool, engine);
+        engine->load(board);
+        std::vector<game::Board> boards(1, board);
+        for (uint64_t g = 1; g < count; g++) {
+            engine->step(1);
+            engine->store(board);
+            boards.push_back(board);
+        }
+        return boards;
+    }
+
+    void checkRestoreOrder(game::History& history, const std::vector<game::Board>& boards, uint64_t first) {
+        // Forwards, backwards and jumping, so every restore path is taken.
+        std::vector<uint64_t> order;
+        for (uint64_t g = first; g < boards.size(); g++) {
+            order.push_back(g);
+        }
+        for (uint64_t g = boards.size(); g-- > first; ) {
+            order.push_back(g);
+        }
+        for (uint64_t g = first; g < boards.size(); g += 7) {
+            order.push_back(boards.size() - 1 - (g - first));
+            order.push_back(g);
+        }
+        for (uint64_t g : order) {
+            game::Board restored;
+            GAME_CHECK(history.restore(g, restored) == g);
+            GAME_CHECK(restored == boards[g]);
+        }
+    }
+
+    void checkRecordRestore(double density) {
+        std::vector<game::Board> boards = run(96, density, 40);
+        game::History history(4, uint64_t(64) << 20);
+        for (uint64_t g = 0; g < boards.size(); g++) {
+            history.record(boards[g], g);
+        }
+        GAME_CHECK(history.oldest() == 0);
+        GAME_CHECK(history.newest() == boards.size() - 1);
+        checkRestoreOrder(history, boards, 0);
+    }
+
+    // Recording at a restored generation drops everything after it, even
+    // when the last restore left the cursor past the new end.
+    void checkTruncate(double density) {
+        std::vector<game::Board> boards = run(96, density, 20);
+        game::History history(8, uint64_t(64) << 20);
+        for (uint64_t g = 0; g < boards.size(); g++) {
+            history.record(boards[g], g);
+        }
+        game::Board restored;
+        history.restore(12, restored);
+        history.restore(8, restored);
+        GAME_CHECK(restored == boards[8]);
+
+        game::Board edited = restored;
+        edited.set(3, 4, !edited.get(3, 4));
+        history.record(edited, 8);
+        GAME_CHECK(history.newest() == 8);
+        std::vector<game::Board> branch(boards.begin(), boards.begin() + 8);
+        branch.push_back(edited);
+        checkRestoreOrder(history, branch, 0);
+
+        history.record(boards[10], 9);
+        branch.push_back(boards[10]);
+        checkRestoreOrder(history, branch, 0);
+
+        history.record(boards[0], 0);
+        GAME_CHECK(history.oldest() == 0 && history.newest() == 0);
+    }
+
+    void checkBudget() {
+        std::vector<game::Board> boards = run(256, 0.5, 60);
+        game::History history(4, 40 << 10);
+        for (uint64_t g = 0; g < boards.size(); g++) {
+            history.record(boards[g], g);
+            GAME_CHECK(history.newest() == g);
+        }
+        GAME_CHECK(history.oldest() > 0);
+        checkRestoreOrder(history, boards, history.oldest());
+    }
+
+    // Shift+B and a click in the app: rewind to the start, edit, step on.
+    void checkSimulationRewindEdit() {
+        game::Options options;
+        options.grid_size = 80;
+        options.has_seed = true;
+        options.seed = 3;
+        options.density = 0.1;
+        options.history_mb = 16;
+        options.keyframe_interval = 16;
+        game::ThreadPool pool(1);
+        game::Simulation simulation(options, pool);
+        std::vector<game::Board> boards(1, simulation.board());
+        for (int g = 0; g < 20; g++) {
+            simulation.step(1);
+            boards.push_back(simulation.board());
+        }
+        simulation.rewind(12);
+        simulation.rewind(8);
+        GAME_CHECK(simulation.generation() == 8);
+        GAME_CHECK(simulation.board() == boards[8]);
+
+        game::Board edited = boards[8];
+        edited.set(40, 40, !edited.get(40, 40));
+        simulation.edit({ { 40, 40, edited.get(40, 40) } });
+        GAME_CHECK(simulation.board() == edited);
+        GAME_CHECK(simulation.stepBack());
+        GAME_CHECK(simulation.board() == boards[7]);
+        simulation.rewind(8);
+        GAME_CHECK(simulation.board() == edited);
+        simulation.step(3);
+        simulation.rewind(8);
+        GAME_CHECK(simulation.board() == edited);
+    }
+}
+
+int main() {
+    checkRecordRestore(0.5);
+    checkRecordRestore(0.02);
+    checkTruncate(0.5);
+    checkTruncate(0.02);
+    checkBudget();
+    checkSimulationRewindEdit();
+    return 0;
+}
@@ -0,0 +1,39 @@
+#include "engine_check.hpp"
+#include "kernels.hpp"
+
+#include <string>
+
+namespace {
+    game::RowShape shapeOf(uint64_t width) {
+        game::Board board;
+        game::createBoard(width, 1, board);
+        return game::RowShape { width, board.words_per_row, board.lastWordMask() };
+    }
+}
+
+int main() {
+    // Full and partial last words for each fixed-width instance, plus
+    // widths that fall back to the generic kernel.
+    for (uint64_t words : { 1, 2, 3, 4, 5, 8, 16, 32, 64, 128, 256 }) {
+        for (uint64_t width : { words * 64, words * 64 - 5 }) {
+            for (std::string rule : { "B3/S23", "B36/S23" }) {
+                test::checkAgainstNaive("bitpacked", rule, 2, width, 5);
+                test::checkAgainstNaive("bitpacked", rule + ":T", 2, width, 5);
+            }
+        }
+    }
+
+    game::Rule life, other;
+    game::parseRule("B3/S23:T", life);
+    game::parseRule("B36/S23", other);
+    std::string name;
+    game::selectRowKernel(shapeOf(256), life, false, &name);
+    GAME_CHECK(name == "4 words, B3/S23, torus");
+    game::selectRowKernel(shapeOf(250), other, true, &name);
+    GAME_CHECK(name == "4 words, rule table, bounded");
+    game::selectRowKernel(shapeOf(320), life, true, &name);
+    GAME_CHECK(name == "any width, B3/S23, torus");
+    game::selectRowKernel(shapeOf(64 * 512), life, false, &name);
+    GAME_CHECK(name == "any width, B3/S23, torus");
+    return 0;
+}
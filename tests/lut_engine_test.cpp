@@ -0,0 +1,9 @@
+#include "engine_check.hpp"
+
+#include <string>
+
+int main() {
+    test::checkEngine("lut", false);
+    test::checkRefusesTorus("lut");
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "check.hpp"
+#include "engine.hpp"
+#include "seed.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace {
+    // Counts the stats of the step from before to after cell by cell,
+    // independently of the word-wise counting in the kernels.
+    game::StepStats countStats(const game::Board& before, const game::Board& after) {
+        game::StepStats stats;
+        for (uint64_t i = 0; i < after.height; i++) {
+            for (uint64_t j = 0; j < after.width; j++) {
+                bool was = before.get(i, j);
+                bool is = after.get(i, j);
+                stats.births += !was && is;
+                stats.deaths += was && !is;
+                if (is) {
+                    stats.population++;
+                    stats.min_row = std::min(stats.min_row, i);
+                    stats.max_row = std::max(stats.max_row, i);
+                    stats.min_column = std::min(stats.min_column, j);
+                    stats.max_column = std::max(stats.max_column, j);
+                }
+            }
+        }
+        return stats;
+    }
+
+    bool sameStats(const game::StepStats& a, const game::StepStats& b) {
+        return a.population == b.population && a.births == b.births && a.deaths == b.deaths
+            && a.min_row == b.min_row && a.max_row == b.max_row
+            && a.min_column == b.min_column && a.max_column == b.max_column;
+    }
+
+    // The stats after a batch describe its last generation, so the naive
+    // reference steps one generation at a time to keep the one before.
+    void checkStats(const std::string& name, const std::string& rule_name, uint64_t width, uint64_t height, const std::string& soup) {
+        game::Rule rule;
+        game::parseRule(rule_name, rule);
+        game::ThreadPool pool(2);
+        game::Board board;
+        game::createBoard(width, height, board);
+        game::seedSoup(board, soup, width + height, 0.3, pool);
+
+        std::unique_ptr<game::Engine> naive, engine;
+        game::createEngine("naive", rule, pool, naive);
+        game::createEngine(name, rule, pool, engine);
+        naive->load(board);
+        engine->load(board);
+        GAME_CHECK(sameStats(engine->stats(), countStats(board, board)));
+
+        game::Board before, after = board;
+        for (uint64_t batch : { 1, 3, 8, 1, 30 }) {
+            for (uint64_t g = 0; g < batch; g++) {
+                before = after;
+                naive->step(1);
+                naive->store(after);
+            }
+            engine->step(batch);
+            if (!sameStats(engine->stats(), countStats(before, after))) {
+                std::cerr << name << " " << rule_name << " " << width << "x" << height << " " << soup << " after a batch of " << batch << std::endl;
+            }
+            GAME_CHECK(sameStats(engine->stats(), countStats(before, after)));
+        }
+
+        // Edits add to the population and bounds and keep the step's
+        // births and deaths.
+        game::StepStats stepped = engine->stats();
+        engine->edit({ { height - 1, width - 1, true } });
+        game::Board edited;
+        engine->store(edited);
+        game::StepStats expected = countStats(before, edited);
+        GAME_CHECK(engine->stats().population == expected.population);
+        GAME_CHECK(engine->stats().max_row == height - 1);
+        GAME_CHECK(engine->stats().max_column == width - 1);
+        GAME_CHECK(engine->stats().births == stepped.births);
+        GAME_CHECK(engine->stats().deaths == stepped.deaths);
+    }
+}
+
+int main() {
+    for (std::string name : { "naive", "bitpacked", "lut", "tiled", "tiled:5", "adaptive" }) {
+        for (std::string rule : { "B3/S23", "B36/S23" }) {
+            checkStats(name, rule, 70, 33, "full");
+            checkStats(name, rule, 300, 200, "center");
+            checkStats(name, rule, 128, 64, "full");
+        }
+    }
+    // Everything dies at once: the bounds are those of an empty board.
+    for (std::string name : { "bitpacked", "lut", "tiled" }) {
+        checkStats(name, "B/S", 90, 40, "full");
+    }
+    return 0;
+}
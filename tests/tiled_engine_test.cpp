@@ -0,0 +1,12 @@
+#include "engine_check.hpp"
+
+#include <string>
+
+int main() {
+    // Depth 1 has no temporal blocking; 5 leaves a remainder on most batches.
+    for (std::string name : { "tiled", "tiled:1", "tiled:5" }) {
+        test::checkEngine(name, false);
+    }
+    test::checkRefusesTorus("tiled");
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "check.hpp"
+#include "transport.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace {
+    // The child echoes a message several times the ring capacity back, so
+    // both directions wrap around.
+    void checkEcho(const std::string& transport) {
+        std::unique_ptr<game::Channel> parent, child;
+        game::createChannelPair(transport, 256, parent, child);
+        std::vector<uint8_t> message(5000);
+        for (size_t i = 0; i < message.size(); i++) {
+            message[i] = uint8_t(i * 7);
+        }
+        parent->attach();
+        pid_t pid = fork();
+        GAME_CHECK(pid >= 0);
+        if (pid == 0) {
+            child->attach();
+            std::vector<uint8_t> echo(message.size());
+            child->receive(echo.data(), echo.size());
+            child->send(echo.data(), echo.size());
+            _exit(0);
+        }
+        child.reset();
+        parent->send(message.data(), message.size());
+        std::vector<uint8_t> echo(message.size());
+        parent->receive(echo.data(), echo.size());
+        GAME_CHECK(echo == message);
+        int status = 0;
+        waitpid(pid, &status, 0);
+        GAME_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    // A peer that exits without answering makes receive throw rather
+    // than wait forever, also before it was reaped.
+    void checkPeerExit(const std::string& transport) {
+        std::unique_ptr<game::Channel> parent, child;
+        game::createChannelPair(transport, 256, parent, child);
+        parent->attach();
+        pid_t pid = fork();
+        GAME_CHECK(pid >= 0);
+        if (pid == 0) {
+            child->attach();
+            _exit(0);
+        }
+        child.reset();
+        bool thrown = false;
+        try {
+            uint64_t value;
+            parent->receive(&value, sizeof(value));
+        } catch (std::runtime_error&) {
+            thrown = true;
+        }
+        GAME_CHECK(thrown);
+        waitpid(pid, nullptr, 0);
+    }
+}
+
+int main() {
+    for (auto& transport : game::transportNames()) {
+        checkEcho(transport);
+        checkPeerExit(transport);
+    }
+    return 0;
+}